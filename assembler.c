@@ -1,24 +1,89 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "src/utils.h"
 #include "src/tables.h"
+#include "src/reloc.h"
+#include "src/labels.h"
 #include "src/translate_utils.h"
 #include "src/translate.h"
+#include "src/pseudo.h"
+#include "src/preproc.h"
+#include "src/data.h"
+#include "src/words.h"
+#include "src/fixups.h"
+#include "src/ir.h"
+#include "src/peephole.h"
+#include "src/schedule.h"
+#include "src/relax.h"
+#include "src/cost.h"
+#include "src/layout.h"
+#include "src/verify.h"
+#include "src/ring.h"
+#include "src/aio.h"
+#include "src/arena.h"
+#include "src/memstat.h"
+#include "src/perf.h"
+#include "src/trace.h"
+#include "src/gc.h"
+#include "src/elf.h"
 #include "assembler.h"
 
 const int MAX_ARGS = 3;
 const int BUF_SIZE = 1024;
 const char* IGNORE_CHARS = " \f\n\r\t\v,()";
+const uint32_t DEFAULT_IO_DEPTH = 64;
+const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+/* Options set from the command line. */
+static struct {
+    int optimize;       // -O: run the peephole optimizer after pass one
+    int schedule;       // --schedule: fill delay slots and load-use gaps
+    int pipeline;               // --pipeline: run pass two on four threads
+    int verify;                 // --verify: check the output against the IR
+    const char* profile;        // --profile: counts file for block layout
+    const char* cost_report;    // --cost-report: file for the cycle estimates
+    CostModel cost_model;       // --cost-model: pipeline used for the estimates
+    int io_backend;             // --io: file I/O backend for -batch
+    uint32_t io_depth;          // --io-depth: files in flight for -batch
+    int mem_stats;              // --mem-stats: print arena usage when done
+    int gc_sections;            // --gc-sections: drop code unreachable from the entry
+    const char* entry;          // --entry: label --gc-sections starts from
+    int elf;                    // -f elf: write an ELF relocatable object
+    int big_endian;             // -EB/-EL: byte order of the ELF object
+    PerfCounters* perf;         // --perf-counters: counters per phase, or NULL
+    const char* trace;          // --trace: file for the Chrome trace events
+} options;
+
+/* Where the lines of pass one's input came from while pass one reads the
+   output of preprocess(), and NULL otherwise.
+ */
+static const SourceMap* source_map = NULL;
 
 /*******************************
  * Helper Functions
  *******************************/
 
+/* Writes INPUT_LINE into BUF as the location errors are reported at: the
+   file, line and macro it was preprocessed from if there is a source map,
+   and just the number otherwise.
+ */
+static const char* line_location(char* buf, size_t len, uint64_t input_line) {
+    if (source_map) {
+        format_source_loc(source_map, input_line, buf, len);
+    } else {
+        snprintf(buf, len, "%llu", (unsigned long long) input_line);
+    }
+    return buf;
+}
+
 /* You should not be calling this function yourself. */
-static void raise_label_error(uint32_t input_line, const char* label) {
-    write_to_log("Error - invalid label at line %d: %s\n", input_line, label);
+static void raise_label_error(uint64_t input_line, const char* label) {
+    char where[BUF_SIZE];
+    write_to_log("Error - invalid label at line %s: %s\n",
+        line_location(where, BUF_SIZE, input_line), label);
 }
 
 /* Call this function if more than MAX_ARGS arguments are found while parsing
@@ -29,8 +94,10 @@ static void raise_label_error(uint32_t input_line, const char* label) {
 
    EXTRA_ARG should contain the first extra argument encountered.
  */
-static void raise_extra_arg_error(uint32_t input_line, const char* extra_arg) {
-    write_to_log("Error - extra argument at line %d: %s\n", input_line, extra_arg);
+static void raise_extra_arg_error(uint64_t input_line, const char* extra_arg) {
+    char where[BUF_SIZE];
+    write_to_log("Error - extra argument at line %s: %s\n",
+        line_location(where, BUF_SIZE, input_line), extra_arg);
 }
 
 /* You should call this function if write_pass_one() or translate_inst() 
@@ -39,18 +106,52 @@ static void raise_extra_arg_error(uint32_t input_line, const char* extra_arg) {
    INPUT_LINE is which line of the input file that the error occurred in. Note
    that the first line is line 1 and that empty lines are included in the count.
  */
-static void raise_inst_error(uint32_t input_line, const char* name, char** args,
+static void raise_inst_error(uint64_t input_line, const char* name, char** args,
     int num_args) {
     
-    write_to_log("Error - invalid instruction at line %d: ", input_line);
+    char where[BUF_SIZE];
+    write_to_log("Error - invalid instruction at line %s: ",
+        line_location(where, BUF_SIZE, input_line));
     log_inst(name, args, num_args);
 }
 
-/* Truncates the string at the first occurrence of the '#' character. */
+/* Call this function if add_data() fails. BAD is the invalid operand it
+   found, or the end of the line if one is missing.
+ */
+static void raise_data_error(uint64_t input_line, const char* name, const char* bad) {
+    char where[BUF_SIZE];
+    size_t len = strcspn(bad, IGNORE_CHARS);
+    if (*bad == '"') {
+        len = strcspn(bad + 1, "\"\n") + 1;
+        len += bad[len] == '"';
+    }
+    write_to_log("Error - invalid data at line %s: %s%s%.*s\n",
+        line_location(where, BUF_SIZE, input_line), name, *bad ? " " : "", (int) len, bad);
+}
+
+/* Call this function once the instructions up to INPUT_LINE take more than
+   DATA_BASE bytes, which would run into the data segment.
+ */
+static void raise_text_size_error(uint64_t input_line) {
+    char where[BUF_SIZE];
+    write_to_log("Error - text section too large at line %s\n",
+        line_location(where, BUF_SIZE, input_line));
+}
+
+/* Truncates the string at the first occurrence of the '#' character that is
+   not inside a string literal.
+ */
 static void skip_comment(char* str) {
-    char* comment_start = strchr(str, '#');
-    if (comment_start) {
-        *comment_start = '\0';
+    int quoted = 0;
+    for (; *str; str++) {
+        if (*str == '"') {
+            quoted = !quoted;
+        } else if (*str == '\\' && quoted && str[1]) {
+            str++;
+        } else if (*str == '#' && !quoted) {
+            *str = '\0';
+            return;
+        }
     }
 }
 
@@ -70,7 +171,7 @@ static void skip_comment(char* str) {
     3b. STR ends in ':' and is a valid label. Addition to symbol table succeeds.
         Returns 1.
  */
-static int add_if_label(uint32_t input_line, char* str, uint32_t byte_offset,
+static int add_if_label(uint64_t input_line, char* str, uint32_t byte_offset,
     SymbolTable* symtbl) {
     size_t len = strlen(str);
     if (str[len - 1] == ':') {
@@ -117,23 +218,68 @@ static int add_if_label(uint32_t input_line, char* str, uint32_t byte_offset,
    Just like in pass_two(), if the function encounters an error it should NOT
    exit, but process the entire file and return -1. If no errors were encountered, 
    it should return 0.
+
+   If LABELS is not NULL, the label each written line refers to is recorded
+   in it by id, and once the whole file is read every label of SYMTBL is
+   defined there and the undefined ones are found, for pass two.
+
+   Lines after a .data directive, up to the next .text, are data directives
+   instead of instructions, and are parsed straight into DATA by add_data()
+   without going through the intermediate file. Their labels are defined at
+   DATA_BASE plus their offset in DATA, after any alignment of the directive
+   that follows them. If DATA is NULL, .data is an invalid instruction.
+
+   Line numbers are 64-bit, so the input may have any number of lines, but
+   the instructions must fit below DATA_BASE. The first one that does not is
+   reported and the rest of the text is only checked for labels and data.
  */
-int pass_one(FILE* input, FILE* output, SymbolTable* symtbl) {
-    char buf[BUF_SIZE], *args[MAX_ARGS];
-    int err, result, line, i, byte, pass;
-    char* splitter;
+int pass_one(FILE* input, FILE* output, SymbolTable* symtbl, LabelIds* labels,
+    DataSection* data) {
+    char *buf = NULL, *args[MAX_ARGS];
+    size_t buf_cap = 0;
+    int err, result, i, pass, in_data, full;
+    uint64_t line;
+    uint32_t byte, pending, start;
+    unsigned size;
+    char *splitter, *line_end;
+    const char* bad;
     char instruction[10];
-    result = 0, line = 0, byte = 0;
-    while (fgets(buf, BUF_SIZE, input)) {
+    result = 0, line = 0, byte = 0, in_data = 0, full = 0, pending = 0;
+    while (getline(&buf, &buf_cap, input) != -1) {
         pass = 1;
         skip_comment(buf);
+        line_end = buf + strlen(buf);
         splitter = strtok(buf, IGNORE_CHARS);
         if (splitter != NULL) {
-            err = add_if_label(line, splitter, byte, symtbl);
+            err = add_if_label(line, splitter, in_data ? DATA_BASE + data->len : byte,
+                symtbl);
             if (err != 0) {
                 splitter = strtok(NULL, IGNORE_CHARS);
             }
-            if (splitter != NULL) {
+            if (splitter != NULL && data
+                && (strcmp(splitter, ".data") == 0 || strcmp(splitter, ".text") == 0)) {
+                in_data = splitter[1] == 'd';
+                pending = symtbl->len;
+            } else if (splitter != NULL && in_data) {
+                /* The operands are the rest of the line, which strtok()
+                   has not touched.
+                 */
+                char* operands = splitter + strlen(splitter);
+                operands += operands < line_end;
+                if (!is_data_directive(splitter)) {
+                    raise_inst_error(line + 1, splitter, NULL, 0);
+                    err = -1;
+                } else if (add_data(data, splitter, operands, &start, &bad) == -1) {
+                    raise_data_error(line + 1, splitter, bad);
+                    err = -1;
+                } else {
+                    for (; pending < symtbl->len; pending++) {
+                        symtbl->tbl[pending].addr = DATA_BASE + start;
+                    }
+                }
+            } else if (splitter != NULL && full) {
+                err = -1;
+            } else if (splitter != NULL) {
                 strcpy(instruction, splitter);
                 i = 0;
                 splitter = strtok(NULL, IGNORE_CHARS);
@@ -148,15 +294,20 @@ int pass_one(FILE* input, FILE* output, SymbolTable* symtbl) {
                     splitter = strtok(NULL, IGNORE_CHARS);
 
                 }
-                if (write_pass_one(output, instruction, args, i) == 0 && pass) {
+                size = write_pass_one(output, instruction, args, i);
+                if (labels && size > 0) {
+                    add_label_lines(labels, label_operand(labels, instruction, args, i), size);
+                }
+                if (size == 0 && pass) {
                     raise_inst_error(line + 1, instruction, args, i);
                     err = -1;
                 }
-                long int temp;
-                if (strcmp(instruction, "blt") == 0 || (strcmp(instruction, "li") == 0 && translate_num(&temp, args[1], -32767, 6553) == -1)) {
-                    byte += 4;
+                byte += 4 * size;
+                if (byte > DATA_BASE) {
+                    raise_text_size_error(line + 1);
+                    full = 1;
+                    err = -1;
                 }
-                byte += 4;
             }
 
             if (err == -1) {
@@ -165,7 +316,12 @@ int pass_one(FILE* input, FILE* output, SymbolTable* symtbl) {
         }
         line++;
     }
+    free(buf);
 
+    if (labels) {
+        define_labels(labels, symtbl);
+        check_labels(labels);
+    }
     return result;
 }
 
@@ -176,13 +332,24 @@ int pass_one(FILE* input, FILE* output, SymbolTable* symtbl) {
     4. All instructions have at maximum MAX_ARGS arguments
     5. The symbol table has been filled out already
 
+   If TEXT is not NULL, every encoded word is also appended to it, so that
+   later stages can use the machine code without reading OUTPUT back. OUTPUT
+   may then be NULL, and no hex text is written at all.
+
+   If LABELS is not NULL, it holds the label ids pass one recorded for each
+   line of INPUT, and labels are resolved through them by encode_inst_label()
+   instead of by name.
+
    If an error is reached, DO NOT EXIT the function. Keep translating the rest of
    the document, and at the end, return -1. Return 0 if no errors were encountered. */
-int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl) {
+int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, RelocTable* reltbl,
+    WordBuffer* text, LabelIds* labels) {
     char buf[BUF_SIZE];
-    int line_num, byte_offset, result, count_args, err;
+    int result, count_args, err;
+    uint32_t line_num, byte_offset, instruction;
     result = 0;
     byte_offset = 0;
+    line_num = 0;
     char* next_args[MAX_ARGS];
     char* splitter;
     char first_arg[10];
@@ -199,8 +366,18 @@ int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl
                 splitter = strtok(NULL, IGNORE_CHARS);
                 count_args++;
             }
-            err = translate_inst(output, first_arg, next_args, count_args, byte_offset * 4, symtbl, reltbl);
-            
+            uint32_t label = labels ? labels->line_labels[line_num] : LABEL_NONE;
+            err = encode_inst_label(&instruction, first_arg, next_args, count_args,
+                byte_offset * 4, symtbl, reltbl, labels, label);
+            if (err == 0) {
+                if (output) {
+                    write_inst_hex(output, instruction);
+                }
+                if (text) {
+                    add_word(text, instruction);
+                }
+            }
+
         } else {
             result = -1;
         }
@@ -215,6 +392,502 @@ int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl
     return result;
 }
 
+/*******************************
+ * Pipelined Pass Two
+ *******************************/
+
+#define BATCH_TEXT_SIZE (64 * 1024)
+#define BATCH_MAX_LINES 1024
+#define PIPELINE_BATCHES 8
+
+/* One line of the intermediate file. The reader stores the raw text in
+   NAME; the tokenizer replaces it with the instruction name (NULL for an
+   empty line) and sets NUM_ARGS, or -1 if there are too many arguments;
+   the encoder sets WORD and STATUS.
+ */
+typedef struct {
+    char* name;
+    char* args[INST_MAX_ARGS];
+    int num_args;
+    int status;
+    uint32_t word;
+} PipelineLine;
+
+/* A run of consecutive lines. FIRST_LINE is the index of the first one in
+   the intermediate file, which is also its instruction index.
+ */
+typedef struct {
+    char text[BATCH_TEXT_SIZE];
+    PipelineLine lines[BATCH_MAX_LINES];
+    uint32_t len;
+    uint32_t first_line;
+} Batch;
+
+/* The state shared by the stages. Batches go from FREE_BATCHES to the
+   reader, then through READ, TOKENIZED and ENCODED to the writer, which
+   hands them back to FREE_BATCHES. Since there are only PIPELINE_BATCHES
+   batches, a slow stage stops the ones before it. A NULL batch marks the
+   end of the input.
+ */
+typedef struct {
+    FILE* input;
+    FILE* output;
+    SymbolTable* symtbl;
+    RelocTable* reltbl;
+    WordBuffer* text;
+    LabelIds* labels;
+    Ring* free_batches;
+    Ring* read;
+    Ring* tokenized;
+    Ring* encoded;
+    int result;
+} Pipeline;
+
+static void* read_stage(void* arg) {
+    Pipeline* p = arg;
+    uint32_t line = 0;
+    int done = 0;
+    trace_thread_name("pass two: read");
+    while (!done) {
+        Batch* batch = ring_pop(p->free_batches);
+        trace_begin("read batch", NULL);
+        size_t used = 0;
+        batch->len = 0;
+        batch->first_line = line;
+        while (batch->len < BATCH_MAX_LINES && BATCH_TEXT_SIZE - used >= BUF_SIZE) {
+            char* buf = batch->text + used;
+            if (!fgets(buf, BUF_SIZE, p->input)) {
+                done = 1;
+                break;
+            }
+            batch->lines[batch->len++].name = buf;
+            used += strlen(buf) + 1;
+        }
+        line += batch->len;
+        trace_end("read batch");
+        ring_push(p->read, batch);
+    }
+    ring_push(p->read, NULL);
+    return NULL;
+}
+
+static void* tokenize_stage(void* arg) {
+    Pipeline* p = arg;
+    Batch* batch;
+    trace_thread_name("pass two: tokenize");
+    while ((batch = ring_pop(p->read)) != NULL) {
+        trace_begin("tokenize batch", NULL);
+        for (uint32_t i = 0; i < batch->len; i++) {
+            PipelineLine* line = &batch->lines[i];
+            char *save, *splitter;
+            line->name = strtok_r(line->name, IGNORE_CHARS, &save);
+            line->num_args = 0;
+            while (line->name && (splitter = strtok_r(NULL, IGNORE_CHARS, &save))) {
+                if (line->num_args == INST_MAX_ARGS) {
+                    line->num_args = -1;
+                    break;
+                }
+                line->args[line->num_args++] = splitter;
+            }
+        }
+        trace_end("tokenize batch");
+        ring_push(p->tokenized, batch);
+    }
+    ring_push(p->tokenized, NULL);
+    return NULL;
+}
+
+/* The only stage that reads the symbol table, adds relocations and writes
+   to the log, so both stay in input order.
+ */
+static void* encode_stage(void* arg) {
+    Pipeline* p = arg;
+    Batch* batch;
+    trace_thread_name("pass two: encode");
+    while ((batch = ring_pop(p->tokenized)) != NULL) {
+        trace_begin("encode batch", NULL);
+        for (uint32_t i = 0; i < batch->len; i++) {
+            PipelineLine* line = &batch->lines[i];
+            uint32_t index = batch->first_line + i;
+            line->status = -1;
+            if (line->name == NULL) {
+                continue;
+            }
+            if (line->num_args == -1) {
+                raise_inst_error(index + 1, line->name, line->args, INST_MAX_ARGS);
+                continue;
+            }
+            uint32_t label = p->labels ? p->labels->line_labels[index] : LABEL_NONE;
+            line->status = encode_inst_label(&line->word, line->name, line->args,
+                line->num_args, index * 4, p->symtbl, p->reltbl, p->labels, label);
+            if (line->status == -1) {
+                raise_inst_error(index + 1, line->name, line->args, line->num_args);
+            }
+        }
+        trace_end("encode batch");
+        ring_push(p->encoded, batch);
+    }
+    ring_push(p->encoded, NULL);
+    return NULL;
+}
+
+static void* write_stage(void* arg) {
+    Pipeline* p = arg;
+    Batch* batch;
+    trace_thread_name("pass two: write");
+    while ((batch = ring_pop(p->encoded)) != NULL) {
+        trace_begin("write batch", NULL);
+        for (uint32_t i = 0; i < batch->len; i++) {
+            PipelineLine* line = &batch->lines[i];
+            if (line->status == -1) {
+                p->result = -1;
+                continue;
+            }
+            if (p->output) {
+                write_inst_hex(p->output, line->word);
+            }
+            if (p->text) {
+                add_word(p->text, line->word);
+            }
+        }
+        trace_end("write batch");
+        ring_push(p->free_batches, batch);
+    }
+    return NULL;
+}
+
+/* Does the same as pass_two(), with the same output and log, but reads,
+   tokenizes, encodes and writes on four threads connected by
+   single-producer/single-consumer rings of line batches.
+ */
+int pass_two_pipelined(FILE* input, FILE* output, SymbolTable* symtbl,
+    RelocTable* reltbl, WordBuffer* text, LabelIds* labels) {
+    Pipeline p = { input, output, symtbl, reltbl, text, labels };
+    p.free_batches = create_ring(PIPELINE_BATCHES);
+    p.read = create_ring(PIPELINE_BATCHES);
+    p.tokenized = create_ring(PIPELINE_BATCHES);
+    p.encoded = create_ring(PIPELINE_BATCHES);
+    p.result = 0;
+
+    Batch* batches = malloc(sizeof(Batch) * PIPELINE_BATCHES);
+    if (batches == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_IO, 0, sizeof(Batch) * PIPELINE_BATCHES);
+    for (int i = 0; i < PIPELINE_BATCHES; i++) {
+        ring_push(p.free_batches, &batches[i]);
+    }
+
+    void* (*stages[])(void*) = { read_stage, tokenize_stage, encode_stage, write_stage };
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        if (pthread_create(&threads[i], NULL, stages[i], &p) != 0) {
+            write_to_log("Error: unable to start pass two thread\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(batches);
+    mem_count(MEM_IO, sizeof(Batch) * PIPELINE_BATCHES, 0);
+    free_ring(p.free_batches);
+    free_ring(p.read);
+    free_ring(p.tokenized);
+    free_ring(p.encoded);
+    return p.result;
+}
+
+/* Writes NAME and its arguments into BUF as a single line of text. */
+static void format_inst(char* buf, size_t len, const char* name, char** args,
+    int num_args) {
+    int n = snprintf(buf, len, "%s", name);
+    for (int i = 0; i < num_args && n < len; i++) {
+        n += snprintf(buf + n, len - n, " %s", args[i]);
+    }
+}
+
+/* Fills in the field of the instruction described by FIXUP now that its label
+   is known to be at TARGET. Returns -1 if it is a branch that cannot reach
+   TARGET, and 0 otherwise.
+ */
+static int apply_fixup(WordBuffer* text, Fixup* fixup, uint32_t target) {
+    uint32_t* word = &text->words[fixup->addr / 4];
+    if (fixup->kind == FIXUP_BRANCH) {
+        if (!branch_in_range(fixup->addr, target)) {
+            return -1;
+        }
+        *word = set_branch_target(*word, fixup->addr, target);
+    } else if (fixup->kind == FIXUP_HI16) {
+        *word = (*word & 0xFFFF0000) | addr_hi(target);
+    } else {
+        *word = (*word & 0xFFFF0000) | (target & 0xFFFF);
+    }
+    return 0;
+}
+
+/* Encodes one real instruction at the end of TEXT. If it refers to a label
+   that has not been defined yet (a beq/bne, or the lui/addiu of an la), the
+   field is left as zero and a fixup is recorded for the label instead. The
+   halves of an la also get a relocation, as pass two gives them.
+
+   Returns 0 on success and -1 if the instruction is invalid.
+ */
+static int encode_single(uint64_t line, const char* name, char** args,
+    int num_args, WordBuffer* text, FixupTable* fixups, SymbolTable* symtbl,
+    RelocTable* reltbl) {
+    uint32_t addr = text->len * 4, instruction;
+    char *fixed_args[MAX_ARGS], label[BUF_SIZE];
+    SymbolTable* branch_symtbl = symtbl;
+    int kind = -1, arg = num_args - 1;
+
+    if (num_args > MAX_ARGS) {
+        return -1;
+    }
+    memcpy(fixed_args, args, sizeof(char*) * num_args);
+    if ((strcmp(name, "beq") == 0 || strcmp(name, "bne") == 0) && num_args == 3) {
+        kind = FIXUP_BRANCH;
+        snprintf(label, BUF_SIZE, "%s", args[arg]);
+    } else if ((strcmp(name, "lui") == 0 && num_args == 2)
+        || (strcmp(name, "addiu") == 0 && num_args == 3)) {
+        char* at = strrchr(args[arg], '@');
+        if (at && (strcmp(at, "@hi") == 0 || strcmp(at, "@lo") == 0)) {
+            kind = strcmp(at, "@hi") == 0 ? FIXUP_HI16 : FIXUP_LO16;
+            snprintf(label, BUF_SIZE, "%.*s", (int) (at - args[arg]), args[arg]);
+        }
+    }
+    if (kind != -1 && get_addr_for_symbol(symtbl, label) == -1) {
+        if (kind == FIXUP_BRANCH) {
+            branch_symtbl = NULL;
+        } else {
+            fixed_args[arg] = "0";
+        }
+    } else {
+        kind = -1;
+    }
+
+    if (encode_inst(&instruction, name, fixed_args, num_args, addr, branch_symtbl,
+        reltbl) == -1) {
+        return -1;
+    }
+    if (kind != -1) {
+        char inst[BUF_SIZE];
+        format_inst(inst, BUF_SIZE, name, args, num_args);
+        add_fixup(fixups, label, kind, addr, line, inst);
+        if (kind != FIXUP_BRANCH && add_relocation(reltbl, label, addr,
+            kind == FIXUP_HI16 ? RELOC_HI16 : RELOC_LO16) == -1) {
+            return -1;
+        }
+    }
+    add_word(text, instruction);
+    return 0;
+}
+
+/* Expands NAME if it is a pseudoinstruction and encodes the result. Errors
+   are reported against input line LINE. Returns 0 on success and -1 on error.
+ */
+static int encode_source_inst(uint64_t line, const char* name, char** args,
+    int num_args, WordBuffer* text, FixupTable* fixups, SymbolTable* symtbl,
+    RelocTable* reltbl) {
+    const PseudoInst* pseudo = find_pseudo(name);
+    if (!pseudo) {
+        if (encode_single(line, name, args, num_args, text, fixups, symtbl,
+            reltbl) == -1) {
+            raise_inst_error(line, name, args, num_args);
+            return -1;
+        }
+        return 0;
+    }
+
+    Expansion exp;
+    if (expand_pseudo(&exp, pseudo, args, num_args) == 0) {
+        raise_inst_error(line, name, args, num_args);
+        return -1;
+    }
+    int result = 0;
+    for (unsigned i = 0; i < exp.len; i++) {
+        char* exp_args[MAX_ARGS + 1];
+        char* exp_name = strtok(exp.lines[i], IGNORE_CHARS);
+        int n = 0;
+        char* splitter;
+        while (n <= MAX_ARGS && (splitter = strtok(NULL, IGNORE_CHARS)) != NULL) {
+            exp_args[n++] = splitter;
+        }
+        if (encode_single(line, exp_name, exp_args, n, text, fixups, symtbl,
+            reltbl) == -1) {
+            raise_inst_error(line, exp_name, exp_args, n);
+            result = -1;
+        }
+    }
+    return result;
+}
+
+static int compare_fixup_lines(const void* a, const void* b) {
+    uint64_t x = (*(Fixup**) a)->line, y = (*(Fixup**) b)->line;
+    return (x > y) - (x < y);
+}
+
+/* Patches every instruction waiting for LABEL, which has just been defined
+   at TARGET, and forgets them. Returns -1 if one of them cannot be patched.
+ */
+static int resolve_fixups(FixupTable* fixups, WordBuffer* text, const char* label,
+    uint32_t target) {
+    FixupChain* chain = find_fixups(fixups, label);
+    int result = 0;
+    if (chain) {
+        for (uint32_t i = 0; i < chain->len; i++) {
+            Fixup* fixup = &chain->fixups[i];
+            if (apply_fixup(text, fixup, target) != 0) {
+                raise_inst_error(fixup->line, fixup->inst, NULL, 0);
+                result = -1;
+            }
+        }
+        clear_fixups(fixups, chain);
+    }
+    return result;
+}
+
+/* Reports every fixup that was never resolved, in input order. */
+static void raise_unresolved(FixupTable* fixups) {
+    Fixup** pending = malloc(sizeof(Fixup*) * fixups->pending);
+    if (pending == NULL) {
+        allocation_failed();
+    }
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < fixups->len; i++) {
+        FixupChain* chain = &fixups->chains[i];
+        for (uint32_t j = 0; j < chain->len; j++) {
+            pending[n++] = &chain->fixups[j];
+        }
+    }
+    qsort(pending, n, sizeof(Fixup*), compare_fixup_lines);
+    for (uint32_t i = 0; i < n; i++) {
+        raise_inst_error(pending[i]->line, pending[i]->inst, NULL, 0);
+    }
+    free(pending);
+}
+
+/* Single-pass assembly. Each line is encoded as soon as it is read, so the
+   input is only processed once. Labels that are already defined are resolved
+   immediately. Forward references are put on a fixup list for their label
+   and patched in the output buffer when the label is defined. Encoded words
+   are written to OUTPUT as soon as no fixup is waiting on them.
+
+   Lines are parsed using the same rules as pass_one(), and the lines of a
+   .data section go into DATA in the same way. A data label only gets its
+   address, and is only resolved, once the directive after it is aligned.
+   Any label that is still undefined at the end of the input is reported as
+   an invalid instruction, just like pass_two() does.
+
+   Returns 0 if no errors were encountered and -1 otherwise.
+ */
+int pass_single(FILE* input, FILE* output, SymbolTable* symtbl, RelocTable* reltbl,
+    DataSection* data) {
+    char buf[BUF_SIZE], *args[MAX_ARGS];
+    int err, result = 0, num_args, full = 0, in_data = 0;
+    uint64_t line = 0;
+    uint32_t flushed = 0, pending = 0, start;
+    char *splitter, *line_end;
+    const char* bad;
+    WordBuffer* text = create_word_buffer();
+    FixupTable* fixups = create_fixup_table();
+
+    while (fgets(buf, BUF_SIZE, input)) {
+        line++;
+        skip_comment(buf);
+        line_end = buf + strlen(buf);
+        splitter = strtok(buf, IGNORE_CHARS);
+        if (splitter == NULL) {
+            continue;
+        }
+        err = add_if_label(line - 1, splitter,
+            in_data ? DATA_BASE + data->len : text->len * 4, symtbl);
+        if (err == 1 && !in_data
+            && resolve_fixups(fixups, text, splitter, text->len * 4) != 0) {
+            result = -1;
+        }
+        if (err != 0) {
+            splitter = strtok(NULL, IGNORE_CHARS);
+        }
+        if (splitter != NULL
+            && (strcmp(splitter, ".data") == 0 || strcmp(splitter, ".text") == 0)) {
+            /* Data labels with no directive after them stay where they are. */
+            for (; in_data && pending < symtbl->len; pending++) {
+                Symbol* symbol = &symtbl->tbl[pending];
+                if (resolve_fixups(fixups, text, symbol->name, symbol->addr) != 0) {
+                    result = -1;
+                }
+            }
+            in_data = splitter[1] == 'd';
+            pending = symtbl->len;
+        } else if (splitter != NULL && in_data) {
+            char* operands = splitter + strlen(splitter);
+            operands += operands < line_end;
+            if (!is_data_directive(splitter)) {
+                raise_inst_error(line, splitter, NULL, 0);
+                err = -1;
+            } else if (add_data(data, splitter, operands, &start, &bad) == -1) {
+                raise_data_error(line, splitter, bad);
+                err = -1;
+            } else {
+                for (; pending < symtbl->len; pending++) {
+                    Symbol* symbol = &symtbl->tbl[pending];
+                    symbol->addr = DATA_BASE + start;
+                    if (resolve_fixups(fixups, text, symbol->name, symbol->addr) != 0) {
+                        result = -1;
+                    }
+                }
+            }
+        } else if (splitter != NULL && full) {
+            err = -1;
+        } else if (splitter != NULL) {
+            char* name = splitter;
+            num_args = 0;
+            while ((splitter = strtok(NULL, IGNORE_CHARS)) != NULL) {
+                if (num_args == MAX_ARGS) {
+                    raise_extra_arg_error(line, splitter);
+                    err = -1;
+                    break;
+                }
+                args[num_args++] = splitter;
+            }
+            if (err != -1 && encode_source_inst(line, name, args, num_args, text,
+                fixups, symtbl, reltbl) != 0) {
+                err = -1;
+            }
+            if (text->len > DATA_BASE / 4) {
+                raise_text_size_error(line);
+                full = 1;
+                err = -1;
+            }
+        }
+        if (err == -1) {
+            result = -1;
+        }
+        if (fixups->pending == 0) {
+            write_words(text, output, flushed, text->len);
+            flushed = text->len;
+        }
+    }
+
+    for (; in_data && pending < symtbl->len; pending++) {
+        Symbol* symbol = &symtbl->tbl[pending];
+        if (resolve_fixups(fixups, text, symbol->name, symbol->addr) != 0) {
+            result = -1;
+        }
+    }
+    if (fixups->pending != 0) {
+        raise_unresolved(fixups);
+        result = -1;
+    }
+    write_words(text, output, flushed, text->len);
+
+    free_fixup_table(fixups);
+    free_word_buffer(text);
+    return result;
+}
+
 /*******************************
  * Do Not Modify Code Below
  *******************************/
@@ -222,12 +895,15 @@ int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl
 static int open_files(FILE** input, FILE** output, const char* input_name, 
     const char* output_name) {
     
+    trace_begin("open files", input_name);
     *input = fopen(input_name, "r");
     if (!*input) {
         write_to_log("Error: unable to open input file: %s\n", input_name);
+        trace_end("open files");
         return -1;
     }
     *output = fopen(output_name, "w");
+    trace_end("open files");
     if (!*output) {
         write_to_log("Error: unable to open output file: %s\n", output_name);
         fclose(*input);
@@ -241,79 +917,616 @@ static void close_files(FILE* input, FILE* output) {
     fclose(output);
 }
 
+/* Reorders the blocks of PROGRAM using the counts file named in OPTIONS.
+   Returns 0 on success and -1 on error.
+ */
+static int apply_profile(Program* program, SymbolTable* symtbl) {
+    FILE* file = fopen(options.profile, "r");
+    if (!file) {
+        write_to_log("Error: unable to open profile: %s\n", options.profile);
+        return -1;
+    }
+    Profile* profile = read_profile(file, symtbl, program->len);
+    fclose(file);
+    if (!profile) {
+        return -1;
+    }
+    printf("Laying out blocks from profile: %s\n", options.profile);
+    layout_program(program, symtbl, profile);
+    free_profile(profile);
+    return 0;
+}
+
+/* Loads the intermediate file TMP_NAME, runs the passes selected in OPTIONS
+   over it and writes it back. The addresses in SYMTBL are updated to match.
+   Block layout runs first, so profile addresses refer to the intermediate
+   file as pass one wrote it, and unreachable code is removed next. Branches
+   that cannot reach their labels are relaxed last, once every instruction
+   is in place. The label ids of each line in LABELS are recorded again for
+   the rewritten file. Returns 0 on success and -1 on error.
+ */
+static int rewrite_intermediate(const char* tmp_name, SymbolTable* symtbl,
+    LabelIds* labels) {
+    FILE* file = fopen(tmp_name, "r");
+    if (!file) {
+        write_to_log("Error: unable to open intermediate file: %s\n", tmp_name);
+        return -1;
+    }
+    Program* program = read_program(file, symtbl);
+    fclose(file);
+    if (!program) {
+        write_to_log("Error: malformed intermediate file: %s\n", tmp_name);
+        return -1;
+    }
+
+    if (options.profile && apply_profile(program, symtbl) != 0) {
+        free_program(program);
+        return -1;
+    }
+    if (options.gc_sections) {
+        printf("Removing unreachable code: %s\n", tmp_name);
+        if (gc_program(program, symtbl, options.entry) == -1) {
+            free_program(program);
+            return -1;
+        }
+    }
+    if (options.optimize) {
+        printf("Running peephole optimizer: %s\n", tmp_name);
+        optimize_program(program);
+    }
+    if (options.schedule) {
+        printf("Running scheduler: %s\n", tmp_name);
+        schedule_program(program);
+    }
+    uint32_t relaxed = relax_branches(program, symtbl, options.schedule);
+    if (relaxed > 0) {
+        printf("Relaxed %u out-of-range branches: %s\n", relaxed, tmp_name);
+    }
+
+    update_symbols(program, symtbl);
+    file = fopen(tmp_name, "w");
+    if (!file) {
+        write_to_log("Error: unable to open intermediate file: %s\n", tmp_name);
+        free_program(program);
+        return -1;
+    }
+    write_program(program, file);
+    fclose(file);
+
+    reset_label_ids(labels);
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        add_label_lines(labels, label_operand(labels, inst->name, inst->args,
+            inst->num_args), 1);
+    }
+    define_labels(labels, symtbl);
+    check_labels(labels);
+    free_program(program);
+    return 0;
+}
+
+/* Writes the cost report for TEXT to the file named in OPTIONS. Returns 0 on
+   success and -1 on error.
+ */
+static int write_report(WordBuffer* text, SymbolTable* symtbl, RelocTable* reltbl) {
+    FILE* report = fopen(options.cost_report, "w");
+    if (!report) {
+        write_to_log("Error: unable to open cost report file: %s\n", options.cost_report);
+        return -1;
+    }
+    printf("Writing cost report: %s\n", options.cost_report);
+    int err = write_cost_report(text, symtbl, reltbl, &options.cost_model,
+        options.schedule, report);
+    fclose(report);
+    return err;
+}
+
+/* Checks TEXT, the output of pass two, against the intermediate file
+   TMP_NAME. Returns 0 if every instruction matches and -1 otherwise.
+ */
+static int verify_output(const char* tmp_name, WordBuffer* text, SymbolTable* symtbl,
+    RelocTable* reltbl) {
+    FILE* file = fopen(tmp_name, "r");
+    if (!file) {
+        write_to_log("Error: unable to open intermediate file: %s\n", tmp_name);
+        return -1;
+    }
+    Program* program = read_program(file, symtbl);
+    fclose(file);
+    if (!program) {
+        write_to_log("Error: malformed intermediate file: %s\n", tmp_name);
+        return -1;
+    }
+    printf("Verifying output against: %s\n", tmp_name);
+    uint32_t errors = verify_program(program, text, symtbl, reltbl);
+    free_program(program);
+    return errors ? -1 : 0;
+}
+
+/* Prints how much of ARENA was used if --mem-stats was given. */
+static void print_mem_stats(Arena* arena) {
+    if (!options.mem_stats) {
+        return;
+    }
+    printf("Arena: %zu bytes high water, %zu bytes reserved in %u chunks, %u resets\n",
+        arena->high_water, arena->reserved, arena->num_chunks, arena->resets);
+}
+
 /* Runs the two-pass assembler. Most of the actual work is done in pass_one()
    and pass_two().
  */
 int assemble(const char* in_name, const char* tmp_name, const char* out_name) {
     FILE *src, *dst;
     int err = 0;
-    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
-    SymbolTable* reltbl = create_table(SYMTBL_NON_UNIQUE);
+    Arena* arena = create_arena(ARENA_CHUNK_SIZE);
+    SymbolTable* symtbl = create_table_in(SYMTBL_UNIQUE_NAME, arena);
+    RelocTable* reltbl = create_reloc_table_in(arena);
+    LabelIds* labels = in_name ? create_label_ids() : NULL;
+    DataSection* data = create_data_section(options.elf && options.big_endian);
 
     if (in_name) {
         printf("Running pass one: %s -> %s\n", in_name, tmp_name);
         if (open_files(&src, &dst, in_name, tmp_name) != 0) {
-            free_table(symtbl);
-            free_table(reltbl);
+            free_arena(arena);
             exit(1);
         }
 
-        if (pass_one(src, dst, symtbl) != 0) {
+        /* Pass one reads the source with its .include and .macro directives
+           expanded, and reports errors where each line came from.
+         */
+        SourceMap* map = create_source_map();
+        FILE* expanded = tmpfile();
+        if (!expanded) {
+            write_to_log("Error: unable to create a temporary file for %s\n", in_name);
+            exit(1);
+        }
+        perf_begin(options.perf);
+        trace_begin("preprocess", in_name);
+        if (preprocess(src, in_name, expanded, map) != 0) {
             err = 1;
         }
+        trace_end("preprocess");
+        perf_end(options.perf, "preprocess");
+        rewind(expanded);
 
+        perf_begin(options.perf);
+        trace_begin("pass one", in_name);
+        source_map = map;
+        if (pass_one(expanded, dst, symtbl, labels, data) != 0) {
+            err = 1;
+        }
+        source_map = NULL;
+        trace_end("pass one");
+        perf_end(options.perf, "pass one");
+
+        fclose(expanded);
+        free_source_map(map);
         close_files(src, dst);
+
+        if (!err && (options.optimize || options.schedule || options.profile
+            || options.gc_sections || labels->num_lines > BRANCH_RANGE)) {
+            perf_begin(options.perf);
+            trace_begin("rewrite", tmp_name);
+            if (rewrite_intermediate(tmp_name, symtbl, labels) != 0) {
+                err = 1;
+            }
+            trace_end("rewrite");
+            perf_end(options.perf, "rewrite");
+        }
     }
 
     if (out_name) {
         printf("Running pass two: %s -> %s\n", tmp_name, out_name);
         if (open_files(&src, &dst, tmp_name, out_name) != 0) {
-            free_table(symtbl);
-            free_table(reltbl);
+            free_arena(arena);
             exit(1);
         }
 
-        fprintf(dst, ".text\n");
-        if (pass_two(src, dst, symtbl, reltbl) != 0) {
+        /* An ELF object is written from TEXT once pass two is done, so
+           pass two formats nothing.
+         */
+        WordBuffer* text = (options.cost_report || options.verify || options.elf)
+            ? create_word_buffer() : NULL;
+        FILE* hex = options.elf ? NULL : dst;
+        if (hex) {
+            if (options.schedule) {
+                fprintf(dst, ".set noreorder\n");
+            }
+            fprintf(dst, ".text\n");
+        }
+        perf_begin(options.perf);
+        trace_begin("pass two", tmp_name);
+        int result = options.pipeline
+            ? pass_two_pipelined(src, hex, symtbl, reltbl, text, labels)
+            : pass_two(src, hex, symtbl, reltbl, text, labels);
+        if (result != 0) {
             err = 1;
         }
+        trace_end("pass two");
+        perf_end(options.perf, "pass two");
 
-        fprintf(dst, "\n.symbol\n");
-        write_table(symtbl, dst);
+        perf_begin(options.perf);
+        trace_begin("write tables", out_name);
+        if (options.elf) {
+            if (write_elf(text, data, symtbl, reltbl, options.big_endian, dst) != 0) {
+                write_to_log("Error: unable to write output file: %s\n", out_name);
+                err = 1;
+            }
+        } else {
+            if (data->len > 0) {
+                fprintf(dst, "\n.data\n");
+                write_data(data, dst);
+            }
+            fprintf(dst, "\n.symbol\n");
+            write_table(symtbl, dst);
 
-        fprintf(dst, "\n.relocation\n");
-        write_table(reltbl, dst);
+            fprintf(dst, "\n.relocation\n");
+            write_relocations(reltbl, dst);
+        }
 
         close_files(src, dst);
+        trace_end("write tables");
+        perf_end(options.perf, "write tables");
+
+        if (options.verify && !err) {
+            perf_begin(options.perf);
+            if (verify_output(tmp_name, text, symtbl, reltbl) != 0) {
+                err = 1;
+            }
+            perf_end(options.perf, "verify");
+        }
+        if (options.cost_report && !err) {
+            perf_begin(options.perf);
+            if (write_report(text, symtbl, reltbl) != 0) {
+                err = 1;
+            }
+            perf_end(options.perf, "cost report");
+        }
+        if (text) {
+            free_word_buffer(text);
+        }
     }
-    
+
+    if (labels) {
+        free_label_ids(labels);
+    }
+    free_data_section(data);
+    free_table(symtbl);
+    free_reloc_table(reltbl);
+    print_mem_stats(arena);
+    free_arena(arena);
+    return err;
+}
+
+/* Runs pass_single() from SRC, the file NAME, to DST and writes the data
+   section and the symbol and relocation tables after the text. As in assemble(), the source is
+   read with its .include and .macro directives expanded, and errors are
+   reported where each line came from. The tables are allocated from ARENA,
+   which the caller releases. Returns 0 on success and 1 on error.
+ */
+static int assemble_stream(FILE* src, const char* name, FILE* dst, Arena* arena) {
+    int err = 0;
+    SymbolTable* symtbl = create_table_in(SYMTBL_UNIQUE_NAME, arena);
+    RelocTable* reltbl = create_reloc_table_in(arena);
+    DataSection* data = create_data_section(0);
+
+    SourceMap* map = create_source_map();
+    FILE* expanded = tmpfile();
+    if (!expanded) {
+        write_to_log("Error: unable to create a temporary file for %s\n", name);
+        exit(1);
+    }
+    trace_begin("preprocess", name);
+    if (preprocess(src, name, expanded, map) != 0) {
+        err = 1;
+    }
+    trace_end("preprocess");
+    rewind(expanded);
+
+    fprintf(dst, ".text\n");
+    trace_begin("single pass", name);
+    source_map = map;
+    if (pass_single(expanded, dst, symtbl, reltbl, data) != 0) {
+        err = 1;
+    }
+    source_map = NULL;
+    trace_end("single pass");
+    fclose(expanded);
+    free_source_map(map);
+
+    trace_begin("write tables", NULL);
+    if (data->len > 0) {
+        fprintf(dst, "\n.data\n");
+        write_data(data, dst);
+    }
+    fprintf(dst, "\n.symbol\n");
+    write_table(symtbl, dst);
+
+    fprintf(dst, "\n.relocation\n");
+    write_relocations(reltbl, dst);
+    trace_end("write tables");
+    free_data_section(data);
     free_table(symtbl);
-    free_table(reltbl);
+    free_reloc_table(reltbl);
+    return err;
+}
+
+/* Runs the single-pass assembler. The work is done in pass_single(), and no
+   intermediate file is written.
+ */
+int assemble_single(const char* in_name, const char* out_name) {
+    FILE *src, *dst;
+
+    printf("Running single pass: %s -> %s\n", in_name, out_name);
+    if (open_files(&src, &dst, in_name, out_name) != 0) {
+        exit(1);
+    }
+    Arena* arena = create_arena(ARENA_CHUNK_SIZE);
+    perf_begin(options.perf);
+    int err = assemble_stream(src, in_name, dst, arena);
+    close_files(src, dst);
+    perf_end(options.perf, "single pass");
+    print_mem_stats(arena);
+    free_arena(arena);
+    return err;
+}
+
+/* One file of a batch. DATA is the input while it is being read and the
+   output while it is being written.
+ */
+typedef struct {
+    const char* in_name;
+    char* out_name;
+    int writing;
+    int err;
+    char* data;
+    size_t len;
+} BatchFile;
+
+/* Returns DIR/NAME with the directories and extension of NAME replaced by
+   DIR and ".out".
+ */
+static char* batch_output_name(const char* dir, const char* name) {
+    const char* base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    const char* ext = strrchr(base, '.');
+    size_t base_len = ext && ext != base ? (size_t) (ext - base) : strlen(base);
+    char* out_name = malloc(strlen(dir) + base_len + 6);
+    if (out_name == NULL) {
+        allocation_failed();
+    }
+    sprintf(out_name, "%s/%.*s.out", dir, (int) base_len, base);
+    return out_name;
+}
+
+/* Sets the output name of each of the NUM_INPUTS files in FILES from its
+   input name. Returns -1, having logged every clash, if two inputs with the
+   same base name would overwrite one output.
+ */
+static int set_batch_output_names(BatchFile* files, int num_inputs, const char* dir) {
+    uint32_t num_buckets = 16;
+    while (num_buckets < 2 * (uint32_t) num_inputs) {
+        num_buckets *= 2;
+    }
+    uint32_t* buckets = malloc(sizeof(uint32_t) * num_buckets);
+    if (buckets == NULL) {
+        allocation_failed();
+    }
+    memset(buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+
+    int err = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        files[i].out_name = batch_output_name(dir, files[i].in_name);
+        uint32_t b = hash_name(files[i].out_name) & (num_buckets - 1);
+        for (; buckets[b] != UINT32_MAX; b = (b + 1) & (num_buckets - 1)) {
+            if (strcmp(files[buckets[b]].out_name, files[i].out_name) == 0) {
+                write_to_log("Error: %s and %s would both be written to %s\n",
+                    files[buckets[b]].in_name, files[i].in_name, files[i].out_name);
+                err = -1;
+                break;
+            }
+        }
+        if (buckets[b] == UINT32_MAX) {
+            buckets[b] = i;
+        }
+    }
+    free(buckets);
     return err;
 }
 
+/* Assembles the input that has been read into FILE and starts writing the
+   result.
+ */
+static void assemble_batch_file(IoQueue* queue, BatchFile* file, Arena* arena) {
+    trace_begin("job", file->in_name);
+    FILE* src = fmemopen(file->data, file->len, "r");
+    FILE* dst = open_memstream(&file->data, &file->len);
+    char* input = file->data;
+    size_t input_len = file->len;
+    if (!src || !dst) {
+        allocation_failed();
+    }
+    int err = assemble_stream(src, file->in_name, dst, arena);
+    fclose(src);
+    fclose(dst);
+    free(input);
+    mem_count(MEM_IO, input_len + 1, 0);
+    mem_count(MEM_IO, 0, file->len + 1);
+    if (err) {
+        write_to_log("Error: assembly failed: %s\n", file->in_name);
+        file->err = 1;
+    }
+
+    file->writing = 1;
+    io_write_file(queue, file->out_name, file->data, file->len, file);
+    trace_end("job");
+}
+
+/* Assembles each of the NUM_INPUTS files in INPUTS with the single-pass
+   assembler into OUT_DIR. Up to the queue depth of inputs are read ahead,
+   and every output is written without waiting for it to finish. All files
+   share one arena, which is reset after each.
+ */
+int assemble_batch(const char* out_dir, char** inputs, int num_inputs) {
+    IoQueue* queue = create_io_queue(options.io_backend, options.io_depth);
+    BatchFile* files = calloc(num_inputs, sizeof(BatchFile));
+    if (files == NULL) {
+        allocation_failed();
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        files[i].in_name = inputs[i];
+    }
+    if (set_batch_output_names(files, num_inputs, out_dir) != 0) {
+        for (int i = 0; i < num_inputs; i++) {
+            free(files[i].out_name);
+        }
+        free(files);
+        free_io_queue(queue);
+        return 1;
+    }
+    printf("Running batch: %d files -> %s (%s, %u in flight)\n", num_inputs, out_dir,
+        io_backend_name(queue->backend), queue->depth);
+
+    Arena* arena = create_arena(ARENA_CHUNK_SIZE);
+    ArenaMark empty = arena_mark(arena);
+    perf_begin(options.perf);
+    int next = 0, reading = 0;
+    while (next < num_inputs && reading < queue->depth) {
+        io_read_file(queue, inputs[next], &files[next]);
+        next++;
+        reading++;
+    }
+
+    IoCompletion done;
+    for (;;) {
+        trace_begin("io wait", NULL);
+        int waited = io_wait(queue, &done);
+        trace_end("io wait");
+        if (waited != 0) {
+            break;
+        }
+        BatchFile* file = done.tag;
+        if (file->writing) {
+            if (done.result < 0) {
+                write_to_log("Error: unable to write output file: %s (%s)\n",
+                    file->out_name, strerror(-done.result));
+                file->err = 1;
+            }
+            free(file->data);
+            mem_count(MEM_IO, file->len + 1, 0);
+            continue;
+        }
+
+        reading--;
+        if (done.result < 0) {
+            write_to_log("Error: unable to open input file: %s (%s)\n",
+                file->in_name, strerror(-done.result));
+            if (done.data) {
+                free(done.data);
+                mem_count(MEM_IO, done.len + 1, 0);
+            }
+            file->err = 1;
+        } else {
+            file->data = done.data;
+            file->len = done.len;
+            assemble_batch_file(queue, file, arena);
+            arena_reset(arena, empty);
+        }
+        if (next < num_inputs) {
+            io_read_file(queue, inputs[next], &files[next]);
+            next++;
+            reading++;
+        }
+    }
+
+    perf_end(options.perf, "batch");
+
+    int failed = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        failed += files[i].err;
+        free(files[i].out_name);
+    }
+    printf("Assembled %d of %d files\n", num_inputs - failed, num_inputs);
+    print_mem_stats(arena);
+    free_arena(arena);
+    free(files);
+    free_io_queue(queue);
+    return failed ? 1 : 0;
+}
+
 static void print_usage_and_exit() {
     printf("Usage:\n");
     printf("  Runs both passes: assembler <input file> <intermediate file> <output file>\n");
     printf("  Run pass #1:      assembler -p1 <input file> <intermediate file>\n");
     printf("  Run pass #2:      assembler -p2 <intermediate file> <output file>\n");
+    printf("  Run single pass:  assembler -single <input file> <output file>\n");
+    printf("  Run a batch:      assembler -batch <output dir> <input files...>\n");
     printf("Append -log <file name> after any option to save log files to a text file.\n");
+    printf("Options for the two-pass assembler, appended after the file names:\n");
+    printf("  -O          run the peephole optimizer between pass one and pass two\n");
+    printf("  --schedule  fill branch delay slots and separate loads from their uses;\n");
+    printf("              the output starts with .set noreorder and runs with delay slots\n");
+    printf("  --pipeline  run pass two as reader, tokenizer, encoder and writer threads\n");
+    printf("  --verify    disassemble the output and check it against the intermediate file\n");
+    printf("  -f <text|elf>\n");
+    printf("              output format: the .text/.symbol/.relocation text file, or an\n");
+    printf("              ELF32 MIPS relocatable object\n");
+    printf("  -EB, -EL    write the ELF object big-endian (default) or little-endian\n");
+    printf("  --gc-sections\n");
+    printf("              remove code that cannot be reached from the entry through\n");
+    printf("              fall-through, jumps, branches and label references\n");
+    printf("  --entry <label>\n");
+    printf("              where --gc-sections starts (default: the first instruction)\n");
+    printf("  --profile <file>\n");
+    printf("              reorder basic blocks using execution counts per address or\n");
+    printf("              label, such as the profile written by mipsrun\n");
+    printf("  --cost-report <file>\n");
+    printf("              write estimated cycles, stalls and critical path per label\n");
+    printf("  --cost-model <load-use stall>,<branch penalty>[,<pipeline depth>]\n");
+    printf("              pipeline used for --cost-report (default 1,1,5)\n");
+    printf("Options for every mode:\n");
+    printf("  --mem-stats print the peak and reserved memory of the symbol and relocation\n");
+    printf("              tables\n");
+    printf("  --mem-report\n");
+    printf("              print allocations, peak bytes and unused capacity per subsystem\n");
+    printf("              (symbol table, relocations, names, I/O buffers, IR) and peak RSS\n");
+    printf("  --trace <file>\n");
+    printf("              write a Chrome trace-event timeline of every thread to a JSON\n");
+    printf("              file, for chrome://tracing or Perfetto\n");
+    printf("  --perf-counters\n");
+    printf("              print cycles, instructions, branch, L1d, LLC and dTLB misses per\n");
+    printf("              phase from the hardware counters, where perf_event_open allows\n");
+    printf("Options for -batch, which runs the single-pass assembler on every input:\n");
+    printf("  --io <uring|stdio>\n");
+    printf("              file I/O backend (default io_uring where the kernel has it)\n");
+    printf("  --io-depth <count>\n");
+    printf("              files open at once with io_uring (default %u)\n", DEFAULT_IO_DEPTH);
     exit(0);
 }
 
 int main(int argc, char **argv) {
-    if (argc != 4 && argc != 6) {
+    if (argc < 4) {
         print_usage_and_exit();
     }
 
+    options.cost_model = DEFAULT_COST_MODEL;
+    options.io_backend = IO_BACKEND_AUTO;
+    options.big_endian = 1;
+    options.io_depth = DEFAULT_IO_DEPTH;
+
     int mode = 0;
     if (strcmp(argv[1], "-p1") == 0) {
         mode = 1;
     } else if (strcmp(argv[1], "-p2") == 0) {
         mode = 2;
+    } else if (strcmp(argv[1], "-single") == 0) {
+        mode = 3;
+    } else if (strcmp(argv[1], "-batch") == 0) {
+        mode = 4;
     }
 
-    char *input, *inter, *output;
+    char *input, *inter, *output, *log_name = NULL;
+    int next_arg = 4, perf_counters = 0;
     if (mode == 1) {
         input = argv[2];
         inter = argv[3];
@@ -322,21 +1535,124 @@ int main(int argc, char **argv) {
         input = NULL;
         inter = argv[2];
         output = argv[3];
+    } else if (mode == 3) {
+        input = argv[2];
+        inter = NULL;
+        output = argv[3];
+    } else if (mode == 4) {
+        input = NULL;
+        inter = NULL;
+        output = argv[2];
+        for (next_arg = 3; next_arg < argc && argv[next_arg][0] != '-'; next_arg++);
+        if (next_arg == 3) {
+            print_usage_and_exit();
+        }
     } else {
         input = argv[1];
         inter = argv[2];
         output = argv[3];
     }
 
-    if (argc == 6) {
-        if (strcmp(argv[4], "-log") == 0) {
-            set_log_file(argv[5]);
+    for (int i = next_arg; i < argc; i++) {
+        if (strcmp(argv[i], "-log") == 0 && i + 1 < argc) {
+            log_name = argv[++i];
+            set_log_file(log_name);
+        } else if (strcmp(argv[i], "-O") == 0) {
+            options.optimize = 1;
+        } else if (strcmp(argv[i], "--schedule") == 0) {
+            options.schedule = 1;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            options.pipeline = 1;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            options.verify = 1;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            options.profile = argv[++i];
+        } else if (strcmp(argv[i], "--cost-report") == 0 && i + 1 < argc) {
+            options.cost_report = argv[++i];
+        } else if (strcmp(argv[i], "--cost-model") == 0 && i + 1 < argc) {
+            if (parse_cost_model(&options.cost_model, argv[++i]) != 0) {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "elf") == 0) {
+                options.elf = 1;
+            } else if (strcmp(argv[i], "text") == 0) {
+                options.elf = 0;
+            } else {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(argv[i], "-EB") == 0) {
+            options.big_endian = 1;
+        } else if (strcmp(argv[i], "-EL") == 0) {
+            options.big_endian = 0;
+        } else if (strcmp(argv[i], "--gc-sections") == 0) {
+            options.gc_sections = 1;
+        } else if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc) {
+            options.entry = argv[++i];
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            options.mem_stats = 1;
+        } else if (strcmp(argv[i], "--mem-report") == 0) {
+            enable_mem_report();
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.trace = argv[++i];
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            perf_counters = 1;
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "uring") == 0) {
+                options.io_backend = IO_BACKEND_URING;
+            } else if (strcmp(argv[i], "stdio") == 0) {
+                options.io_backend = IO_BACKEND_STDIO;
+            } else {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(argv[i], "--io-depth") == 0 && i + 1 < argc) {
+            options.io_depth = strtoul(argv[++i], NULL, 0);
+            if (options.io_depth == 0) {
+                print_usage_and_exit();
+            }
         } else {
             print_usage_and_exit();
         }
     }
 
-    int err = assemble(input, inter, output);
+    if ((options.optimize || options.schedule || options.pipeline || options.verify
+        || options.profile || options.cost_report || options.gc_sections
+        || options.entry) && (mode == 3 || mode == 4)) {
+        write_to_log("Error: -O, --schedule, --pipeline, --verify, --profile, --cost-report, "
+            "--gc-sections and --entry need the two-pass assembler\n");
+        return 1;
+    }
+    if (options.elf && (mode == 3 || mode == 4)) {
+        write_to_log("Error: -f elf is written from pass two; it needs the two-pass assembler or -p2\n");
+        return 1;
+    }
+
+    /* Where the counters are unavailable this is NULL and nothing is reported. */
+    if (perf_counters) {
+        options.perf = open_perf_counters();
+    }
+    if (options.trace) {
+        enable_trace();
+        trace_thread_name("main");
+    }
+
+    int err;
+    if (mode == 4) {
+        err = assemble_batch(output, argv + 3, next_arg - 3);
+    } else if (mode == 3) {
+        err = assemble_single(input, output);
+    } else {
+        err = assemble(input, inter, output);
+    }
+
+    if (is_mem_report_enabled()) {
+        write_mem_report(stdout);
+    }
+    write_perf_report(options.perf, stdout);
+    close_perf_counters(options.perf);
+    free_preprocessor_cache();
 
     if (err) {
         write_to_log("One or more errors encountered during assembly operation.\n");
@@ -345,7 +1661,11 @@ int main(int argc, char **argv) {
     }
 
     if (is_log_file_set()) {
-        printf("Results saved to %s\n", argv[5]);
+        printf("Results saved to %s\n", log_name);
+    }
+
+    if (options.trace && write_trace(options.trace) != 0) {
+        err = 1;
     }
 
     return err;
@@ -3,8 +3,20 @@
 
 int assemble(const char* in_name, const char* tmp_name, const char* out_name);
 
-int pass_one(FILE *input, FILE* output, SymbolTable* symtbl);
+int pass_one(FILE *input, FILE* output, SymbolTable* symtbl, LabelIds* labels,
+    DataSection* data);
 
-int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl);
+int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, RelocTable* reltbl,
+    WordBuffer* text, LabelIds* labels);
+
+int pass_two_pipelined(FILE* input, FILE* output, SymbolTable* symtbl,
+    RelocTable* reltbl, WordBuffer* text, LabelIds* labels);
+
+int assemble_single(const char* in_name, const char* out_name);
+
+int pass_single(FILE* input, FILE* output, SymbolTable* symtbl, RelocTable* reltbl,
+    DataSection* data);
+
+int assemble_batch(const char* out_dir, char** inputs, int num_inputs);
 
 #endif
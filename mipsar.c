@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/utils.h"
+#include "src/tables.h"
+#include "src/reloc.h"
+#include "src/words.h"
+#include "src/data.h"
+#include "src/object.h"
+#include "src/archive.h"
+
+static void print_usage_and_exit() {
+    printf("Usage:\n");
+    printf("  Create:         mipsar -c <archive> <output files...>\n");
+    printf("  List members:   mipsar -t <archive>\n");
+    printf("  Find symbols:   mipsar -s <archive> <symbols...>\n");
+    printf("  Extract member: mipsar -x <archive> <member> [-o <file>]\n");
+    printf("Packs output files of the assembler into one archive with a hash index\n");
+    printf("from symbol name to member, so that a symbol is found without reading the\n");
+    printf("members. -s prints the member and address of each symbol.\n");
+    printf("Append -log <file name> to save log files to a text file.\n");
+    exit(0);
+}
+
+/* Reads the whole file NAME into *DATA and *SIZE. Returns 0 on success. */
+static int read_file(const char* name, char** data, size_t* size) {
+    FILE* file = fopen(name, "rb");
+    if (!file) {
+        write_to_log("Error: unable to open input file: %s\n", name);
+        return -1;
+    }
+    size_t cap = 4096, len = 0, n;
+    char* buf = malloc(cap);
+    if (buf == NULL) {
+        allocation_failed();
+    }
+    while ((n = fread(buf + len, 1, cap - len, file)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+            if (buf == NULL) {
+                allocation_failed();
+            }
+        }
+    }
+    fclose(file);
+    *data = buf;
+    *size = len;
+    return 0;
+}
+
+/* Members are named after the files without their directories. */
+static int create(const char* ar_name, char** paths, int num) {
+    char** names = calloc(num, sizeof(char*));
+    char** contents = calloc(num, sizeof(char*));
+    size_t* sizes = calloc(num, sizeof(size_t));
+    if (!names || !contents || !sizes) {
+        allocation_failed();
+    }
+    int err = 0;
+    for (int i = 0; i < num; i++) {
+        names[i] = strrchr(paths[i], '/') ? strrchr(paths[i], '/') + 1 : paths[i];
+        if (read_file(paths[i], &contents[i], &sizes[i]) != 0) {
+            err = 1;
+        }
+    }
+
+    FILE* output = err ? NULL : fopen(ar_name, "wb");
+    if (!err && !output) {
+        write_to_log("Error: unable to open output file: %s\n", ar_name);
+        err = 1;
+    }
+    if (output) {
+        err = write_archive(output, names, contents, sizes, num) != 0;
+        fclose(output);
+        if (err) {
+            remove(ar_name);
+        }
+    }
+    for (int i = 0; i < num; i++) {
+        free(contents[i]);
+    }
+    free(names);
+    free(contents);
+    free(sizes);
+    return err;
+}
+
+static int list(const Archive* archive) {
+    for (uint32_t i = 0; i < archive->header->num_members; i++) {
+        printf("%s\t%u\n", archive_member_name(archive, i), archive->members[i].size);
+    }
+    return 0;
+}
+
+static int find(const Archive* archive, char** symbols, int num) {
+    int err = 0;
+    for (int i = 0; i < num; i++) {
+        uint32_t addr;
+        int64_t member = find_archive_symbol(archive, symbols[i], &addr);
+        if (member == -1) {
+            write_to_log("Error: symbol not found: %s\n", symbols[i]);
+            err = 1;
+        } else {
+            printf("%s\t%s\t%u\n", symbols[i], archive_member_name(archive, member), addr);
+        }
+    }
+    return err;
+}
+
+static int extract(const Archive* archive, const char* name, const char* out_name) {
+    int64_t member = find_archive_member(archive, name);
+    if (member == -1) {
+        write_to_log("Error: member not found: %s\n", name);
+        return 1;
+    }
+    FILE* output = fopen(out_name ? out_name : name, "wb");
+    if (!output) {
+        write_to_log("Error: unable to open output file: %s\n", out_name ? out_name : name);
+        return 1;
+    }
+    const ArchiveMember* m = &archive->members[member];
+    fwrite(archive->base + m->offset, 1, m->size, output);
+    fclose(output);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3 || argv[1][0] != '-' || strlen(argv[1]) != 2
+        || !strchr("ctsx", argv[1][1])) {
+        print_usage_and_exit();
+    }
+    char mode = argv[1][1];
+    const char* ar_name = argv[2];
+    const char* out_name = NULL;
+
+    /* Operands come first; options follow them. */
+    int num = 0;
+    char** operands = argv + 3;
+    while (3 + num < argc && argv[3 + num][0] != '-') {
+        num++;
+    }
+    for (int i = 3 + num; i < argc; i++) {
+        if (strcmp(argv[i], "-log") == 0 && i + 1 < argc) {
+            set_log_file(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc && mode == 'x') {
+            out_name = argv[++i];
+        } else {
+            print_usage_and_exit();
+        }
+    }
+    if ((mode == 't') != (num == 0) || (mode == 'x' && num != 1)) {
+        print_usage_and_exit();
+    }
+
+    if (mode == 'c') {
+        return create(ar_name, operands, num);
+    }
+    Archive* archive = open_archive(ar_name);
+    if (!archive) {
+        return 1;
+    }
+    int err;
+    if (mode == 't') {
+        err = list(archive);
+    } else if (mode == 's') {
+        err = find(archive, operands, num);
+    } else {
+        err = extract(archive, operands[0], out_name);
+    }
+    close_archive(archive);
+    return err;
+}
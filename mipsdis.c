@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/utils.h"
+#include "src/tables.h"
+#include "src/reloc.h"
+#include "src/words.h"
+#include "src/data.h"
+#include "src/object.h"
+#include "src/disasm.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+static void print_usage_and_exit() {
+    printf("Usage: mipsdis [options] <output file>\n");
+    printf("Disassembles the .text section of an output file of the assembler, naming\n");
+    printf("branch targets and jumps after the .symbol and .relocation sections.\n");
+    printf("  -a          write the address of every instruction as a comment\n");
+    printf("  -o <file>   write the disassembly to a file instead of stdout\n");
+    printf("Append -log <file name> to save log files to a text file.\n");
+    exit(0);
+}
+
+int main(int argc, char **argv) {
+    const char *obj_name = NULL, *out_name = NULL;
+    int show_addrs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0) {
+            show_addrs = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_name = argv[++i];
+        } else if (strcmp(argv[i], "-log") == 0 && i + 1 < argc) {
+            set_log_file(argv[++i]);
+        } else if (argv[i][0] != '-' && !obj_name) {
+            obj_name = argv[i];
+        } else {
+            print_usage_and_exit();
+        }
+    }
+    if (!obj_name) {
+        print_usage_and_exit();
+    }
+
+    FILE* input = fopen(obj_name, "r");
+    if (!input) {
+        write_to_log("Error: unable to open input file: %s\n", obj_name);
+        return 1;
+    }
+    Object* object = read_object(input);
+    fclose(input);
+    if (!object) {
+        write_to_log("Error: unable to load %s\n", obj_name);
+        return 1;
+    }
+
+    FILE* output = out_name ? fopen(out_name, "w") : stdout;
+    if (!output) {
+        write_to_log("Error: unable to open output file: %s\n", out_name);
+        free_object(object);
+        return 1;
+    }
+    setvbuf(output, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    TextSymbols* syms = create_text_symbols(object->text->words, object->text->len,
+        object->symbols, object->relocations);
+    uint32_t errors = write_disassembly(object->text->words, syms, show_addrs, output);
+    if (errors) {
+        write_to_log("Error: %u words could not be decoded\n", errors);
+    }
+
+    if (out_name) {
+        fclose(output);
+    } else {
+        fflush(output);
+    }
+    free_text_symbols(syms);
+    free_object(object);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/utils.h"
+#include "src/tables.h"
+#include "src/reloc.h"
+#include "src/words.h"
+#include "src/data.h"
+#include "src/object.h"
+#include "src/cache.h"
+#include "src/sim.h"
+
+static const uint32_t DEFAULT_DATA_SIZE = 1 << 22;
+static const uint32_t DEFAULT_STACK_SIZE = 1 << 20;
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void print_usage_and_exit() {
+    printf("Usage: mipsrun [options] <output file>\n");
+    printf("Runs an output file of the assembler from address 0. The program stops\n");
+    printf("when it falls off the end of .text or returns with jr $ra. Files\n");
+    printf("assembled with --schedule are run with branch delay slots.\n");
+    printf("  -n <count>   stop at the first jump or taken branch after this many instructions\n");
+    printf("  -m <bytes>   size of the data segment at 0x%08x\n", DATA_BASE);
+    printf("  -p <file>    write the execution profile to a file instead of stdout\n");
+    printf("  -q           do not write the execution profile\n");
+    printf("  --cache <file>\n");
+    printf("               simulate the caches and write their miss rates per label and\n");
+    printf("               per instruction to a file ('-' for stdout)\n");
+    printf("  --l1i, --l1d, --l2 <size>,<line size>,<ways>[,lru|random]\n");
+    printf("               geometry and replacement of each cache for --cache (default\n");
+    printf("               32768,64,8 for the L1 caches and 262144,64,8 for the L2, LRU)\n");
+    printf("Append -log <file name> to save log files to a text file.\n");
+    exit(0);
+}
+
+int main(int argc, char **argv) {
+    const char *obj_name = NULL, *profile_name = NULL, *cache_name = NULL;
+    uint64_t max_steps = 0;
+    uint32_t data_size = DEFAULT_DATA_SIZE;
+    int quiet = 0;
+    CacheConfig l1i = DEFAULT_L1I, l1d = DEFAULT_L1D, l2 = DEFAULT_L2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            max_steps = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            data_size = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profile_name = argv[++i];
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_name = argv[++i];
+        } else if (strcmp(argv[i], "--l1i") == 0 && i + 1 < argc) {
+            if (parse_cache_config(&l1i, argv[++i]) != 0) {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(argv[i], "--l1d") == 0 && i + 1 < argc) {
+            if (parse_cache_config(&l1d, argv[++i]) != 0) {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(argv[i], "--l2") == 0 && i + 1 < argc) {
+            if (parse_cache_config(&l2, argv[++i]) != 0) {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(argv[i], "-log") == 0 && i + 1 < argc) {
+            set_log_file(argv[++i]);
+        } else if (argv[i][0] != '-' && !obj_name) {
+            obj_name = argv[i];
+        } else {
+            print_usage_and_exit();
+        }
+    }
+    if (!obj_name || data_size < 4) {
+        print_usage_and_exit();
+    }
+
+    FILE* input = fopen(obj_name, "r");
+    if (!input) {
+        write_to_log("Error: unable to open input file: %s\n", obj_name);
+        return 1;
+    }
+    Object* object = read_object(input);
+    fclose(input);
+    if (object && object->data->len > data_size) {
+        write_to_log("Error: .data needs %u bytes, more than the data segment (-m)\n",
+            object->data->len);
+        free_object(object);
+        object = NULL;
+    }
+    if (!object || link_object(object) != 0) {
+        write_to_log("Error: unable to load %s\n", obj_name);
+        if (object) {
+            free_object(object);
+        }
+        return 1;
+    }
+
+    Machine* m = create_machine(object->text->words, object->text->len, data_size,
+        DEFAULT_STACK_SIZE);
+    memcpy(m->data, object->data->bytes, object->data->len);
+    m->max_steps = max_steps;
+    m->delay_slots = object->delay_slots;
+    if (cache_name) {
+        m->caches = create_cache_sim(&l1i, &l1d, &l2, m->text_len);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int err = run_machine(m);
+    double elapsed = seconds_since(&start);
+
+    if (err) {
+        write_to_log("Error: %s at address %u\n", m->fault, m->pc);
+    }
+    printf("Executed %llu instructions in %.3f s (%.1f million/s)\n",
+        (unsigned long long) m->executed, elapsed,
+        elapsed > 0 ? m->executed / elapsed / 1e6 : 0.0);
+    printf("$v0 = %d\n", (int32_t) m->regs[2]);
+
+    if (!quiet) {
+        FILE* output = profile_name ? fopen(profile_name, "w") : stdout;
+        if (!output) {
+            write_to_log("Error: unable to open profile file: %s\n", profile_name);
+            err = 1;
+        } else {
+            write_profile(m, object->symbols, output);
+            if (profile_name) {
+                fclose(output);
+            }
+        }
+    }
+
+    if (m->caches) {
+        FILE* output = strcmp(cache_name, "-") ? fopen(cache_name, "w") : stdout;
+        if (!output) {
+            write_to_log("Error: unable to open cache report file: %s\n", cache_name);
+            err = 1;
+        } else {
+            write_cache_report(m->caches, m->counts, object->symbols, output);
+            if (output != stdout) {
+                fclose(output);
+            }
+        }
+        free_cache_sim(m->caches);
+    }
+
+    free_machine(m);
+    free_object(object);
+    return err ? 1 : 0;
+}
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "tables.h"
+#include "memstat.h"
+#include "aio.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+const int IO_BACKEND_AUTO = 0;
+const int IO_BACKEND_STDIO = 1;
+const int IO_BACKEND_URING = 2;
+
+/* The first read of a file asks for this much; the buffer doubles after. */
+#define IO_READ_CHUNK (64 * 1024)
+
+enum { IO_READ, IO_WRITE };
+enum { IO_OPENING, IO_TRANSFER, IO_CLOSING };
+
+/* One whole-file read or write. OFF is how many bytes have been transferred
+   so far, CAP the size of DATA for a read.
+ */
+struct IoRequest {
+    int kind;
+    int state;
+    char* path;
+    int fd;
+    char* data;
+    size_t len;
+    size_t cap;
+    int result;
+    void* tag;
+    IoRequest* next;
+};
+
+static IoRequest* create_request(int kind, const char* path, void* tag) {
+    IoRequest* req = calloc(1, sizeof(IoRequest));
+    if (req == NULL) {
+        allocation_failed();
+    }
+    req->path = malloc(strlen(path) + 1);
+    if (req->path == NULL) {
+        allocation_failed();
+    }
+    strcpy(req->path, path);
+    req->kind = kind;
+    req->tag = tag;
+    req->fd = -1;
+    return req;
+}
+
+/* Read buffers are trimmed to the file, so a completion holds LEN + 1
+   bytes.
+ */
+static void finish_request(IoQueue* queue, IoRequest* req) {
+    if (req->kind == IO_READ && req->data) {
+        req->data[req->len] = '\0';
+        mem_count(MEM_IO, req->cap, req->len + 1);
+        mem_unused(MEM_IO, -(int64_t) (req->cap - req->len - 1));
+        req->data = realloc(req->data, req->len + 1);
+        if (req->data == NULL) {
+            allocation_failed();
+        }
+    }
+    req->next = NULL;
+    if (queue->done_tail) {
+        queue->done_tail->next = req;
+    } else {
+        queue->done_head = req;
+    }
+    queue->done_tail = req;
+}
+
+/* Makes room for at least one more byte to be read into REQ. */
+static void grow_read_buffer(IoRequest* req) {
+    if (req->len + 1 < req->cap) {
+        return;
+    }
+    size_t cap = req->cap ? 2 * req->cap : IO_READ_CHUNK + 1;
+    mem_count(MEM_IO, req->cap, cap);
+    mem_unused(MEM_IO, cap - req->cap);
+    req->cap = cap;
+    req->data = realloc(req->data, req->cap);
+    if (req->data == NULL) {
+        allocation_failed();
+    }
+}
+
+/*******************************
+ * stdio Backend
+ *******************************/
+
+static void stdio_read(IoRequest* req) {
+    FILE* file = fopen(req->path, "rb");
+    if (!file) {
+        req->result = -errno;
+        return;
+    }
+    size_t n;
+    do {
+        grow_read_buffer(req);
+        n = fread(req->data + req->len, 1, req->cap - 1 - req->len, file);
+        req->len += n;
+    } while (n > 0);
+    if (ferror(file)) {
+        req->result = -EIO;
+    }
+    fclose(file);
+}
+
+static void stdio_write(IoRequest* req) {
+    FILE* file = fopen(req->path, "wb");
+    if (!file) {
+        req->result = -errno;
+        return;
+    }
+    if (fwrite(req->data, 1, req->len, file) != req->len) {
+        req->result = -EIO;
+    }
+    if (fclose(file) != 0 && req->result == 0) {
+        req->result = -errno;
+    }
+}
+
+/*******************************
+ * io_uring Backend
+ *******************************/
+
+#ifdef HAVE_IO_URING
+
+/* The rings shared with the kernel, mapped as described in io_uring(7). */
+struct IoRing {
+    int fd;
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t* sq_array;
+    struct io_uring_sqe* sqes;
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe* cqes;
+    uint32_t to_submit;
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+};
+
+static void unmap_ring(IoRing* ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+/* Sets up an io_uring with ENTRIES submission slots, or returns NULL if the
+   kernel does not allow it.
+ */
+static IoRing* create_ring_fd(uint32_t entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return NULL;
+    }
+    IoRing* ring = calloc(1, sizeof(IoRing));
+    if (ring == NULL) {
+        allocation_failed();
+    }
+    ring->fd = fd;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) {
+            ring->sq_size = ring->cq_size;
+        }
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        unmap_ring(ring);
+        return NULL;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->cq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        unmap_ring(ring);
+        return NULL;
+    }
+
+    char* sq = ring->sq_ptr;
+    char* cq = ring->cq_ptr;
+    ring->sq_head = (uint32_t*) (sq + params.sq_off.head);
+    ring->sq_tail = (uint32_t*) (sq + params.sq_off.tail);
+    ring->sq_mask = *(uint32_t*) (sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_array = (uint32_t*) (sq + params.sq_off.array);
+    ring->cq_head = (uint32_t*) (cq + params.cq_off.head);
+    ring->cq_tail = (uint32_t*) (cq + params.cq_off.tail);
+    ring->cq_mask = *(uint32_t*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return ring;
+}
+
+/* Submits the queued entries and, if WAIT is set, waits for a completion. */
+static void enter_ring(IoRing* ring, int wait) {
+    unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+    int n;
+    do {
+        n = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait ? 1 : 0,
+            flags, NULL, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        ring->to_submit -= n < ring->to_submit ? n : ring->to_submit;
+    }
+}
+
+/* Returns a cleared submission entry for REQ. It is handed to the kernel at
+   the next enter_ring().
+ */
+static struct io_uring_sqe* get_sqe(IoRing* ring, IoRequest* req, int opcode) {
+    uint32_t tail = *ring->sq_tail;
+    while (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->sq_entries) {
+        enter_ring(ring, 0);
+    }
+    uint32_t index = tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = (uintptr_t) req;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+    return sqe;
+}
+
+static void submit_open(IoRing* ring, IoRequest* req) {
+    struct io_uring_sqe* sqe = get_sqe(ring, req, IORING_OP_OPENAT);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t) req->path;
+    if (req->kind == IO_READ) {
+        sqe->open_flags = O_RDONLY;
+    } else {
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+        sqe->len = 0666;
+    }
+    req->state = IO_OPENING;
+}
+
+static void submit_transfer(IoRing* ring, IoRequest* req) {
+    struct io_uring_sqe* sqe;
+    if (req->kind == IO_READ) {
+        grow_read_buffer(req);
+        sqe = get_sqe(ring, req, IORING_OP_READ);
+        sqe->addr = (uintptr_t) (req->data + req->len);
+        sqe->len = req->cap - 1 - req->len;
+    } else {
+        sqe = get_sqe(ring, req, IORING_OP_WRITE);
+        sqe->addr = (uintptr_t) (req->data + req->cap);
+        sqe->len = req->len - req->cap;
+    }
+    sqe->fd = req->fd;
+    sqe->off = req->kind == IO_READ ? req->len : req->cap;
+    req->state = IO_TRANSFER;
+}
+
+static void submit_close(IoRing* ring, IoRequest* req) {
+    struct io_uring_sqe* sqe = get_sqe(ring, req, IORING_OP_CLOSE);
+    sqe->fd = req->fd;
+    req->state = IO_CLOSING;
+}
+
+/* Moves REQ to its next step now that its last operation returned RES. A
+   write keeps the number of bytes written so far in CAP.
+ */
+static void advance_request(IoQueue* queue, IoRequest* req, int res) {
+    IoRing* ring = queue->ring;
+    if (req->state == IO_OPENING) {
+        if (res < 0) {
+            req->result = res;
+            queue->active--;
+            finish_request(queue, req);
+            return;
+        }
+        req->fd = res;
+        if (req->kind == IO_WRITE && req->len == 0) {
+            submit_close(ring, req);
+        } else {
+            submit_transfer(ring, req);
+        }
+    } else if (req->state == IO_TRANSFER) {
+        if (res < 0) {
+            req->result = res;
+            submit_close(ring, req);
+        } else if (req->kind == IO_READ) {
+            req->len += res;
+            if (res == 0) {
+                submit_close(ring, req);
+            } else {
+                submit_transfer(ring, req);
+            }
+        } else {
+            req->cap += res;
+            if (res == 0) {
+                req->result = -EIO;
+            }
+            if (res == 0 || req->cap == req->len) {
+                submit_close(ring, req);
+            } else {
+                submit_transfer(ring, req);
+            }
+        }
+    } else {
+        if (res < 0 && req->result == 0) {
+            req->result = res;
+        }
+        queue->active--;
+        finish_request(queue, req);
+    }
+}
+
+/* Submits everything queued, waits for at least one completion and handles
+   all completions that are ready.
+ */
+static void reap_ring(IoQueue* queue) {
+    IoRing* ring = queue->ring;
+    enter_ring(ring, 1);
+    uint32_t head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+        IoRequest* req = (IoRequest*) (uintptr_t) cqe->user_data;
+        int res = cqe->res;
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        advance_request(queue, req, res);
+    }
+}
+
+#endif
+
+/*******************************
+ * Queue
+ *******************************/
+
+IoQueue* create_io_queue(int backend, uint32_t depth) {
+    IoQueue* queue = calloc(1, sizeof(IoQueue));
+    if (queue == NULL) {
+        allocation_failed();
+    }
+    queue->depth = depth ? depth : 1;
+    queue->backend = IO_BACKEND_STDIO;
+#ifdef HAVE_IO_URING
+    if (backend != IO_BACKEND_STDIO) {
+        queue->ring = create_ring_fd(queue->depth);
+        if (queue->ring) {
+            queue->backend = IO_BACKEND_URING;
+        }
+    }
+#endif
+    return queue;
+}
+
+void free_io_queue(IoQueue* queue) {
+#ifdef HAVE_IO_URING
+    if (queue->ring) {
+        unmap_ring(queue->ring);
+    }
+#endif
+    free(queue);
+}
+
+const char* io_backend_name(int backend) {
+    return backend == IO_BACKEND_URING ? "io_uring" : "stdio";
+}
+
+/* Starts REQ, first waiting for a slot if DEPTH requests are in flight. */
+static void start_request(IoQueue* queue, IoRequest* req) {
+#ifdef HAVE_IO_URING
+    if (queue->backend == IO_BACKEND_URING) {
+        while (queue->active >= queue->depth) {
+            reap_ring(queue);
+        }
+        queue->active++;
+        submit_open(queue->ring, req);
+        if (queue->ring->to_submit >= queue->depth / 2) {
+            enter_ring(queue->ring, 0);
+        }
+        return;
+    }
+#endif
+    if (req->kind == IO_READ) {
+        stdio_read(req);
+    } else {
+        stdio_write(req);
+    }
+    finish_request(queue, req);
+}
+
+void io_read_file(IoQueue* queue, const char* path, void* tag) {
+    start_request(queue, create_request(IO_READ, path, tag));
+}
+
+void io_write_file(IoQueue* queue, const char* path, char* data, size_t len,
+    void* tag) {
+    IoRequest* req = create_request(IO_WRITE, path, tag);
+    req->data = data;
+    req->len = len;
+    start_request(queue, req);
+}
+
+int io_wait(IoQueue* queue, IoCompletion* out) {
+#ifdef HAVE_IO_URING
+    while (!queue->done_head && queue->active > 0) {
+        reap_ring(queue);
+    }
+#endif
+    IoRequest* req = queue->done_head;
+    if (req == NULL) {
+        return -1;
+    }
+    queue->done_head = req->next;
+    if (queue->done_head == NULL) {
+        queue->done_tail = NULL;
+    }
+    out->tag = req->tag;
+    out->result = req->result;
+    out->data = req->data;
+    out->len = req->len;
+    free(req->path);
+    free(req);
+    return 0;
+}
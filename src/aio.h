@@ -0,0 +1,66 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+extern const int IO_BACKEND_AUTO;    // io_uring if the kernel has it, else stdio
+extern const int IO_BACKEND_STDIO;   // blocking fopen/fread/fwrite
+extern const int IO_BACKEND_URING;   // Linux io_uring
+
+/* A finished request. RESULT is 0 on success or a negative errno value.
+   For a read, DATA holds the LEN bytes of the file followed by a null byte,
+   and the caller must free() it; the LEN + 1 bytes count as MEM_IO for
+   --mem-report. For a write, DATA is the buffer that was
+   passed to io_write_file().
+ */
+typedef struct {
+    void* tag;
+    int result;
+    char* data;
+    size_t len;
+} IoCompletion;
+
+typedef struct IoRequest IoRequest;
+typedef struct IoRing IoRing;
+
+/* A queue of whole-file reads and writes. With io_uring, up to DEPTH files
+   are open at once and every open, read, write and close is submitted
+   without waiting for the others. With stdio, each request runs to
+   completion when it is submitted.
+ */
+typedef struct {
+    int backend;
+    uint32_t depth;
+    uint32_t active;
+    IoRing* ring;
+    IoRequest* done_head;
+    IoRequest* done_tail;
+} IoQueue;
+
+/* Creates a queue using BACKEND. IO_BACKEND_URING falls back to stdio if
+   io_uring cannot be set up; check the BACKEND field for the one in use.
+ */
+IoQueue* create_io_queue(int backend, uint32_t depth);
+
+/* Frees QUEUE. Every request must have been waited for. */
+void free_io_queue(IoQueue* queue);
+
+/* Returns the name of BACKEND, eg. "io_uring". */
+const char* io_backend_name(int backend);
+
+/* Starts reading the whole file PATH. TAG is returned in the completion. */
+void io_read_file(IoQueue* queue, const char* path, void* tag);
+
+/* Starts replacing the file PATH with the LEN bytes at DATA, which must stay
+   valid until the completion is returned.
+ */
+void io_write_file(IoQueue* queue, const char* path, char* data, size_t len,
+    void* tag);
+
+/* Waits for a request to finish and fills in OUT. Returns 0, or -1 if no
+   request is outstanding.
+ */
+int io_wait(IoQueue* queue, IoCompletion* out);
+
+#endif
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "words.h"
+#include "data.h"
+#include "object.h"
+#include "archive.h"
+
+#define EMPTY_BUCKET UINT32_MAX
+
+static uint32_t align4(uint32_t n) {
+    return (n + 3) & ~3u;
+}
+
+/*******************************
+ * Writing
+ *******************************/
+
+/* A growing string table. */
+typedef struct {
+    char* data;
+    uint32_t len;
+    uint32_t cap;
+} Strings;
+
+static uint32_t add_string(Strings* strings, const char* str) {
+    uint32_t len = strlen(str) + 1;
+    while (strings->len + len > strings->cap) {
+        strings->cap = strings->cap ? 2 * strings->cap : 1024;
+        strings->data = realloc(strings->data, strings->cap);
+        if (strings->data == NULL) {
+            allocation_failed();
+        }
+    }
+    uint32_t offset = strings->len;
+    memcpy(strings->data + offset, str, len);
+    strings->len += len;
+    return offset;
+}
+
+/* Returns the bucket NAME belongs in: the one holding it, or the empty one
+   that ends its probe sequence.
+ */
+static uint32_t find_bucket(const uint32_t* buckets, uint32_t num_buckets,
+    const ArchiveSymbol* symbols, const char* strings, const char* name,
+    uint32_t hash) {
+    uint32_t mask = num_buckets - 1;
+    uint32_t b = hash & mask;
+    while (buckets[b] != EMPTY_BUCKET) {
+        const ArchiveSymbol* sym = &symbols[buckets[b]];
+        if (sym->hash == hash && strcmp(strings + sym->name, name) == 0) {
+            break;
+        }
+        b = (b + 1) & mask;
+    }
+    return b;
+}
+
+int write_archive(FILE* output, char** names, char** contents, size_t* sizes,
+    uint32_t num) {
+    Strings strings = {NULL, 0, 0};
+    ArchiveMember* members = calloc(num ? num : 1, sizeof(ArchiveMember));
+    SymbolTable** tables = calloc(num ? num : 1, sizeof(SymbolTable*));
+    if (!members || !tables) {
+        allocation_failed();
+    }
+
+    int err = 0;
+    uint32_t total_symbols = 0;
+    for (uint32_t i = 0; i < num; i++) {
+        FILE* input = fmemopen(contents[i], sizes[i], "r");
+        Object* object = input ? read_object(input) : NULL;
+        if (input) {
+            fclose(input);
+        }
+        if (!object) {
+            write_to_log("Error: not an output file: %s\n", names[i]);
+            err = -1;
+            continue;
+        }
+        /* Only the symbol table is kept. */
+        tables[i] = object->symbols;
+        object->symbols = create_table(SYMTBL_UNIQUE_NAME);
+        free_object(object);
+        total_symbols += tables[i]->len;
+        members[i].name = add_string(&strings, names[i]);
+        members[i].size = sizes[i];
+    }
+
+    uint32_t num_buckets = 16;
+    while (num_buckets < 2 * total_symbols) {
+        num_buckets *= 2;
+    }
+    uint32_t* buckets = malloc(sizeof(uint32_t) * num_buckets);
+    ArchiveSymbol* symbols = malloc(sizeof(ArchiveSymbol) * (total_symbols ? total_symbols : 1));
+    if (!buckets || !symbols) {
+        allocation_failed();
+    }
+    memset(buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+
+    uint32_t num_symbols = 0;
+    for (uint32_t i = 0; !err && i < num; i++) {
+        for (uint32_t j = 0; j < tables[i]->len; j++) {
+            const char* name = tables[i]->tbl[j].name;
+            uint32_t hash = hash_name(name);
+            uint32_t b = find_bucket(buckets, num_buckets, symbols, strings.data,
+                name, hash);
+            if (buckets[b] != EMPTY_BUCKET) {
+                continue;
+            }
+            ArchiveSymbol* sym = &symbols[num_symbols];
+            sym->name = add_string(&strings, name);
+            sym->hash = hash;
+            sym->member = i;
+            sym->addr = tables[i]->tbl[j].addr;
+            buckets[b] = num_symbols++;
+        }
+    }
+
+    if (!err) {
+        ArchiveHeader header;
+        memset(&header, 0, sizeof(header));
+        strcpy(header.magic, ARCHIVE_MAGIC);
+        header.num_members = num;
+        header.num_buckets = num_buckets;
+        header.num_symbols = num_symbols;
+        header.members_off = sizeof(ArchiveHeader);
+        header.buckets_off = header.members_off + num * sizeof(ArchiveMember);
+        header.symbols_off = header.buckets_off + num_buckets * sizeof(uint32_t);
+        header.strings_off = header.symbols_off + num_symbols * sizeof(ArchiveSymbol);
+        header.strings_len = align4(strings.len);
+        uint32_t offset = header.strings_off + header.strings_len;
+        for (uint32_t i = 0; i < num; i++) {
+            members[i].offset = offset;
+            offset = align4(offset + members[i].size);
+        }
+
+        static const char zeros[4] = {0};
+        fwrite(&header, sizeof(header), 1, output);
+        fwrite(members, sizeof(ArchiveMember), num, output);
+        fwrite(buckets, sizeof(uint32_t), num_buckets, output);
+        fwrite(symbols, sizeof(ArchiveSymbol), num_symbols, output);
+        fwrite(strings.data, 1, strings.len, output);
+        fwrite(zeros, 1, header.strings_len - strings.len, output);
+        for (uint32_t i = 0; i < num; i++) {
+            fwrite(contents[i], 1, sizes[i], output);
+            fwrite(zeros, 1, align4(sizes[i]) - sizes[i], output);
+        }
+    }
+
+    for (uint32_t i = 0; i < num; i++) {
+        if (tables[i]) {
+            free_table(tables[i]);
+        }
+    }
+    free(tables);
+    free(members);
+    free(buckets);
+    free(symbols);
+    free(strings.data);
+    return err;
+}
+
+/*******************************
+ * Reading
+ *******************************/
+
+/* Returns 1 if COUNT items of SIZE bytes at OFFSET lie inside ARCHIVE. */
+static int in_bounds(const Archive* archive, uint64_t offset, uint64_t count,
+    uint64_t size) {
+    return offset % 4 == 0 && offset + count * size <= archive->size;
+}
+
+/* Checks every offset in the header and member table of ARCHIVE. */
+static int check_archive(const Archive* archive) {
+    const ArchiveHeader* h = archive->header;
+    if (archive->size < sizeof(ArchiveHeader)
+        || memcmp(h->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+        return -1;
+    }
+    if (!in_bounds(archive, h->members_off, h->num_members, sizeof(ArchiveMember))
+        || !in_bounds(archive, h->buckets_off, h->num_buckets, sizeof(uint32_t))
+        || !in_bounds(archive, h->symbols_off, h->num_symbols, sizeof(ArchiveSymbol))
+        || !in_bounds(archive, h->strings_off, h->strings_len, 1)
+        || h->num_buckets == 0 || (h->num_buckets & (h->num_buckets - 1)) != 0
+        || h->num_symbols >= h->num_buckets
+        || h->strings_len == 0) {
+        return -1;
+    }
+    const char* strings = (const char*) archive->base + h->strings_off;
+    if (strings[h->strings_len - 1] != '\0') {
+        return -1;
+    }
+    const ArchiveMember* members = (const ArchiveMember*) (archive->base + h->members_off);
+    for (uint32_t i = 0; i < h->num_members; i++) {
+        if (members[i].name >= h->strings_len
+            || !in_bounds(archive, members[i].offset, members[i].size, 1)) {
+            return -1;
+        }
+    }
+    const ArchiveSymbol* symbols = (const ArchiveSymbol*) (archive->base + h->symbols_off);
+    for (uint32_t i = 0; i < h->num_symbols; i++) {
+        if (symbols[i].name >= h->strings_len || symbols[i].member >= h->num_members) {
+            return -1;
+        }
+    }
+    const uint32_t* buckets = (const uint32_t*) (archive->base + h->buckets_off);
+    for (uint32_t i = 0; i < h->num_buckets; i++) {
+        if (buckets[i] != EMPTY_BUCKET && buckets[i] >= h->num_symbols) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+Archive* open_archive(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        write_to_log("Error: unable to open archive: %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(ArchiveHeader)) {
+        write_to_log("Error: malformed archive: %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        write_to_log("Error: unable to map archive: %s\n", path);
+        return NULL;
+    }
+
+    Archive* archive = malloc(sizeof(Archive));
+    if (archive == NULL) {
+        allocation_failed();
+    }
+    archive->base = base;
+    archive->size = st.st_size;
+    archive->header = base;
+    if (check_archive(archive) != 0) {
+        write_to_log("Error: malformed archive: %s\n", path);
+        close_archive(archive);
+        return NULL;
+    }
+    const ArchiveHeader* h = archive->header;
+    archive->members = (const ArchiveMember*) (archive->base + h->members_off);
+    archive->buckets = (const uint32_t*) (archive->base + h->buckets_off);
+    archive->symbols = (const ArchiveSymbol*) (archive->base + h->symbols_off);
+    archive->strings = (const char*) archive->base + h->strings_off;
+    return archive;
+}
+
+void close_archive(Archive* archive) {
+    munmap((void*) archive->base, archive->size);
+    free(archive);
+}
+
+int64_t find_archive_symbol(const Archive* archive, const char* name, uint32_t* addr) {
+    uint32_t hash = hash_name(name);
+    uint32_t b = find_bucket(archive->buckets, archive->header->num_buckets,
+        archive->symbols, archive->strings, name, hash);
+    if (archive->buckets[b] == EMPTY_BUCKET) {
+        return -1;
+    }
+    const ArchiveSymbol* sym = &archive->symbols[archive->buckets[b]];
+    if (addr) {
+        *addr = sym->addr;
+    }
+    return sym->member;
+}
+
+int64_t find_archive_member(const Archive* archive, const char* name) {
+    for (uint32_t i = 0; i < archive->header->num_members; i++) {
+        if (strcmp(archive_member_name(archive, i), name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* archive_member_name(const Archive* archive, uint32_t member) {
+    return archive->strings + archive->members[member].name;
+}
+
+Object* load_archive_member(const Archive* archive, uint32_t member) {
+    const ArchiveMember* m = &archive->members[member];
+    FILE* input = fmemopen((void*) (archive->base + m->offset), m->size, "r");
+    if (!input) {
+        return NULL;
+    }
+    Object* object = read_object(input);
+    fclose(input);
+    return object;
+}
@@ -0,0 +1,88 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARCHIVE_MAGIC "MIPSAR1"
+
+/* An archive file is laid out as follows, with every integer a uint32_t in
+   the byte order of the machine that wrote it and every table 4-byte
+   aligned:
+
+     ArchiveHeader
+     ArchiveMember[num_members]
+     uint32_t buckets[num_buckets]     index into symbols, or UINT32_MAX
+     ArchiveSymbol[num_symbols]
+     char strings[strings_len]         null-terminated names
+     member contents                   each output file, byte for byte
+
+   BUCKETS is an open-addressing hash table (FNV-1a of the name, linear
+   probing, at most half full) over the symbols defined by any member, so a
+   name is found without reading the members. If several members define a
+   name, the first one given to write_archive() is indexed.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t num_members;
+    uint32_t num_buckets;
+    uint32_t num_symbols;
+    uint32_t members_off;
+    uint32_t buckets_off;
+    uint32_t symbols_off;
+    uint32_t strings_off;
+    uint32_t strings_len;
+} ArchiveHeader;
+
+typedef struct {
+    uint32_t name;      // offset in strings
+    uint32_t offset;    // offset of the contents in the file
+    uint32_t size;
+} ArchiveMember;
+
+typedef struct {
+    uint32_t name;      // offset in strings
+    uint32_t hash;
+    uint32_t member;
+    uint32_t addr;
+} ArchiveSymbol;
+
+/* An archive mapped into memory by open_archive(). */
+typedef struct {
+    const uint8_t* base;
+    size_t size;
+    const ArchiveHeader* header;
+    const ArchiveMember* members;
+    const uint32_t* buckets;
+    const ArchiveSymbol* symbols;
+    const char* strings;
+} Archive;
+
+/* Writes an archive of the NUM output files CONTENTS, of SIZES bytes, under
+   the member names NAMES. Returns 0 on success and -1 if a file is not a
+   valid output file.
+ */
+int write_archive(FILE* output, char** names, char** contents, size_t* sizes,
+    uint32_t num);
+
+/* Maps the archive PATH. Returns NULL and writes to the log if it cannot be
+   opened or is malformed.
+ */
+Archive* open_archive(const char* path);
+
+void close_archive(Archive* archive);
+
+/* Returns the index of the member that defines NAME and sets *ADDR to its
+   address in that member, or returns -1 if no member defines it.
+ */
+int64_t find_archive_symbol(const Archive* archive, const char* name, uint32_t* addr);
+
+/* Returns the index of the member called NAME, or -1 if there is none. */
+int64_t find_archive_member(const Archive* archive, const char* name);
+
+const char* archive_member_name(const Archive* archive, uint32_t member);
+
+/* Reads member MEMBER of ARCHIVE. Only that member is touched. */
+Object* load_archive_member(const Archive* archive, uint32_t member);
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "arena.h"
+
+/* Every allocation is rounded up to this, which suits any type we store. */
+#define ARENA_ALIGN 16
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t size;
+    char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+static ArenaChunk* create_chunk(Arena* arena, size_t size) {
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL) {
+        allocation_failed();
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    arena->reserved += size;
+    arena->num_chunks++;
+    return chunk;
+}
+
+Arena* create_arena(size_t chunk_size) {
+    Arena* arena = malloc(sizeof(Arena));
+    if (arena == NULL) {
+        allocation_failed();
+    }
+    memset(arena, 0, sizeof(Arena));
+    arena->chunk_size = align_size(chunk_size ? chunk_size : ARENA_ALIGN);
+    arena->head = create_chunk(arena, arena->chunk_size);
+    arena->current = arena->head;
+    return arena;
+}
+
+void free_arena(Arena* arena) {
+    ArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+/* Makes CURRENT a chunk after it with room for SIZE bytes, reusing the next
+   chunk if it is large enough and inserting a new one otherwise.
+ */
+static void next_chunk(Arena* arena, size_t size) {
+    ArenaChunk* next = arena->current->next;
+    if (!next || next->size < size) {
+        ArenaChunk* chunk = create_chunk(arena,
+            size > arena->chunk_size ? size : arena->chunk_size);
+        chunk->next = next;
+        arena->current->next = chunk;
+        next = chunk;
+    }
+    arena->current = next;
+    arena->used = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    if (arena == NULL) {
+        void* ptr = malloc(size);
+        if (ptr == NULL) {
+            allocation_failed();
+        }
+        return ptr;
+    }
+    size = align_size(size);
+    if (arena->current->size - arena->used < size) {
+        next_chunk(arena, size);
+    }
+    void* ptr = arena->current->data + arena->used;
+    arena->used += size;
+    arena->in_use += size;
+    if (arena->in_use > arena->high_water) {
+        arena->high_water = arena->in_use;
+    }
+    return ptr;
+}
+
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t size) {
+    if (arena == NULL) {
+        ptr = realloc(ptr, size);
+        if (ptr == NULL) {
+            allocation_failed();
+        }
+        return ptr;
+    }
+    char* data = arena->current->data;
+    old_size = align_size(old_size);
+    size_t new_size = align_size(size);
+    if (ptr && (char*) ptr + old_size == data + arena->used
+        && new_size >= old_size
+        && arena->current->size - arena->used >= new_size - old_size) {
+        arena->used += new_size - old_size;
+        arena->in_use += new_size - old_size;
+        if (arena->in_use > arena->high_water) {
+            arena->high_water = arena->in_use;
+        }
+        return ptr;
+    }
+    void* copy = arena_alloc(arena, size);
+    if (ptr) {
+        memcpy(copy, ptr, old_size < size ? old_size : size);
+    }
+    return copy;
+}
+
+char* arena_strdup(Arena* arena, const char* str) {
+    size_t len = strlen(str) + 1;
+    char* copy = arena_alloc(arena, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+void arena_free(Arena* arena, void* ptr) {
+    if (arena == NULL) {
+        free(ptr);
+    }
+}
+
+ArenaMark arena_mark(Arena* arena) {
+    ArenaMark mark = {arena->current, arena->used, arena->in_use};
+    return mark;
+}
+
+void arena_reset(Arena* arena, ArenaMark mark) {
+    arena->current = mark.chunk;
+    arena->used = mark.used;
+    arena->in_use = mark.in_use;
+    arena->resets++;
+}
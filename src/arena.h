@@ -0,0 +1,64 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct ArenaChunk ArenaChunk;
+
+/* A bump-pointer allocator. Memory is carved out of CURRENT in order and
+   only released all at once, by arena_reset() back to a mark or by
+   free_arena(). Chunks after a reset point are kept and reused, so a job
+   that fits in the memory of the previous one does not call malloc().
+   IN_USE counts the bytes handed out, HIGH_WATER its largest value and
+   RESERVED the bytes held in chunks.
+ */
+typedef struct {
+    ArenaChunk* head;
+    ArenaChunk* current;
+    size_t used;
+    size_t chunk_size;
+    size_t in_use;
+    size_t high_water;
+    size_t reserved;
+    uint32_t num_chunks;
+    uint32_t resets;
+} Arena;
+
+/* A position in an arena, as returned by arena_mark(). */
+typedef struct {
+    ArenaChunk* chunk;
+    size_t used;
+    size_t in_use;
+} ArenaMark;
+
+/* Creates an arena that reserves memory CHUNK_SIZE bytes at a time. */
+Arena* create_arena(size_t chunk_size);
+
+/* Frees ARENA and everything allocated from it. */
+void free_arena(Arena* arena);
+
+/* Returns SIZE bytes aligned for any type. If ARENA is NULL, the memory
+   comes from malloc() and must be passed to arena_free().
+ */
+void* arena_alloc(Arena* arena, size_t size);
+
+/* Resizes PTR, which holds OLD_SIZE bytes, to SIZE bytes. The last
+   allocation in an arena grows in place when there is room; otherwise the
+   contents are copied and the old block is left until the next reset.
+ */
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t size);
+
+/* Returns a copy of STR allocated as by arena_alloc(). */
+char* arena_strdup(Arena* arena, const char* str);
+
+/* Frees PTR if ARENA is NULL and does nothing otherwise. */
+void arena_free(Arena* arena, void* ptr);
+
+/* Returns the current position of ARENA. */
+ArenaMark arena_mark(Arena* arena);
+
+/* Releases everything allocated since MARK in constant time. */
+void arena_reset(Arena* arena, ArenaMark mark);
+
+#endif
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "cache.h"
+
+const int CACHE_LRU = 0;
+const int CACHE_RANDOM = 1;
+
+/* All LRU. */
+const CacheConfig DEFAULT_L1I = { 32 * 1024, 64, 8, 0 };
+const CacheConfig DEFAULT_L1D = { 32 * 1024, 64, 8, 0 };
+const CacheConfig DEFAULT_L2 = { 256 * 1024, 64, 8, 0 };
+
+#define INVALID_LINE UINT32_MAX
+
+static int is_power_of_two(uint32_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+int parse_cache_config(CacheConfig* config, const char* str) {
+    unsigned size, line_size, ways;
+    char policy[8], extra;
+    int n = sscanf(str, "%u,%u,%u,%7[a-z]%c", &size, &line_size, &ways, policy, &extra);
+    if (n == 3) {
+        strcpy(policy, "lru");
+    } else if (n != 4) {
+        return -1;
+    }
+    if (line_size < 4 || !is_power_of_two(line_size) || ways == 0
+        || size % ((uint64_t) line_size * ways) != 0
+        || !is_power_of_two(size / (line_size * ways))) {
+        return -1;
+    }
+    if (strcmp(policy, "lru") == 0) {
+        config->policy = CACHE_LRU;
+    } else if (strcmp(policy, "random") == 0) {
+        config->policy = CACHE_RANDOM;
+    } else {
+        return -1;
+    }
+    config->size = size;
+    config->line_size = line_size;
+    config->ways = ways;
+    return 0;
+}
+
+/*******************************
+ * Caches
+ *******************************/
+
+static void init_cache(Cache* cache, const CacheConfig* config) {
+    uint32_t sets = config->size / (config->line_size * config->ways);
+    cache->config = *config;
+    cache->line_shift = __builtin_ctz(config->line_size);
+    cache->set_mask = sets - 1;
+    cache->lines = malloc(sizeof(uint32_t) * sets * config->ways);
+    if (cache->lines == NULL) {
+        allocation_failed();
+    }
+    memset(cache->lines, 0xFF, sizeof(uint32_t) * sets * config->ways);
+    cache->seed = 2463534242u;
+    cache->accesses = 0;
+    cache->misses = 0;
+}
+
+/* Looks up the line holding ADDR. With LRU replacement a hit moves it to
+   the front of its set, and a miss evicts the line at the back, where the
+   empty ways also end up. With random replacement a miss fills an empty
+   way if there is one, and otherwise evicts any way. Returns 1 on a hit
+   and 0 on a miss.
+ */
+static int access_cache(Cache* cache, uint32_t addr) {
+    uint32_t line = addr >> cache->line_shift;
+    uint32_t ways = cache->config.ways;
+    uint32_t* set = cache->lines + (line & cache->set_mask) * ways;
+    cache->accesses++;
+
+    if (cache->config.policy == CACHE_LRU) {
+        uint32_t i = 0;
+        while (i < ways - 1 && set[i] != line) {
+            i++;
+        }
+        int hit = set[i] == line;
+        memmove(set + 1, set, sizeof(uint32_t) * i);
+        set[0] = line;
+        cache->misses += !hit;
+        return hit;
+    }
+
+    uint32_t empty = ways;
+    for (uint32_t i = 0; i < ways; i++) {
+        if (set[i] == line) {
+            return 1;
+        }
+        if (set[i] == INVALID_LINE && empty == ways) {
+            empty = i;
+        }
+    }
+    if (empty == ways) {
+        /* xorshift32 */
+        cache->seed ^= cache->seed << 13;
+        cache->seed ^= cache->seed >> 17;
+        cache->seed ^= cache->seed << 5;
+        empty = cache->seed % ways;
+    }
+    set[empty] = line;
+    cache->misses++;
+    return 0;
+}
+
+CacheSim* create_cache_sim(const CacheConfig* l1i, const CacheConfig* l1d,
+    const CacheConfig* l2, uint32_t text_len) {
+    CacheSim* sim = malloc(sizeof(CacheSim));
+    if (sim == NULL) {
+        allocation_failed();
+    }
+    init_cache(&sim->l1i, l1i);
+    init_cache(&sim->l1d, l1d);
+    init_cache(&sim->l2, l2);
+    sim->text_len = text_len;
+    sim->last_fetch = INVALID_LINE;
+    sim->fetch_misses = calloc(text_len + 1, sizeof(uint64_t));
+    sim->data = calloc(text_len + 1, sizeof(uint64_t));
+    sim->data_misses = calloc(text_len + 1, sizeof(uint64_t));
+    sim->l2_misses = calloc(text_len + 1, sizeof(uint64_t));
+    if (!sim->fetch_misses || !sim->data || !sim->data_misses || !sim->l2_misses) {
+        allocation_failed();
+    }
+    return sim;
+}
+
+void free_cache_sim(CacheSim* sim) {
+    free(sim->l1i.lines);
+    free(sim->l1d.lines);
+    free(sim->l2.lines);
+    free(sim->fetch_misses);
+    free(sim->data);
+    free(sim->data_misses);
+    free(sim->l2_misses);
+    free(sim);
+}
+
+void cache_fetch(CacheSim* sim, uint32_t index) {
+    uint32_t addr = 4 * index;
+
+    /* Straight-line code fetches the same line again and again. It is
+       still the most recently used line of the L1I, which nothing else
+       touches, so the lookup can be skipped.
+     */
+    if (addr >> sim->l1i.line_shift == sim->last_fetch) {
+        sim->l1i.accesses++;
+        return;
+    }
+    sim->last_fetch = addr >> sim->l1i.line_shift;
+    if (!access_cache(&sim->l1i, addr)) {
+        sim->fetch_misses[index]++;
+        if (!access_cache(&sim->l2, addr)) {
+            sim->l2_misses[index]++;
+        }
+    }
+}
+
+void cache_data(CacheSim* sim, uint32_t index, uint32_t addr) {
+    sim->data[index]++;
+    if (!access_cache(&sim->l1d, addr)) {
+        sim->data_misses[index]++;
+        if (!access_cache(&sim->l2, addr)) {
+            sim->l2_misses[index]++;
+        }
+    }
+}
+
+/*******************************
+ * Report
+ *******************************/
+
+/* Totals for a label or an instruction. */
+typedef struct {
+    uint64_t fetches;
+    uint64_t fetch_misses;
+    uint64_t data;
+    uint64_t data_misses;
+    uint64_t l2_misses;
+} Misses;
+
+static double miss_rate(uint64_t misses, uint64_t accesses) {
+    return accesses ? (double) misses / accesses : 0.0;
+}
+
+static void add_misses(Misses* total, const CacheSim* sim, const uint64_t* counts,
+    uint32_t i) {
+    total->fetches += counts[i];
+    total->fetch_misses += sim->fetch_misses[i];
+    total->data += sim->data[i];
+    total->data_misses += sim->data_misses[i];
+    total->l2_misses += sim->l2_misses[i];
+}
+
+static void write_misses(const Misses* m, FILE* output) {
+    fprintf(output, "\t%llu\t%llu\t%.3f\t%llu\t%llu\t%.3f\t%llu\n",
+        (unsigned long long) m->fetches, (unsigned long long) m->fetch_misses,
+        miss_rate(m->fetch_misses, m->fetches), (unsigned long long) m->data,
+        (unsigned long long) m->data_misses, miss_rate(m->data_misses, m->data),
+        (unsigned long long) m->l2_misses);
+}
+
+static void write_cache(const char* name, const Cache* cache, FILE* output) {
+    const CacheConfig* config = &cache->config;
+    fprintf(output, "# %s: %u bytes, %u-byte lines, %u-way, %s: %llu accesses, "
+        "%llu misses (%.3f)\n", name, config->size, config->line_size, config->ways,
+        config->policy == CACHE_LRU ? "lru" : "random",
+        (unsigned long long) cache->accesses, (unsigned long long) cache->misses,
+        miss_rate(cache->misses, cache->accesses));
+}
+
+static int compare_symbol_addrs(const void* a, const void* b) {
+    uint32_t x = (*(Symbol**) a)->addr, y = (*(Symbol**) b)->addr;
+    return (x > y) - (x < y);
+}
+
+/* Report format:
+
+       # <cache>: <geometry>: <accesses> accesses, <misses> misses (<rate>)
+       <label> <fetches> <L1I misses> <rate> <data> <L1D misses> <rate> <L2 misses>
+       ...
+       <address> <line> <fetches> <L1I misses> <rate> <data> <L1D misses> <rate> <L2 misses>
+       ...
+
+   The label lines total the instructions from each label in the text up
+   to the next one ("-" for those before the first label). The address
+   lines are for each executed instruction, where LINE is its line in the
+   intermediate file; each label is written as a comment before the first
+   instruction it points to, as in the execution profile.
+ */
+void write_cache_report(const CacheSim* sim, const uint64_t* counts,
+    SymbolTable* symbols, FILE* output) {
+    uint32_t num_symbols = 0, len = sim->text_len;
+    Symbol** sorted = malloc(sizeof(Symbol*) * ((symbols ? symbols->len : 0) + 1));
+    if (sorted == NULL) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; symbols && i < symbols->len; i++) {
+        if (symbols->tbl[i].addr < 4 * len) {
+            sorted[num_symbols++] = &symbols->tbl[i];
+        }
+    }
+    qsort(sorted, num_symbols, sizeof(Symbol*), compare_symbol_addrs);
+
+    write_cache("L1I", &sim->l1i, output);
+    write_cache("L1D", &sim->l1d, output);
+    write_cache("L2", &sim->l2, output);
+
+    fprintf(output, "# label\tfetches\tL1I misses\trate\tdata\tL1D misses\trate\t"
+        "L2 misses\n");
+    for (uint32_t k = 0; k <= num_symbols; k++) {
+        uint32_t start = k ? sorted[k - 1]->addr / 4 : 0;
+        uint32_t end = k < num_symbols ? sorted[k]->addr / 4 : len;
+        Misses total = { 0 };
+        for (uint32_t i = start; i < end; i++) {
+            add_misses(&total, sim, counts, i);
+        }
+        /* Of several labels at one address, only the last gets a line. */
+        if (k ? end > start : total.fetches > 0) {
+            fprintf(output, "%s", k ? sorted[k - 1]->name : "-");
+            write_misses(&total, output);
+        }
+    }
+
+    fprintf(output, "# address\tline\tfetches\tL1I misses\trate\tdata\tL1D misses\t"
+        "rate\tL2 misses\n");
+    for (uint32_t i = 0, next = 0; i < len; i++) {
+        while (next < num_symbols && sorted[next]->addr <= 4 * i) {
+            fprintf(output, "# %s:\n", sorted[next++]->name);
+        }
+        if (counts[i] == 0) {
+            continue;
+        }
+        Misses m = { 0 };
+        add_misses(&m, sim, counts, i);
+        fprintf(output, "%u\t%u", 4 * i, i + 1);
+        write_misses(&m, output);
+    }
+    free(sorted);
+}
@@ -0,0 +1,84 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern const int CACHE_LRU;      // evict the least recently used line
+extern const int CACHE_RANDOM;   // evict a pseudo-random line
+
+/* The geometry of one cache. SIZE and LINE_SIZE are in bytes, and SIZE /
+   (LINE_SIZE * WAYS), the number of sets, must be a power of two.
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t line_size;
+    uint32_t ways;
+    int policy;
+} CacheConfig;
+
+extern const CacheConfig DEFAULT_L1I;
+extern const CacheConfig DEFAULT_L1D;
+extern const CacheConfig DEFAULT_L2;
+
+/* A set-associative cache. Set S holds the line numbers (address /
+   LINE_SIZE) of its lines in LINES[S * WAYS ...], most recently used first
+   for LRU, and INVALID_LINE for an empty way.
+ */
+typedef struct {
+    CacheConfig config;
+    uint32_t line_shift;
+    uint32_t set_mask;
+    uint32_t* lines;
+    uint32_t seed;
+    uint64_t accesses;
+    uint64_t misses;
+} Cache;
+
+/* The caches of a machine: separate L1 instruction and data caches backed
+   by a unified L2. Every miss in an L1 is an access to the L2. Stores are
+   write-allocate and treated like loads; writing back dirty lines is not
+   modelled.
+
+   The counts are also kept per instruction of the TEXT_LEN words of text:
+   FETCH_MISSES[i] is how often fetching instruction i missed in the L1I,
+   DATA[i] and DATA_MISSES[i] how often it accessed data and missed in the
+   L1D, and L2_MISSES[i] how often either went on to miss in the L2.
+ */
+typedef struct {
+    Cache l1i;
+    Cache l1d;
+    Cache l2;
+    uint32_t text_len;
+    uint32_t last_fetch;
+    uint64_t* fetch_misses;
+    uint64_t* data;
+    uint64_t* data_misses;
+    uint64_t* l2_misses;
+} CacheSim;
+
+/* Parses a cache written as <size>,<line size>,<ways>[,lru|random] into
+   CONFIG, with LRU replacement by default. Returns 0 on success and -1 if
+   it is malformed or its number of sets is not a power of two.
+ */
+int parse_cache_config(CacheConfig* config, const char* str);
+
+CacheSim* create_cache_sim(const CacheConfig* l1i, const CacheConfig* l1d,
+    const CacheConfig* l2, uint32_t text_len);
+
+void free_cache_sim(CacheSim* sim);
+
+/* Fetches instruction INDEX, at byte address 4 * INDEX. */
+void cache_fetch(CacheSim* sim, uint32_t index);
+
+/* Reads or writes the data at ADDR for instruction INDEX. */
+void cache_data(CacheSim* sim, uint32_t index, uint32_t addr);
+
+/* Writes the hit rates of every cache, then the misses of each label in
+   SYMBOLS and of each executed instruction, to OUTPUT. COUNTS are the
+   execution counts of the instructions. See cache.c for the format.
+ */
+void write_cache_report(const CacheSim* sim, const uint64_t* counts,
+    SymbolTable* symbols, FILE* output);
+
+#endif
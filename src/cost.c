@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "words.h"
+#include "decode.h"
+#include "data.h"
+#include "cost.h"
+
+const CostModel DEFAULT_COST_MODEL = { 1, 1, 5 };
+
+int parse_cost_model(CostModel* model, const char* str) {
+    unsigned stall, penalty, depth = DEFAULT_COST_MODEL.pipeline_depth;
+    char extra;
+    int n = sscanf(str, "%u,%u,%u%c", &stall, &penalty, &depth, &extra);
+    if (n != 2 && n != 3) {
+        return -1;
+    }
+    if (depth == 0) {
+        return -1;
+    }
+    model->load_use_stall = stall;
+    model->branch_penalty = penalty;
+    model->pipeline_depth = depth;
+    return 0;
+}
+
+/* Totals for the instructions between a label and the next label. */
+typedef struct {
+    uint32_t insts;
+    uint32_t blocks;
+    uint64_t cycles;
+    uint32_t stalls;
+    uint32_t branches;
+    uint32_t critical;
+} Cost;
+
+static int is_transfer(const DecodedInst* inst) {
+    return is_branch_op(inst) || inst->op == OP_J || inst->op == OP_JAL
+        || inst->op == OP_JR;
+}
+
+/* Marks the first instruction of every basic block in LEADERS. With
+   DELAY_SLOTS, the slot after a branch or jump ends its block.
+ */
+static void find_leaders(uint8_t* leaders, const DecodedInst* insts, uint32_t len,
+    SymbolTable* symtbl, RelocTable* reltbl, int delay_slots) {
+    leaders[0] = 1;
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        uint32_t index = symtbl->tbl[i].addr / 4;
+        if (index < len) {
+            leaders[index] = 1;
+        }
+    }
+    for (uint32_t i = 0; i < reltbl->len; i++) {
+        if (reltbl->entries[i].type != RELOC_JUMP26) {
+            continue;
+        }
+        int64_t target = get_addr_for_symbol(symtbl,
+            reloc_symbol(reltbl, &reltbl->entries[i]));
+        if (target >= 0 && target / 4 < len) {
+            leaders[target / 4] = 1;
+        }
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (!is_transfer(&insts[i])) {
+            continue;
+        }
+        if (i + 1 + delay_slots < len) {
+            leaders[i + 1 + delay_slots] = 1;
+        }
+        if (is_branch_op(&insts[i])) {
+            int64_t target = (int64_t) i + 1 + insts[i].imm;
+            if (target >= 0 && target < len) {
+                leaders[target] = 1;
+            }
+        }
+    }
+}
+
+/* Adds the cost of the block of LEN instructions at INSTS to COST. The
+   critical path is the longest chain of instructions that each read a
+   register written earlier in the block, with a load counting for
+   1 + load_use_stall cycles.
+ */
+static void add_block_cost(Cost* cost, const DecodedInst* insts, uint32_t len,
+    const CostModel* model) {
+    uint32_t ready[32] = { 0 }, path = 0;
+    uint32_t prev_def = 0;
+    int prev_load = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t def, use, start = 0;
+        decoded_regs(&insts[i], &def, &use);
+        for (int r = 1; r < 32; r++) {
+            if ((use & (1u << r)) && ready[r] > start) {
+                start = ready[r];
+            }
+        }
+        uint32_t finish = start + 1
+            + (is_load_op(&insts[i]) ? model->load_use_stall : 0);
+        for (int r = 1; r < 32; r++) {
+            if (def & (1u << r)) {
+                ready[r] = finish;
+            }
+        }
+        if (finish > path) {
+            path = finish;
+        }
+
+        if (prev_load && (use & prev_def)) {
+            cost->stalls += model->load_use_stall;
+        }
+        if (is_transfer(&insts[i])) {
+            cost->branches++;
+        }
+        prev_def = def;
+        prev_load = is_load_op(&insts[i]);
+    }
+    cost->insts += len;
+    cost->blocks++;
+    if (path > cost->critical) {
+        cost->critical = path;
+    }
+}
+
+static int compare_symbol_addrs(const void* a, const void* b) {
+    uint32_t x = (*(Symbol**) a)->addr, y = (*(Symbol**) b)->addr;
+    return (x > y) - (x < y);
+}
+
+/* Report format, one tab-separated line per label, other than the local
+   labels, in address order:
+
+       <label> <address> <instructions> <blocks> <cycles> <stalls> <branches> <critical path>
+
+   A label covers the instructions up to the next label at a higher address.
+   CYCLES is instructions + stalls + branches * branch_penalty plus
+   pipeline_depth - 1 to fill the pipeline. With delay slots, the slot
+   instruction fills one of the cycles a branch would lose, so a branch
+   costs branch_penalty - 1 on top of its slot. Lines starting with '#' are
+   comments.
+ */
+int write_cost_report(WordBuffer* text, SymbolTable* symtbl, RelocTable* reltbl,
+    const CostModel* model, int delay_slots, FILE* output) {
+    uint32_t len = text->len;
+    DecodedInst* insts = malloc(sizeof(DecodedInst) * (len + 1));
+    uint8_t* leaders = calloc(len + 1, 1);
+    Symbol** sorted = malloc(sizeof(Symbol*) * (symtbl->len + 1));
+    if (!insts || !leaders || !sorted) {
+        allocation_failed();
+    }
+    int err = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (decode_inst(text->words[i], &insts[i]) == -1) {
+            write_to_log("Error: cannot decode instruction at address %u\n", 4 * i);
+            err = -1;
+        }
+    }
+    if (err) {
+        free(insts);
+        free(leaders);
+        free(sorted);
+        return -1;
+    }
+    if (len > 0) {
+        find_leaders(leaders, insts, len, symtbl, reltbl, delay_slots);
+    }
+
+    uint32_t num_sorted = 0;
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        if (!is_local_label(symtbl->tbl[i].name)) {
+            sorted[num_sorted++] = &symtbl->tbl[i];
+        }
+    }
+    qsort(sorted, num_sorted, sizeof(Symbol*), compare_symbol_addrs);
+
+    fprintf(output, "# model: load-use stall %u, branch penalty %u, depth %u%s\n",
+        model->load_use_stall, model->branch_penalty, model->pipeline_depth,
+        delay_slots ? ", delay slots" : "");
+    uint32_t penalty = model->branch_penalty;
+    if (delay_slots && penalty > 0) {
+        penalty--;
+    }
+    fprintf(output, "# label\taddress\tinstructions\tblocks\tcycles\tstalls\tbranches\tcritical\n");
+    for (uint32_t i = 0; i < num_sorted; i++) {
+        /* Labels of the data segment come last and cover no code. */
+        if (sorted[i]->addr >= DATA_BASE) {
+            break;
+        }
+        uint32_t start = sorted[i]->addr / 4, end = len;
+        for (uint32_t j = i + 1; j < num_sorted; j++) {
+            if (sorted[j]->addr / 4 > start) {
+                end = sorted[j]->addr / 4;
+                break;
+            }
+        }
+        if (start > len) {
+            start = len;
+        }
+        if (end > len) {
+            end = len;
+        }
+
+        Cost cost = { 0 };
+        for (uint32_t b = start; b < end; ) {
+            uint32_t e = b + 1;
+            while (e < end && !leaders[e]) {
+                e++;
+            }
+            add_block_cost(&cost, insts + b, e - b, model);
+            b = e;
+        }
+        if (cost.insts > 0) {
+            cost.cycles = (uint64_t) cost.insts + cost.stalls
+                + (uint64_t) cost.branches * penalty
+                + model->pipeline_depth - 1;
+        }
+        fprintf(output, "%s\t%u\t%u\t%u\t%llu\t%u\t%u\t%u\n", sorted[i]->name,
+            sorted[i]->addr, cost.insts, cost.blocks, (unsigned long long) cost.cycles,
+            cost.stalls, cost.branches, cost.critical);
+    }
+
+    free(insts);
+    free(leaders);
+    free(sorted);
+    return 0;
+}
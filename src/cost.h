@@ -0,0 +1,36 @@
+#ifndef COST_H
+#define COST_H
+
+#include <stdint.h>
+
+/* Parameters of the in-order 5-stage pipeline used to estimate cycles.
+   LOAD_USE_STALL is the number of bubbles when an instruction reads the
+   register written by the load just before it, BRANCH_PENALTY the number of
+   cycles lost on every beq, bne, j, jal and jr, and PIPELINE_DEPTH the
+   number of stages, so that a routine costs PIPELINE_DEPTH - 1 cycles to
+   fill the pipeline.
+ */
+typedef struct {
+    uint32_t load_use_stall;
+    uint32_t branch_penalty;
+    uint32_t pipeline_depth;
+} CostModel;
+
+extern const CostModel DEFAULT_COST_MODEL;
+
+/* Parses a model written as <load-use stall>,<branch penalty>[,<depth>]
+   into MODEL. Returns 0 on success and -1 on error.
+ */
+int parse_cost_model(CostModel* model, const char* str);
+
+/* Splits the encoded program TEXT into basic blocks and writes one line per
+   label in SYMTBL to OUTPUT. Block leaders are labels, beq/bne targets,
+   the targets of the j and jal entries in RELTBL (resolved through SYMTBL)
+   and every instruction after a branch or jump, or after its delay slot if
+   DELAY_SLOTS is set. See cost.c for the format. Returns 0 on success and
+   -1 if TEXT has an instruction it cannot decode.
+ */
+int write_cost_report(WordBuffer* text, SymbolTable* symtbl, RelocTable* reltbl,
+    const CostModel* model, int delay_slots, FILE* output);
+
+#endif
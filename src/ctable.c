@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "ctable.h"
+
+struct ConcurrentEntry {
+    char* name;
+    uint32_t hash;
+    uint32_t addr;
+    uint64_t line;
+    ConcurrentEntry* next;
+};
+
+ConcurrentTable* create_concurrent_table(int mode, uint32_t max_symbols) {
+    ConcurrentTable* table = malloc(sizeof(ConcurrentTable));
+    if (table == NULL) {
+        allocation_failed();
+    }
+    /* Keep the load factor at or below one half. */
+    table->cap = 16;
+    while (table->cap < 2 * (uint64_t) max_symbols) {
+        if (table->cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        table->cap *= 2;
+    }
+    table->slots = calloc(table->cap, sizeof(ConcurrentEntry*));
+    if (table->slots == NULL) {
+        allocation_failed();
+    }
+    table->len = 0;
+    table->mode = mode;
+    table->all = NULL;
+    return table;
+}
+
+void free_concurrent_table(ConcurrentTable* table) {
+    ConcurrentEntry* entry = table->all;
+    while (entry) {
+        ConcurrentEntry* next = entry->next;
+        free(entry->name);
+        free(entry);
+        entry = next;
+    }
+    free(table->slots);
+    free(table);
+}
+
+/* Puts ENTRY in TABLE->SLOTS. Returns 0, or -1 if there is no free slot. */
+static int claim_slot(ConcurrentTable* table, ConcurrentEntry* entry) {
+    uint32_t mask = table->cap - 1;
+    uint32_t b = entry->hash & mask;
+    for (uint32_t probes = 0; probes < table->cap; probes++, b = (b + 1) & mask) {
+        ConcurrentEntry* cur = __atomic_load_n(&table->slots[b], __ATOMIC_ACQUIRE);
+        while (1) {
+            if (cur == NULL) {
+                if (__atomic_compare_exchange_n(&table->slots[b], &cur, entry, 0,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                    __atomic_fetch_add(&table->len, 1, __ATOMIC_RELAXED);
+                    return 0;
+                }
+                /* Another thread claimed the slot; CUR is now its entry. */
+                continue;
+            }
+            if (table->mode != SYMTBL_UNIQUE_NAME || cur->hash != entry->hash
+                || strcmp(cur->name, entry->name) != 0) {
+                break;
+            }
+            /* Same name: the lower line wins the slot. */
+            if (cur->line <= entry->line) {
+                return 0;
+            }
+            if (__atomic_compare_exchange_n(&table->slots[b], &cur, entry, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+int add_to_concurrent_table(ConcurrentTable* table, const char* name, uint32_t addr,
+    uint64_t line) {
+    if (addr % 4 != 0) {
+        addr_alignment_incorrect();
+        return -1;
+    }
+    ConcurrentEntry* entry = malloc(sizeof(ConcurrentEntry));
+    if (entry == NULL) {
+        allocation_failed();
+    }
+    entry->name = malloc(strlen(name) + 1);
+    if (entry->name == NULL) {
+        allocation_failed();
+    }
+    strcpy(entry->name, name);
+    entry->hash = hash_name(name);
+    entry->addr = addr;
+    entry->line = line;
+
+    if (claim_slot(table, entry) != 0) {
+        write_to_log("Error: concurrent symbol table is full (%u slots).\n", table->cap);
+        free(entry->name);
+        free(entry);
+        return -1;
+    }
+
+    /* Entries that lose their slot stay on ALL, so a reader that loaded one
+       can still compare its name.
+     */
+    entry->next = __atomic_load_n(&table->all, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&table->all, &entry->next, entry, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return 0;
+}
+
+int64_t get_addr_for_concurrent_symbol(ConcurrentTable* table, const char* name) {
+    uint32_t hash = hash_name(name);
+    uint32_t mask = table->cap - 1;
+    uint32_t b = hash & mask;
+    ConcurrentEntry* found = NULL;
+    for (uint32_t probes = 0; probes < table->cap; probes++, b = (b + 1) & mask) {
+        ConcurrentEntry* cur = __atomic_load_n(&table->slots[b], __ATOMIC_ACQUIRE);
+        if (cur == NULL) {
+            break;
+        }
+        if (cur->hash == hash && strcmp(cur->name, name) == 0) {
+            if (table->mode == SYMTBL_UNIQUE_NAME) {
+                return cur->addr;
+            }
+            if (!found || cur->line < found->line) {
+                found = cur;
+            }
+        }
+    }
+    return found ? (int64_t) found->addr : -1;
+}
+
+static int compare_lines(const void* a, const void* b) {
+    const ConcurrentEntry* x = *(ConcurrentEntry* const*) a;
+    const ConcurrentEntry* y = *(ConcurrentEntry* const*) b;
+    if (x->line != y->line) {
+        return x->line < y->line ? -1 : 1;
+    }
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+int export_concurrent_table(ConcurrentTable* table, SymbolTable* out) {
+    uint32_t num = 0;
+    for (ConcurrentEntry* entry = table->all; entry; entry = entry->next) {
+        num++;
+    }
+    ConcurrentEntry** sorted = malloc(sizeof(ConcurrentEntry*) * (num ? num : 1));
+    if (sorted == NULL) {
+        allocation_failed();
+    }
+    num = 0;
+    for (ConcurrentEntry* entry = table->all; entry; entry = entry->next) {
+        sorted[num++] = entry;
+    }
+    qsort(sorted, num, sizeof(ConcurrentEntry*), compare_lines);
+
+    int err = 0;
+    for (uint32_t i = 0; i < num; i++) {
+        if (add_to_table(out, sorted[i]->name, sorted[i]->addr) != 0) {
+            err = -1;
+        }
+    }
+    free(sorted);
+    return err;
+}
@@ -0,0 +1,56 @@
+#ifndef CTABLE_H
+#define CTABLE_H
+
+#include <stdint.h>
+
+#include "tables.h"
+
+typedef struct ConcurrentEntry ConcurrentEntry;
+
+/* A symbol table that any number of threads may add to and search at the
+   same time. SLOTS is an open-addressing hash table of entry pointers that
+   are claimed with compare-and-swap; it never moves, so readers need no
+   lock. In SYMTBL_UNIQUE_NAME mode a slot holds the entry for its name with
+   the lowest LINE, and an entry from a lower line replaces one from a
+   higher line. Every entry is also pushed onto ALL so that the table can be
+   replayed in source order by export_concurrent_table(). CAP is a power of
+   two and fixed at creation.
+ */
+typedef struct {
+    ConcurrentEntry** slots;
+    uint32_t cap;
+    uint32_t len;
+    int mode;
+    ConcurrentEntry* all;
+} ConcurrentTable;
+
+/* Creates a table with room for at least MAX_SYMBOLS symbols. Calls
+   allocation_failed() if that needs more than 2^32 slots.
+ */
+ConcurrentTable* create_concurrent_table(int mode, uint32_t max_symbols);
+
+/* Frees TABLE. No other thread may be using it. */
+void free_concurrent_table(ConcurrentTable* table);
+
+/* Adds NAME at ADDR, defined on source line LINE. Safe to call from several
+   threads at once. Returns -1 after calling addr_alignment_incorrect() if
+   ADDR is not word-aligned, and -1 if the table is full. Otherwise returns
+   0; duplicate names are not reported until export_concurrent_table(),
+   because which thread gets there first is not deterministic.
+ */
+int add_to_concurrent_table(ConcurrentTable* table, const char* name, uint32_t addr,
+    uint64_t line);
+
+/* Returns the address of NAME from its lowest line, or -1 if it is not in
+   TABLE. Wait-free, and safe to call while other threads are adding.
+ */
+int64_t get_addr_for_concurrent_symbol(ConcurrentTable* table, const char* name);
+
+/* Adds every entry of TABLE to OUT with add_to_table() in order of source
+   line, so OUT and any duplicate name errors are exactly what adding them
+   one at a time would give. Call it after all adds have finished. Returns 0
+   on success and -1 if any add failed.
+ */
+int export_concurrent_table(ConcurrentTable* table, SymbolTable* out);
+
+#endif
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "translate_utils.h"
+#include "data.h"
+
+/* Largest .data section, so that it ends below the stack. */
+#define MAX_DATA_SIZE 0x40000000u
+
+DataSection* create_data_section(int big_endian) {
+    DataSection* data = malloc(sizeof(DataSection));
+    if (data == NULL) {
+        allocation_failed();
+    }
+    data->bytes = NULL;
+    data->len = 0;
+    data->cap = 0;
+    data->big_endian = big_endian;
+    return data;
+}
+
+void free_data_section(DataSection* data) {
+    free(data->bytes);
+    free(data);
+}
+
+int is_data_directive(const char* name) {
+    return strcmp(name, ".word") == 0 || strcmp(name, ".half") == 0
+        || strcmp(name, ".byte") == 0 || strcmp(name, ".space") == 0
+        || strcmp(name, ".ascii") == 0 || strcmp(name, ".asciiz") == 0
+        || strcmp(name, ".align") == 0;
+}
+
+/* Makes room for N more bytes. */
+static void reserve(DataSection* data, uint32_t n) {
+    if (data->len + n <= data->cap) {
+        return;
+    }
+    uint32_t cap = data->cap ? data->cap : 256;
+    while (cap < data->len + n) {
+        if (cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        cap *= 2;
+    }
+    data->bytes = realloc(data->bytes, cap);
+    if (data->bytes == NULL) {
+        allocation_failed();
+    }
+    data->cap = cap;
+}
+
+/* Appends zeros up to a multiple of ALIGN, a power of two. */
+static void pad_to(DataSection* data, uint32_t align) {
+    uint32_t pad = -data->len & (align - 1);
+    reserve(data, pad);
+    memset(data->bytes + data->len, 0, pad);
+    data->len += pad;
+}
+
+void add_data_bytes(DataSection* data, const void* bytes, uint32_t len) {
+    reserve(data, len);
+    memcpy(data->bytes + data->len, bytes, len);
+    data->len += len;
+}
+
+static int is_separator(char c) {
+    return c == ' ' || c == ',' || c == '\t' || c == '\n' || c == '\r' || c == '\f'
+        || c == '\v';
+}
+
+static const char* skip_separators(const char* p) {
+    while (is_separator(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/* Parses the decimal or 0x-prefixed hexadecimal integer at *P, which may
+   have a sign, and advances *P past it. A magnitude above 2^32 is clamped
+   to it, which no directive accepts. Returns 0 on success and -1 if *P
+   does not start with an integer followed by a separator or the end.
+ */
+static int parse_int(const char** p, int64_t* value) {
+    const char* s = *p;
+    int negative = *s == '-';
+    if (*s == '-' || *s == '+') {
+        s++;
+    }
+    uint64_t v = 0;
+    const char* digits;
+    if (s[0] == '0' && (s[1] | 0x20) == 'x') {
+        s += 2;
+        digits = s;
+        for (;; s++) {
+            char c = *s | 0x20;
+            if (*s >= '0' && *s <= '9') {
+                v = 16 * v + (*s - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                v = 16 * v + (c - 'a' + 10);
+            } else {
+                break;
+            }
+            if (v > 0x100000000ull) {
+                v = 0x100000000ull;
+            }
+        }
+    } else {
+        digits = s;
+        for (; *s >= '0' && *s <= '9'; s++) {
+            v = 10 * v + (*s - '0');
+            if (v > 0x100000000ull) {
+                v = 0x100000000ull;
+            }
+        }
+    }
+    if (s == digits || (*s != '\0' && !is_separator(*s))) {
+        return -1;
+    }
+    *value = negative ? -(int64_t) v : (int64_t) v;
+    *p = s;
+    return 0;
+}
+
+/* Appends the integers of OPERANDS as SIZE-byte values. */
+static const char* add_values(DataSection* data, const char* p, uint32_t size) {
+    int64_t min = -((int64_t) 1 << (8 * size - 1));
+    int64_t max = ((int64_t) 1 << (8 * size)) - 1;
+    p = skip_separators(p);
+    if (*p == '\0') {
+        return p;
+    }
+    while (*p != '\0') {
+        int64_t value;
+        const char* start = p;
+        if (parse_int(&p, &value) == -1 || value < min || value > max) {
+            return start;
+        }
+        reserve(data, size);
+        uint8_t* out = data->bytes + data->len;
+        for (uint32_t i = 0; i < size; i++) {
+            out[data->big_endian ? size - 1 - i : i] = (uint64_t) value >> (8 * i);
+        }
+        data->len += size;
+        p = skip_separators(p);
+    }
+    return NULL;
+}
+
+/* Appends the quoted strings of OPERANDS, each followed by a 0 if
+   TERMINATE is set.
+ */
+static const char* add_strings(DataSection* data, const char* p, int terminate) {
+    p = skip_separators(p);
+    if (*p == '\0') {
+        return p;
+    }
+    while (*p != '\0') {
+        const char* start = p;
+        if (*p++ != '"') {
+            return start;
+        }
+        for (; *p != '"'; p++) {
+            char c = *p;
+            if (c == '\0' || c == '\n') {
+                return start;
+            }
+            if (c == '\\') {
+                switch (*++p) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case '0': c = '\0'; break;
+                    case '\\': c = '\\'; break;
+                    case '"': c = '"'; break;
+                    default: return start;
+                }
+            }
+            reserve(data, 1);
+            data->bytes[data->len++] = c;
+        }
+        p++;
+        if (*p != '\0' && !is_separator(*p)) {
+            return start;
+        }
+        if (terminate) {
+            reserve(data, 1);
+            data->bytes[data->len++] = '\0';
+        }
+        p = skip_separators(p);
+    }
+    return NULL;
+}
+
+/* Parses the single integer operand of OPERANDS into *VALUE, which must be
+   between 0 and MAX.
+ */
+static const char* parse_count(const char* p, int64_t* value, int64_t max) {
+    p = skip_separators(p);
+    const char* start = p;
+    if (parse_int(&p, value) == -1 || *value < 0 || *value > max) {
+        return start;
+    }
+    p = skip_separators(p);
+    return *p == '\0' ? NULL : p;
+}
+
+int add_data(DataSection* data, const char* name, const char* operands,
+    uint32_t* start, const char** bad) {
+    uint32_t len = data->len;
+    const char* error;
+    int64_t count;
+    if (strcmp(name, ".word") == 0) {
+        pad_to(data, 4);
+        *start = data->len;
+        error = add_values(data, operands, 4);
+    } else if (strcmp(name, ".half") == 0) {
+        pad_to(data, 2);
+        *start = data->len;
+        error = add_values(data, operands, 2);
+    } else if (strcmp(name, ".byte") == 0) {
+        *start = data->len;
+        error = add_values(data, operands, 1);
+    } else if (strcmp(name, ".ascii") == 0 || strcmp(name, ".asciiz") == 0) {
+        *start = data->len;
+        error = add_strings(data, operands, name[6] == 'z');
+    } else if (strcmp(name, ".space") == 0) {
+        *start = data->len;
+        error = parse_count(operands, &count, MAX_DATA_SIZE - data->len);
+        if (!error) {
+            reserve(data, count);
+            memset(data->bytes + data->len, 0, count);
+            data->len += count;
+        }
+    } else if (strcmp(name, ".align") == 0) {
+        error = parse_count(operands, &count, MAX_DATA_ALIGN);
+        if (!error) {
+            pad_to(data, 1 << count);
+        }
+        *start = data->len;
+    } else {
+        error = operands;
+    }
+
+    if (!error && data->len > MAX_DATA_SIZE) {
+        error = operands;
+    }
+    if (error) {
+        data->len = len;
+        *bad = error;
+        return -1;
+    }
+    return 0;
+}
+
+void write_data(const DataSection* data, FILE* output) {
+    for (uint32_t i = 0; i < data->len; i += 4) {
+        uint32_t word = 0;
+        for (uint32_t j = 0; j < 4; j++) {
+            uint32_t byte = i + j < data->len ? data->bytes[i + j] : 0;
+            word |= byte << 8 * (data->big_endian ? 3 - j : j);
+        }
+        write_inst_hex(output, word);
+    }
+}
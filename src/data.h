@@ -0,0 +1,59 @@
+#ifndef DATA_H
+#define DATA_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define DATA_BASE 0x10000000u   // start of the data segment
+#define MAX_DATA_ALIGN 12       // largest .align, a 4 KiB boundary
+
+/* The bytes of the .data section, which is loaded at DATA_BASE. Values
+   wider than a byte are stored big-endian if BIG_ENDIAN is set and
+   little-endian (the byte order of the simulator) otherwise.
+ */
+typedef struct {
+    uint8_t* bytes;
+    uint32_t len;
+    uint32_t cap;
+    int big_endian;
+} DataSection;
+
+DataSection* create_data_section(int big_endian);
+
+void free_data_section(DataSection* data);
+
+/* Returns 1 if NAME is one of the directives add_data() accepts. */
+int is_data_directive(const char* name);
+
+/* Appends the data of the directive NAME, whose operands are the text
+   OPERANDS, to DATA:
+
+    .word/.half/.byte VALUE ...   integers, which must fit in 32, 16 or
+                                  8 bits, signed or unsigned
+    .space COUNT                  COUNT zero bytes
+    .ascii/.asciiz "STRING" ...   the strings, with \n, \t, \0, \\ and \"
+                                  escapes; .asciiz ends each with a 0
+    .align N                      zeros up to a multiple of 2^N bytes
+
+   Operands are separated by commas or white space. A .word is aligned to
+   4 bytes and a .half to 2 first. Values are parsed straight into DATA
+   with no intermediate copy, so a table of any length costs one pass over
+   its text.
+
+   On success sets *START to the offset of the first byte of the directive
+   (after its alignment) and returns 0. On error leaves DATA unchanged,
+   points *BAD at the first invalid operand (or the end of OPERANDS if one
+   is missing) and returns -1.
+ */
+int add_data(DataSection* data, const char* name, const char* operands,
+    uint32_t* start, const char** bad);
+
+/* Appends the LEN bytes at BYTES to DATA. */
+void add_data_bytes(DataSection* data, const void* bytes, uint32_t len);
+
+/* Writes DATA to OUTPUT as the words of the .data section, one per line in
+   the same format as write_inst_hex(). The last word is padded with zeros.
+ */
+void write_data(const DataSection* data, FILE* output);
+
+#endif
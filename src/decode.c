@@ -0,0 +1,117 @@
+#include <stdio.h>
+
+#include "decode.h"
+
+static const int OPCODE_TABLE[64] = {
+    [0x02] = OP_J,     [0x03] = OP_JAL,
+    [0x04] = OP_BEQ,   [0x05] = OP_BNE,
+    [0x09] = OP_ADDIU, [0x0d] = OP_ORI,  [0x0f] = OP_LUI,
+    [0x20] = OP_LB,    [0x23] = OP_LW,   [0x24] = OP_LBU,
+    [0x28] = OP_SB,    [0x2b] = OP_SW,
+};
+
+static const int FUNCT_TABLE[64] = {
+    [0x00] = OP_SLL,   [0x08] = OP_JR,
+    [0x21] = OP_ADDU,  [0x25] = OP_OR,
+    [0x2a] = OP_SLT,   [0x2b] = OP_SLTU,
+};
+
+static const char* OP_NAMES[NUM_OPS] = {
+    "invalid",
+    "addu", "or", "slt", "sltu", "jr", "sll",
+    "addiu", "ori", "lui",
+    "lb", "lbu", "lw", "sb", "sw",
+    "beq", "bne", "j", "jal",
+};
+
+static const char* REG_NAMES[32] = {
+    "$0",  "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra",
+};
+
+int decode_inst(uint32_t word, DecodedInst* out) {
+    uint32_t opcode = word >> 26;
+    out->rs = (word >> 21) & 0x1F;
+    out->rt = (word >> 16) & 0x1F;
+    out->rd = (word >> 11) & 0x1F;
+    out->shamt = (word >> 6) & 0x1F;
+    out->target = word & 0x03FFFFFF;
+    out->imm = (int16_t) (word & 0xFFFF);
+
+    if (opcode == 0) {
+        out->op = FUNCT_TABLE[word & 0x3F];
+        if (out->op == OP_SLL) {
+            return out->rs == 0 ? 0 : -1;
+        } else if (out->op == OP_JR) {
+            return (out->rt | out->rd | out->shamt) == 0 ? 0 : -1;
+        }
+        return (out->op != OP_INVALID && out->shamt == 0) ? 0 : -1;
+    }
+
+    out->op = OPCODE_TABLE[opcode];
+    if (out->op == OP_ORI || out->op == OP_LUI) {
+        out->imm = word & 0xFFFF;
+    }
+    if (out->op == OP_LUI) {
+        return out->rs == 0 ? 0 : -1;
+    }
+    return out->op != OP_INVALID ? 0 : -1;
+}
+
+void decoded_regs(const DecodedInst* inst, uint32_t* def, uint32_t* use) {
+    uint32_t rs = 1u << inst->rs, rt = 1u << inst->rt, rd = 1u << inst->rd;
+    switch (inst->op) {
+        case OP_ADDU: case OP_OR: case OP_SLT: case OP_SLTU:
+            *def = rd;
+            *use = rs | rt;
+            break;
+        case OP_SLL:
+            *def = rd;
+            *use = rt;
+            break;
+        case OP_JR:
+            *def = 0;
+            *use = rs;
+            break;
+        case OP_ADDIU: case OP_ORI: case OP_LB: case OP_LBU: case OP_LW:
+            *def = rt;
+            *use = rs;
+            break;
+        case OP_LUI:
+            *def = rt;
+            *use = 0;
+            break;
+        case OP_SB: case OP_SW: case OP_BEQ: case OP_BNE:
+            *def = 0;
+            *use = rs | rt;
+            break;
+        case OP_JAL:
+            *def = 1u << 31;
+            *use = 0;
+            break;
+        default:
+            *def = 0;
+            *use = 0;
+            break;
+    }
+    *def &= ~1u;
+    *use &= ~1u;
+}
+
+int is_branch_op(const DecodedInst* inst) {
+    return inst->op == OP_BEQ || inst->op == OP_BNE;
+}
+
+int is_load_op(const DecodedInst* inst) {
+    return inst->op == OP_LB || inst->op == OP_LBU || inst->op == OP_LW;
+}
+
+const char* op_name(int op) {
+    return (op >= 0 && op < NUM_OPS) ? OP_NAMES[op] : OP_NAMES[OP_INVALID];
+}
+
+const char* reg_name(int reg) {
+    return REG_NAMES[reg & 0x1F];
+}
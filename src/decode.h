@@ -0,0 +1,55 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stdint.h>
+
+/* Every instruction translate_inst() can encode. OP_INVALID is zero so that
+   unused entries of the decode tables are invalid.
+ */
+enum {
+    OP_INVALID = 0,
+    OP_ADDU, OP_OR, OP_SLT, OP_SLTU, OP_JR, OP_SLL,
+    OP_ADDIU, OP_ORI, OP_LUI,
+    OP_LB, OP_LBU, OP_LW, OP_SB, OP_SW,
+    OP_BEQ, OP_BNE, OP_J, OP_JAL,
+    NUM_OPS
+};
+
+/* The fields of a decoded instruction. IMM is the immediate sign-extended
+   for addiu, memory instructions and branches, and zero-extended for ori and
+   lui. TARGET is the 26-bit field of j and jal.
+ */
+typedef struct {
+    int op;
+    uint8_t rs;
+    uint8_t rt;
+    uint8_t rd;
+    uint8_t shamt;
+    int32_t imm;
+    uint32_t target;
+} DecodedInst;
+
+/* Decodes WORD into OUT using the opcode and funct tables. Fields that must
+   be zero for the instruction are checked, so only canonical encodings are
+   accepted. Returns 0 on success and -1 if WORD is not a valid instruction.
+ */
+int decode_inst(uint32_t word, DecodedInst* out);
+
+/* Sets DEF and USE to bitmasks of the registers INST writes and reads.
+   Writes to $0 are not included.
+ */
+void decoded_regs(const DecodedInst* inst, uint32_t* def, uint32_t* use);
+
+/* Returns 1 if INST is a beq or bne. */
+int is_branch_op(const DecodedInst* inst);
+
+/* Returns 1 if INST is a lb, lbu or lw. */
+int is_load_op(const DecodedInst* inst);
+
+/* Returns the mnemonic of OP. */
+const char* op_name(int op);
+
+/* Returns the conventional name of register REG, eg. "$t0". */
+const char* reg_name(int reg);
+
+#endif
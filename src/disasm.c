@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "reloc.h"
+#include "decode.h"
+#include "disasm.h"
+
+#define GENERATED_NAME_LEN 16
+
+/*******************************
+ * Symbols
+ *******************************/
+
+/* Returns the index of the instruction a beq or bne at index I branches to. */
+static int64_t branch_target(const DecodedInst* inst, uint32_t i) {
+    return (int64_t) i + 1 + inst->imm;
+}
+
+TextSymbols* create_text_symbols(const uint32_t* words, uint32_t len,
+    SymbolTable* symbols, RelocTable* relocs) {
+    TextSymbols* syms = malloc(sizeof(TextSymbols));
+    if (syms == NULL) {
+        allocation_failed();
+    }
+    syms->len = len;
+    syms->labels = calloc(len + 1, sizeof(char*));
+    syms->relocs = calloc(len + 1, sizeof(char*));
+    syms->reloc_types = calloc(len + 1, sizeof(int));
+    if (!syms->labels || !syms->relocs || !syms->reloc_types) {
+        allocation_failed();
+    }
+
+    for (uint32_t i = 0; i < symbols->len; i++) {
+        uint32_t index = symbols->tbl[i].addr / 4;
+        if (symbols->tbl[i].addr % 4 == 0 && index <= len && !syms->labels[index]) {
+            syms->labels[index] = symbols->tbl[i].name;
+        }
+    }
+    for (uint32_t i = 0; i < relocs->len; i++) {
+        uint32_t index = relocs->entries[i].offset / 4;
+        if (index < len) {
+            syms->relocs[index] = reloc_symbol(relocs, &relocs->entries[i]);
+            syms->reloc_types[index] = relocs->entries[i].type;
+        }
+    }
+
+    /* Name every branch target that has no label. */
+    uint32_t needed = 0;
+    uint8_t* targets = calloc(len + 1, 1);
+    if (targets == NULL) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        DecodedInst inst;
+        if (decode_inst(words[i], &inst) == 0 && is_branch_op(&inst)) {
+            int64_t target = branch_target(&inst, i);
+            if (target >= 0 && target <= len && !syms->labels[target]
+                && !targets[target]) {
+                targets[target] = 1;
+                needed++;
+            }
+        }
+    }
+    syms->names = malloc(GENERATED_NAME_LEN * needed + 1);
+    if (syms->names == NULL) {
+        allocation_failed();
+    }
+    char* name = syms->names;
+    for (uint32_t i = 0; i <= len; i++) {
+        if (targets[i]) {
+            sprintf(name, "L%u", 4 * i);
+            syms->labels[i] = name;
+            name += GENERATED_NAME_LEN;
+        }
+    }
+    free(targets);
+    return syms;
+}
+
+void free_text_symbols(TextSymbols* syms) {
+    free(syms->labels);
+    free(syms->relocs);
+    free(syms->reloc_types);
+    free(syms->names);
+    free(syms);
+}
+
+/*******************************
+ * Formatting
+ *******************************/
+
+/* The formatting helpers append to a line and never write past END, which
+   leaves room for the terminating null. They are used instead of sprintf()
+   because disassembly of large outputs is dominated by formatting.
+ */
+static char* put_str(char* p, const char* end, const char* str) {
+    while (*str && p < end) {
+        *p++ = *str++;
+    }
+    return p;
+}
+
+static char* put_reg(char* p, const char* end, int reg) {
+    p = put_str(p, end, " ");
+    return put_str(p, end, reg_name(reg));
+}
+
+static char* put_num(char* p, const char* end, int64_t value) {
+    char digits[24];
+    int n = 0;
+    uint64_t mag = value < 0 ? -(uint64_t) value : (uint64_t) value;
+    do {
+        digits[n++] = '0' + mag % 10;
+        mag /= 10;
+    } while (mag);
+    if (value < 0 && p < end) {
+        *p++ = '-';
+    }
+    while (n > 0 && p < end) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+/* Appends " <symbol>@hi" or " <symbol>@lo" if instruction I has a relocation
+   of TYPE, and the immediate IMM otherwise.
+ */
+static char* put_imm(char* p, const char* end, int64_t imm, uint32_t i, int type,
+    const TextSymbols* syms) {
+    p = put_str(p, end, " ");
+    if (i < syms->len && syms->relocs[i] && syms->reloc_types[i] == type) {
+        p = put_str(p, end, syms->relocs[i]);
+        return put_str(p, end, type == RELOC_HI16 ? "@hi" : "@lo");
+    }
+    return put_num(p, end, imm);
+}
+
+/* Appends the label for instruction INDEX, or the byte address if there is
+   none.
+ */
+static char* put_target(char* p, const char* end, int64_t index,
+    const TextSymbols* syms) {
+    p = put_str(p, end, " ");
+    if (index >= 0 && index <= syms->len && syms->labels[index]) {
+        return put_str(p, end, syms->labels[index]);
+    }
+    return put_num(p, end, 4 * index);
+}
+
+int disasm_inst(char* buf, uint32_t word, uint32_t i, const TextSymbols* syms) {
+    DecodedInst inst;
+    if (decode_inst(word, &inst) == -1) {
+        return -1;
+    }
+    char* p = buf;
+    const char* end = buf + DISASM_LINE_LEN - 1;
+    p = put_str(p, end, op_name(inst.op));
+
+    switch (inst.op) {
+        case OP_ADDU: case OP_OR: case OP_SLT: case OP_SLTU:
+            p = put_reg(p, end, inst.rd);
+            p = put_reg(p, end, inst.rs);
+            p = put_reg(p, end, inst.rt);
+            break;
+        case OP_SLL:
+            p = put_reg(p, end, inst.rd);
+            p = put_reg(p, end, inst.rt);
+            p = put_str(p, end, " ");
+            p = put_num(p, end, inst.shamt);
+            break;
+        case OP_JR:
+            p = put_reg(p, end, inst.rs);
+            break;
+        case OP_ADDIU: case OP_ORI:
+            p = put_reg(p, end, inst.rt);
+            p = put_reg(p, end, inst.rs);
+            p = put_imm(p, end, inst.imm, i, RELOC_LO16, syms);
+            break;
+        case OP_LUI:
+            p = put_reg(p, end, inst.rt);
+            p = put_imm(p, end, inst.imm, i, RELOC_HI16, syms);
+            break;
+        case OP_LB: case OP_LBU: case OP_LW: case OP_SB: case OP_SW:
+            p = put_reg(p, end, inst.rt);
+            p = put_str(p, end, " ");
+            p = put_num(p, end, inst.imm);
+            p = put_str(p, end, "(");
+            p = put_str(p, end, reg_name(inst.rs));
+            p = put_str(p, end, ")");
+            break;
+        case OP_BEQ: case OP_BNE:
+            p = put_reg(p, end, inst.rs);
+            p = put_reg(p, end, inst.rt);
+            p = put_target(p, end, branch_target(&inst, i), syms);
+            break;
+        case OP_J: case OP_JAL:
+            if (i < syms->len && syms->relocs[i]) {
+                p = put_str(p, end, " ");
+                p = put_str(p, end, syms->relocs[i]);
+            } else {
+                p = put_target(p, end, inst.target, syms);
+            }
+            break;
+    }
+    *p = '\0';
+    return p - buf;
+}
+
+uint32_t write_disassembly(const uint32_t* words, const TextSymbols* syms,
+    int show_addrs, FILE* output) {
+    char buf[DISASM_LINE_LEN];
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i <= syms->len; i++) {
+        if (syms->labels[i]) {
+            fputs(syms->labels[i], output);
+            fputs(":\n", output);
+        }
+        if (i == syms->len) {
+            break;
+        }
+        if (disasm_inst(buf, words[i], i, syms) == -1) {
+            fprintf(output, "\t# invalid instruction %08x", words[i]);
+            errors++;
+        } else {
+            putc('\t', output);
+            fputs(buf, output);
+        }
+        if (show_addrs) {
+            fprintf(output, "\t# %u", 4 * i);
+        }
+        putc('\n', output);
+    }
+    return errors;
+}
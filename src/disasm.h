@@ -0,0 +1,50 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stdint.h>
+
+/* Enough for the longest instruction with two 64-character labels. */
+#define DISASM_LINE_LEN 256
+
+/* Names for the LEN instructions of a .text section, indexed by
+   instruction. LABELS[i] is the label of instruction i (LABELS[LEN] the
+   label at the end of .text) and RELOCS[i] the symbol of the relocation at
+   instruction i, or NULL if there is none, with RELOC_TYPES[i] its type.
+   Branch targets without a label get one named L<address>, stored in NAMES.
+ */
+typedef struct {
+    const char** labels;
+    const char** relocs;
+    int* reloc_types;
+    char* names;
+    uint32_t len;
+} TextSymbols;
+
+/* Builds the names for WORDS from the .symbol section SYMBOLS and the
+   .relocation section RELOCS. The first symbol in SYMBOLS at an address
+   names it. Entries that point outside .text are ignored.
+ */
+TextSymbols* create_text_symbols(const uint32_t* words, uint32_t len,
+    SymbolTable* symbols, RelocTable* relocs);
+
+void free_text_symbols(TextSymbols* syms);
+
+/* Writes the canonical assembly for WORD, the instruction at index I, into
+   BUF, which must hold DISASM_LINE_LEN characters. Arguments are separated
+   by single spaces, registers use their conventional names and memory
+   operands are written as offset($reg). Branch targets and relocated jumps
+   are symbolized using SYMS, and the immediate of a lui, addiu or ori with a
+   RELOC_HI16 or RELOC_LO16 relocation is written as symbol@hi or symbol@lo. Returns the length of the text, or -1 if WORD
+   cannot be decoded.
+ */
+int disasm_inst(char* buf, uint32_t word, uint32_t i, const TextSymbols* syms);
+
+/* Writes the disassembly of WORDS to OUTPUT, one instruction per line and
+   each label on a line of its own, so that the result can be assembled
+   again. With SHOW_ADDRS, every instruction is followed by its address as a
+   comment. Returns the number of words that could not be decoded.
+ */
+uint32_t write_disassembly(const uint32_t* words, const TextSymbols* syms,
+    int show_addrs, FILE* output);
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "words.h"
+#include "data.h"
+#include "elf.h"
+
+/* The constants below are from the System V ABI and its MIPS supplement.
+   The file is built byte by byte, so <elf.h> is not needed and the byte
+   order does not depend on the host.
+ */
+#define EHDR_SIZE 52
+#define SHDR_SIZE 40
+#define SYM_SIZE 16
+#define REL_SIZE 8
+
+#define ET_REL 1
+#define EM_MIPS 8
+#define EF_MIPS_NOREORDER 0x1
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_REL 9
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_SECTION 3
+#define SHN_UNDEF 0
+
+#define R_MIPS_26 4
+#define R_MIPS_HI16 5
+#define R_MIPS_LO16 6
+
+/* Section indices, in the order the headers are written. */
+enum { SEC_NULL, SEC_TEXT, SEC_DATA, SEC_REL, SEC_SYMTAB, SEC_STRTAB, SEC_SHSTRTAB, NUM_SECTIONS };
+
+/* A growing byte buffer that integers are appended to in a fixed order. */
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+    uint32_t cap;
+    int big_endian;
+} Bytes;
+
+static void reserve(Bytes* b, uint32_t n) {
+    while (b->len + n > b->cap) {
+        b->cap = b->cap ? 2 * b->cap : 256;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL) {
+            allocation_failed();
+        }
+    }
+}
+
+static void put8(Bytes* b, uint8_t v) {
+    reserve(b, 1);
+    b->data[b->len++] = v;
+}
+
+static void put16(Bytes* b, uint16_t v) {
+    if (b->big_endian) {
+        put8(b, v >> 8);
+        put8(b, v);
+    } else {
+        put8(b, v);
+        put8(b, v >> 8);
+    }
+}
+
+static void put32(Bytes* b, uint32_t v) {
+    if (b->big_endian) {
+        put16(b, v >> 16);
+        put16(b, v);
+    } else {
+        put16(b, v);
+        put16(b, v >> 16);
+    }
+}
+
+static void put_bytes(Bytes* b, const void* data, uint32_t n) {
+    reserve(b, n);
+    memcpy(b->data + b->len, data, n);
+    b->len += n;
+}
+
+/* Appends a null-terminated STR and returns its offset. */
+static uint32_t put_string(Bytes* b, const char* str) {
+    uint32_t offset = b->len;
+    put_bytes(b, str, strlen(str) + 1);
+    return offset;
+}
+
+static void align(Bytes* b, uint32_t n) {
+    while (b->len % n) {
+        put8(b, 0);
+    }
+}
+
+static void put_symbol(Bytes* b, uint32_t name, uint32_t value, int bind, int type,
+    uint16_t shndx) {
+    put32(b, name);
+    put32(b, value);
+    put32(b, 0);
+    put8(b, (bind << 4) | type);
+    put8(b, 0);
+    put16(b, shndx);
+}
+
+static void put_section(Bytes* b, uint32_t name, uint32_t type, uint32_t flags,
+    uint32_t offset, uint32_t size, uint32_t link, uint32_t info, uint32_t align,
+    uint32_t entsize) {
+    put32(b, name);
+    put32(b, type);
+    put32(b, flags);
+    put32(b, 0);
+    put32(b, offset);
+    put32(b, size);
+    put32(b, link);
+    put32(b, info);
+    put32(b, align);
+    put32(b, entsize);
+}
+
+static uint32_t elf_reloc_type(int type) {
+    if (type == RELOC_HI16) {
+        return R_MIPS_HI16;
+    } else if (type == RELOC_LO16) {
+        return R_MIPS_LO16;
+    }
+    return R_MIPS_26;
+}
+
+int write_elf(const WordBuffer* text, const DataSection* data, SymbolTable* symtbl,
+    const RelocTable* reltbl, int big_endian, FILE* output) {
+    Bytes strtab = {NULL, 0, 0, big_endian};
+    Bytes symtab = {NULL, 0, 0, big_endian};
+    Bytes rel = {NULL, 0, 0, big_endian};
+    Bytes shstrtab = {NULL, 0, 0, big_endian};
+
+    /* Symbol 0 is null and symbol 1 the .text section, the only locals. */
+    put8(&strtab, 0);
+    put_symbol(&symtab, 0, 0, STB_LOCAL, STT_NOTYPE, SHN_UNDEF);
+    put_symbol(&symtab, 0, 0, STB_LOCAL, STT_SECTION, SEC_TEXT);
+    uint32_t first_global = 2, num_syms = first_global;
+    uint32_t* sym_of_label = malloc(sizeof(uint32_t) * (symtbl->len + 1));
+    if (sym_of_label == NULL) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        /* Local labels only appear as relocations against .text. */
+        if (is_local_label(symtbl->tbl[i].name)) {
+            sym_of_label[i] = 1;
+            continue;
+        }
+        sym_of_label[i] = num_syms++;
+        uint32_t name = put_string(&strtab, symtbl->tbl[i].name);
+        uint32_t addr = symtbl->tbl[i].addr;
+        if (addr >= DATA_BASE) {
+            put_symbol(&symtab, name, addr - DATA_BASE, STB_GLOBAL, STT_NOTYPE, SEC_DATA);
+        } else {
+            put_symbol(&symtab, name, addr, STB_GLOBAL, STT_NOTYPE, SEC_TEXT);
+        }
+    }
+
+    /* Interned relocation names map to symbol indices, adding undefined
+       symbols for the names this file does not define.
+     */
+    uint32_t* sym_of_name = malloc(sizeof(uint32_t) * (reltbl->num_names + 1));
+    if (sym_of_name == NULL) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < reltbl->num_names; i++) {
+        const char* name = reltbl->names[i];
+        int64_t index = -1;
+        for (uint32_t j = 0; j < symtbl->len && index == -1; j++) {
+            if (strcmp(symtbl->tbl[j].name, name) == 0) {
+                index = sym_of_label[j];
+            }
+        }
+        if (index == -1) {
+            put_symbol(&symtab, put_string(&strtab, name), 0, STB_GLOBAL, STT_NOTYPE,
+                SHN_UNDEF);
+            index = num_syms++;
+        }
+        sym_of_name[i] = index;
+    }
+    for (uint32_t i = 0; i < reltbl->len; i++) {
+        const Relocation* reloc = &reltbl->entries[i];
+        put32(&rel, reloc->offset);
+        put32(&rel, (sym_of_name[reloc->symbol] << 8) | elf_reloc_type(reloc->type));
+    }
+    free(sym_of_name);
+    free(sym_of_label);
+
+    uint32_t names[NUM_SECTIONS];
+    put8(&shstrtab, 0);
+    names[SEC_NULL] = 0;
+    names[SEC_TEXT] = put_string(&shstrtab, ".text");
+    names[SEC_DATA] = put_string(&shstrtab, ".data");
+    names[SEC_REL] = put_string(&shstrtab, ".rel.text");
+    names[SEC_SYMTAB] = put_string(&shstrtab, ".symtab");
+    names[SEC_STRTAB] = put_string(&shstrtab, ".strtab");
+    names[SEC_SHSTRTAB] = put_string(&shstrtab, ".shstrtab");
+
+    /* The ELF header, then each section's contents, then the headers. */
+    Bytes file = {NULL, 0, 0, big_endian};
+    static const uint8_t ident[16] = {0x7f, 'E', 'L', 'F', 1, 0, 1};
+    put_bytes(&file, ident, 4);
+    put8(&file, 1);                        // ELFCLASS32
+    put8(&file, big_endian ? 2 : 1);       // ELFDATA2MSB or ELFDATA2LSB
+    put_bytes(&file, ident + 6, 10);       // EV_CURRENT, padding
+    put16(&file, ET_REL);
+    put16(&file, EM_MIPS);
+    put32(&file, 1);
+    put32(&file, 0);                       // entry
+    put32(&file, 0);                       // program headers
+    uint32_t shoff_at = file.len;
+    put32(&file, 0);                       // section headers, filled in below
+    put32(&file, EF_MIPS_NOREORDER);
+    put16(&file, EHDR_SIZE);
+    put16(&file, 0);
+    put16(&file, 0);
+    put16(&file, SHDR_SIZE);
+    put16(&file, NUM_SECTIONS);
+    put16(&file, SEC_SHSTRTAB);
+
+    uint32_t offsets[NUM_SECTIONS];
+    offsets[SEC_TEXT] = file.len;
+    for (uint32_t i = 0; i < text->len; i++) {
+        put32(&file, text->words[i]);
+    }
+    /* The halves of an la hold the absolute address for the .out format.
+       Here the relocation is against the symbol itself, so the addend in
+       the field is zero. Against .text, for a local label, the address is
+       the addend and stays.
+     */
+    for (uint32_t i = 0; i < reltbl->len; i++) {
+        const Relocation* reloc = &reltbl->entries[i];
+        if ((reloc->type == RELOC_HI16 || reloc->type == RELOC_LO16)
+            && !is_local_label(reloc_symbol(reltbl, reloc))
+            && reloc->offset / 4 < text->len) {
+            Bytes word = {file.data + offsets[SEC_TEXT] + reloc->offset, 0, 4, big_endian};
+            put32(&word, text->words[reloc->offset / 4] & 0xFFFF0000);
+        }
+    }
+    offsets[SEC_DATA] = file.len;
+    uint32_t data_len = data ? data->len : 0;
+    if (data_len) {
+        put_bytes(&file, data->bytes, data_len);
+        align(&file, 4);
+    }
+    offsets[SEC_REL] = file.len;
+    put_bytes(&file, rel.data, rel.len);
+    offsets[SEC_SYMTAB] = file.len;
+    put_bytes(&file, symtab.data, symtab.len);
+    offsets[SEC_STRTAB] = file.len;
+    put_bytes(&file, strtab.data, strtab.len);
+    offsets[SEC_SHSTRTAB] = file.len;
+    put_bytes(&file, shstrtab.data, shstrtab.len);
+    align(&file, 4);
+
+    uint32_t shoff = file.len;
+    Bytes patch = {file.data + shoff_at, 0, 4, big_endian};
+    put32(&patch, shoff);
+
+    put_section(&file, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    put_section(&file, names[SEC_TEXT], SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+        offsets[SEC_TEXT], 4 * text->len, 0, 0, 4, 0);
+    put_section(&file, names[SEC_DATA], SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+        offsets[SEC_DATA], data_len, 0, 0, 4, 0);
+    put_section(&file, names[SEC_REL], SHT_REL, SHF_INFO_LINK, offsets[SEC_REL],
+        rel.len, SEC_SYMTAB, SEC_TEXT, 4, REL_SIZE);
+    put_section(&file, names[SEC_SYMTAB], SHT_SYMTAB, 0, offsets[SEC_SYMTAB],
+        symtab.len, SEC_STRTAB, first_global, 4, SYM_SIZE);
+    put_section(&file, names[SEC_STRTAB], SHT_STRTAB, 0, offsets[SEC_STRTAB],
+        strtab.len, 0, 0, 1, 0);
+    put_section(&file, names[SEC_SHSTRTAB], SHT_STRTAB, 0, offsets[SEC_SHSTRTAB],
+        shstrtab.len, 0, 0, 1, 0);
+
+    int err = fwrite(file.data, 1, file.len, output) == file.len ? 0 : -1;
+    free(file.data);
+    free(rel.data);
+    free(symtab.data);
+    free(strtab.data);
+    free(shstrtab.data);
+    return err;
+}
@@ -0,0 +1,23 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+
+/* Writes TEXT and DATA as an ELF32 MIPS relocatable object with the
+   sections .text, .data, .rel.text, .symtab, .strtab and .shstrtab. DATA
+   may be NULL for an empty .data, and its bytes are written as they are.
+   Every symbol in SYMTBL but the local labels becomes a global symbol
+   defined in .text, or in .data at its offset from DATA_BASE if it is a
+   data label, and every symbol that RELTBL refers to but SYMTBL does not
+   define becomes an undefined global. Each relocation becomes an R_MIPS_26,
+   R_MIPS_HI16 or R_MIPS_LO16 entry against its symbol, so the address
+   fields it covers are written as zero, the addend of a REL entry. One
+   against a local label is made against the .text section instead, and its
+   field keeps the address pass two filled in. All fields are written
+   big-endian if BIG_ENDIAN is set and little-endian otherwise. Returns 0
+   on success and -1 if writing OUTPUT fails.
+ */
+int write_elf(const WordBuffer* text, const DataSection* data, SymbolTable* symtbl,
+    const RelocTable* reltbl, int big_endian, FILE* output);
+
+#endif
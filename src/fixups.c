@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "fixups.h"
+
+const int FIXUP_BRANCH = 0;
+const int FIXUP_HI16 = 1;
+const int FIXUP_LO16 = 2;
+
+#define EMPTY_BUCKET UINT32_MAX
+
+static char* copy_string(const char* str) {
+    char* copy = malloc(strlen(str) + 1);
+    if (copy == NULL) {
+        allocation_failed();
+    }
+    strcpy(copy, str);
+    return copy;
+}
+
+FixupTable* create_fixup_table() {
+    FixupTable* table = malloc(sizeof(FixupTable));
+    if (table == NULL) {
+        allocation_failed();
+    }
+    table->chains = NULL;
+    table->len = 0;
+    table->cap = 0;
+    table->num_buckets = 16;
+    table->buckets = malloc(sizeof(uint32_t) * table->num_buckets);
+    if (table->buckets == NULL) {
+        allocation_failed();
+    }
+    memset(table->buckets, 0xFF, sizeof(uint32_t) * table->num_buckets);
+    table->pending = 0;
+    return table;
+}
+
+void free_fixup_table(FixupTable* table) {
+    for (uint32_t i = 0; i < table->len; i++) {
+        FixupChain* chain = &table->chains[i];
+        for (uint32_t j = 0; j < chain->len; j++) {
+            free(chain->fixups[j].inst);
+        }
+        free(chain->fixups);
+        free(chain->label);
+    }
+    free(table->chains);
+    free(table->buckets);
+    free(table);
+}
+
+/* Returns the bucket of TABLE that holds chain INDEX. */
+static uint32_t find_bucket(FixupTable* table, uint32_t index) {
+    uint32_t mask = table->num_buckets - 1;
+    uint32_t b = table->chains[index].hash & mask;
+    while (table->buckets[b] != index) {
+        b = (b + 1) & mask;
+    }
+    return b;
+}
+
+static void insert_bucket(FixupTable* table, uint32_t index) {
+    uint32_t mask = table->num_buckets - 1;
+    uint32_t b = table->chains[index].hash & mask;
+    while (table->buckets[b] != EMPTY_BUCKET) {
+        b = (b + 1) & mask;
+    }
+    table->buckets[b] = index;
+}
+
+/* Doubles the hash table of TABLE, keeping it at most half full. */
+static void grow_buckets(FixupTable* table) {
+    if (table->num_buckets > UINT32_MAX / 2) {
+        allocation_failed();
+    }
+    table->num_buckets *= 2;
+    table->buckets = realloc(table->buckets, sizeof(uint32_t) * table->num_buckets);
+    if (table->buckets == NULL) {
+        allocation_failed();
+    }
+    memset(table->buckets, 0xFF, sizeof(uint32_t) * table->num_buckets);
+    for (uint32_t i = 0; i < table->len; i++) {
+        insert_bucket(table, i);
+    }
+}
+
+FixupChain* find_fixups(FixupTable* table, const char* label) {
+    uint32_t mask = table->num_buckets - 1;
+    uint32_t b = hash_name(label) & mask;
+    for (; table->buckets[b] != EMPTY_BUCKET; b = (b + 1) & mask) {
+        FixupChain* chain = &table->chains[table->buckets[b]];
+        if (strcmp(chain->label, label) == 0) {
+            return chain;
+        }
+    }
+    return NULL;
+}
+
+void add_fixup(FixupTable* table, const char* label, int kind, uint32_t addr,
+    uint64_t line, const char* inst) {
+    FixupChain* chain = find_fixups(table, label);
+    if (chain == NULL) {
+        if (table->len == table->cap) {
+            if (table->cap > UINT32_MAX / 2) {
+                allocation_failed();
+            }
+            table->cap = table->cap ? table->cap * 2 : 8;
+            table->chains = realloc(table->chains, sizeof(FixupChain) * table->cap);
+            if (table->chains == NULL) {
+                allocation_failed();
+            }
+        }
+        chain = &table->chains[table->len++];
+        chain->label = copy_string(label);
+        chain->hash = hash_name(label);
+        chain->fixups = NULL;
+        chain->len = 0;
+        chain->cap = 0;
+        if (2 * table->len > table->num_buckets) {
+            grow_buckets(table);
+        } else {
+            insert_bucket(table, table->len - 1);
+        }
+    }
+    if (chain->len == chain->cap) {
+        if (chain->cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        chain->cap = chain->cap ? chain->cap * 2 : 4;
+        chain->fixups = realloc(chain->fixups, sizeof(Fixup) * chain->cap);
+        if (chain->fixups == NULL) {
+            allocation_failed();
+        }
+    }
+    Fixup* fixup = &chain->fixups[chain->len++];
+    fixup->kind = kind;
+    fixup->addr = addr;
+    fixup->line = line;
+    fixup->inst = copy_string(inst);
+    table->pending++;
+}
+
+/* Removes the chain from its bucket by shifting the buckets after it back,
+   so that no probe sequence is cut short. The last chain then takes its
+   place in CHAINS.
+ */
+void clear_fixups(FixupTable* table, FixupChain* chain) {
+    for (uint32_t i = 0; i < chain->len; i++) {
+        free(chain->fixups[i].inst);
+    }
+    free(chain->fixups);
+    free(chain->label);
+    table->pending -= chain->len;
+
+    uint32_t index = chain - table->chains, mask = table->num_buckets - 1;
+    uint32_t hole = find_bucket(table, index);
+    for (uint32_t b = (hole + 1) & mask; table->buckets[b] != EMPTY_BUCKET;
+        b = (b + 1) & mask) {
+        uint32_t home = table->chains[table->buckets[b]].hash & mask;
+        /* The entry at B can move to HOLE unless its home lies after HOLE
+           on the way to B.
+         */
+        if (((b - home) & mask) >= ((b - hole) & mask)) {
+            table->buckets[hole] = table->buckets[b];
+            hole = b;
+        }
+    }
+    table->buckets[hole] = EMPTY_BUCKET;
+
+    uint32_t last = --table->len;
+    if (index != last) {
+        table->chains[index] = table->chains[last];
+        table->buckets[find_bucket(table, last)] = index;
+    }
+}
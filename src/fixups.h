@@ -0,0 +1,62 @@
+#ifndef FIXUPS_H
+#define FIXUPS_H
+
+#include <stdint.h>
+
+extern const int FIXUP_BRANCH;   // offset field of a beq/bne
+extern const int FIXUP_HI16;     // imm field of the lui of an la
+extern const int FIXUP_LO16;     // imm field of the addiu of an la
+
+/* An instruction whose label had not been defined yet when it was encoded.
+   ADDR is the byte offset of the instruction, LINE the input line it came
+   from and INST the instruction text, kept for error messages.
+ */
+typedef struct {
+    int kind;
+    uint32_t addr;
+    uint64_t line;
+    char* inst;
+} Fixup;
+
+/* All pending fixups waiting for one label. HASH is hash_name(LABEL). */
+typedef struct {
+    char* label;
+    uint32_t hash;
+    Fixup* fixups;
+    uint32_t len;
+    uint32_t cap;
+} FixupChain;
+
+/* The chains of the labels that are still waiting, found through a hash
+   table of indices into CHAINS (BUCKETS, with UINT32_MAX marking an empty
+   bucket). A chain is removed as soon as its label is defined, so the
+   table only ever holds the forward references that are open.
+ */
+typedef struct {
+    FixupChain* chains;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t* buckets;
+    uint32_t num_buckets;
+    uint32_t pending;   // total number of unresolved fixups
+} FixupTable;
+
+FixupTable* create_fixup_table();
+
+void free_fixup_table(FixupTable* table);
+
+/* Records that the instruction at ADDR is waiting for LABEL. KIND says which
+   field has to be filled in once the address of LABEL is known.
+ */
+void add_fixup(FixupTable* table, const char* label, int kind, uint32_t addr,
+    uint64_t line, const char* inst);
+
+/* Returns the chain of fixups waiting for LABEL, or NULL if there are none. */
+FixupChain* find_fixups(FixupTable* table, const char* label);
+
+/* Marks every fixup in CHAIN as resolved and removes CHAIN, which must not
+   be used afterwards. Other chains may move.
+ */
+void clear_fixups(FixupTable* table, FixupChain* chain);
+
+#endif
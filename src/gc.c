@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "ir.h"
+#include "memstat.h"
+#include "gc.h"
+
+#define NO_UNIT UINT32_MAX
+#define EMPTY_BUCKET UINT32_MAX
+
+/* An open-addressing hash table from the names in a symbol table to their
+   indices, built once so that operands are not matched against every name.
+ */
+typedef struct {
+    uint32_t* buckets;
+    uint32_t num_buckets;
+} SymbolIndex;
+
+static SymbolIndex index_symbols(SymbolTable* symtbl) {
+    SymbolIndex index = { NULL, 16 };
+    while (index.num_buckets < 2 * symtbl->len) {
+        index.num_buckets *= 2;
+    }
+    index.buckets = malloc(sizeof(uint32_t) * index.num_buckets);
+    if (index.buckets == NULL) {
+        allocation_failed();
+    }
+    memset(index.buckets, 0xFF, sizeof(uint32_t) * index.num_buckets);
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        uint32_t b = hash_name(symtbl->tbl[i].name) & (index.num_buckets - 1);
+        while (index.buckets[b] != EMPTY_BUCKET) {
+            b = (b + 1) & (index.num_buckets - 1);
+        }
+        index.buckets[b] = i;
+    }
+    return index;
+}
+
+/* Returns the index in SYMTBL of the label named by operand ARG, which may
+   carry an @hi or @lo suffix, or -1 if ARG is not a label. INDEX is the
+   index_symbols() of SYMTBL.
+ */
+static int64_t operand_label(SymbolTable* symtbl, const SymbolIndex* index,
+    const char* arg) {
+    if (arg[0] == '$' || arg[0] == '-' || (arg[0] >= '0' && arg[0] <= '9')) {
+        return -1;
+    }
+    char name[IR_LINE_LEN];
+    size_t len = strcspn(arg, "@");
+    if (len >= IR_LINE_LEN) {
+        return -1;
+    }
+    memcpy(name, arg, len);
+    name[len] = '\0';
+    uint32_t mask = index->num_buckets - 1;
+    for (uint32_t b = hash_name(name) & mask; index->buckets[b] != EMPTY_BUCKET;
+        b = (b + 1) & mask) {
+        if (strcmp(symtbl->tbl[index->buckets[b]].name, name) == 0) {
+            return index->buckets[b];
+        }
+    }
+    return -1;
+}
+
+/* Returns 1 if control never falls through INST to the next instruction. */
+static int ends_unit(const Inst* inst) {
+    return strcmp(inst->name, "j") == 0 || strcmp(inst->name, "jr") == 0;
+}
+
+int gc_program(Program* program, SymbolTable* symtbl, const char* entry) {
+    uint32_t len = program->len;
+    if (len == 0) {
+        return 0;
+    }
+    uint32_t* unit_of = malloc(sizeof(uint32_t) * len);
+    uint32_t* starts = malloc(sizeof(uint32_t) * (len + 1));
+    uint32_t* label_unit = malloc(sizeof(uint32_t) * (symtbl->len + 1));
+    if (!unit_of || !starts || !label_unit) {
+        allocation_failed();
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (i == 0 || program->insts[i].num_labels > 0) {
+            starts[n++] = i;
+        }
+        unit_of[i] = n - 1;
+    }
+    starts[n] = len;
+    for (uint32_t k = 0; k < symtbl->len; k++) {
+        label_unit[k] = NO_UNIT;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        for (uint32_t j = 0; j < program->insts[i].num_labels; j++) {
+            label_unit[program->insts[i].labels[j]] = unit_of[i];
+        }
+    }
+
+    SymbolIndex index = index_symbols(symtbl);
+    uint32_t root = 0;
+    if (entry) {
+        int64_t label = operand_label(symtbl, &index, entry);
+        if (label == -1 || label_unit[label] == NO_UNIT) {
+            write_to_log("Error: entry symbol is not a label in the program: %s\n", entry);
+            free(index.buckets);
+            free(unit_of);
+            free(starts);
+            free(label_unit);
+            return -1;
+        }
+        root = label_unit[label];
+    }
+
+    /* Mark every unit reachable from ROOT. */
+    uint8_t* reached = calloc(n, 1);
+    uint32_t* work = malloc(sizeof(uint32_t) * n);
+    if (!reached || !work) {
+        allocation_failed();
+    }
+    uint32_t num_work = 0;
+    reached[root] = 1;
+    work[num_work++] = root;
+    while (num_work > 0) {
+        uint32_t u = work[--num_work];
+        for (uint32_t i = starts[u]; i < starts[u + 1]; i++) {
+            Inst* inst = &program->insts[i];
+            for (int a = 0; a < inst->num_args; a++) {
+                int64_t label = operand_label(symtbl, &index, inst->args[a]);
+                uint32_t target = label == -1 ? NO_UNIT : label_unit[label];
+                if (target != NO_UNIT && !reached[target]) {
+                    reached[target] = 1;
+                    work[num_work++] = target;
+                }
+            }
+        }
+        if (u + 1 < n && !ends_unit(&program->insts[starts[u + 1] - 1])
+            && !reached[u + 1]) {
+            reached[u + 1] = 1;
+            work[num_work++] = u + 1;
+        }
+    }
+
+    free(index.buckets);
+
+    /* Delete the rest, dropping its labels rather than carrying them on. */
+    uint8_t* keep = malloc(symtbl->len + 1);
+    if (keep == NULL) {
+        allocation_failed();
+    }
+    memset(keep, 1, symtbl->len + 1);
+    int removed = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        Inst* inst = &program->insts[i];
+        if (reached[unit_of[i]]) {
+            continue;
+        }
+        for (uint32_t j = 0; j < inst->num_labels; j++) {
+            keep[inst->labels[j]] = 0;
+        }
+        mem_count(MEM_IR, sizeof(uint32_t) * inst->num_labels, 0);
+        free(inst->labels);
+        inst->labels = NULL;
+        inst->num_labels = 0;
+        delete_inst(inst);
+        removed++;
+    }
+    compact_program(program);
+
+    if (removed) {
+        uint32_t* remap = remove_symbols(symtbl, keep);
+        for (uint32_t i = 0; i < program->len; i++) {
+            Inst* inst = &program->insts[i];
+            for (uint32_t j = 0; j < inst->num_labels; j++) {
+                inst->labels[j] = remap[inst->labels[j]];
+            }
+        }
+        for (uint32_t j = 0; j < program->num_end_labels; j++) {
+            program->end_labels[j] = remap[program->end_labels[j]];
+        }
+        free(remap);
+    }
+
+    free(keep);
+    free(reached);
+    free(work);
+    free(unit_of);
+    free(starts);
+    free(label_unit);
+    return removed;
+}
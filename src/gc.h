@@ -0,0 +1,17 @@
+#ifndef GC_H
+#define GC_H
+
+#include <stdint.h>
+
+/* Removes the code of PROGRAM that cannot be reached from the label ENTRY,
+   or from the first instruction if ENTRY is NULL. The program is split into
+   units at every label, and a unit reaches the next one by falling through
+   unless it ends in j or jr, and every unit whose label it names in an
+   operand (j/jal targets, branch targets and label@hi/label@lo). The labels
+   of removed units are removed from SYMTBL and the indices in PROGRAM are
+   renumbered; call update_symbols() afterwards. Returns the number of
+   instructions removed, or -1 if ENTRY is not a label of PROGRAM.
+ */
+int gc_program(Program* program, SymbolTable* symtbl, const char* entry);
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "translate_utils.h"
+#include "ir.h"
+#include "data.h"
+#include "memstat.h"
+
+static const char* IR_DELIMS = " \f\n\r\t\v";
+
+/*******************************
+ * Instructions
+ *******************************/
+
+void init_inst(Inst* inst, const char* name, char** args, int num_args) {
+    size_t len = strlen(name) + 1;
+    for (int i = 0; i < num_args; i++) {
+        len += strlen(args[i]) + 1;
+    }
+    char* text = malloc(len);
+    if (text == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_IR, 0, len);
+
+    char* pos = text;
+    strcpy(pos, name);
+    inst->name = pos;
+    pos += strlen(name) + 1;
+    for (int i = 0; i < num_args; i++) {
+        strcpy(pos, args[i]);
+        inst->args[i] = pos;
+        pos += strlen(args[i]) + 1;
+    }
+    inst->num_args = num_args;
+    inst->text = text;
+    inst->labels = NULL;
+    inst->num_labels = 0;
+}
+
+/* Returns the size of the block holding the name and arguments of INST. */
+static size_t inst_text_size(const Inst* inst) {
+    const char* last = inst->num_args ? inst->args[inst->num_args - 1] : inst->name;
+    return last + strlen(last) + 1 - inst->text;
+}
+
+void set_inst(Inst* inst, const char* name, char** args, int num_args) {
+    uint32_t* labels = inst->labels;
+    uint32_t num_labels = inst->num_labels;
+    char* old_text = inst->text;
+    mem_count(MEM_IR, inst_text_size(inst), 0);
+
+    init_inst(inst, name, args, num_args);
+    inst->labels = labels;
+    inst->num_labels = num_labels;
+    free(old_text);
+}
+
+void add_label(Inst* inst, uint32_t label) {
+    inst->labels = realloc(inst->labels, sizeof(uint32_t) * (inst->num_labels + 1));
+    if (inst->labels == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_IR, sizeof(uint32_t) * inst->num_labels,
+        sizeof(uint32_t) * (inst->num_labels + 1));
+    inst->labels[inst->num_labels++] = label;
+}
+
+void delete_inst(Inst* inst) {
+    mem_count(MEM_IR, inst_text_size(inst), 0);
+    free(inst->text);
+    inst->text = NULL;
+    inst->name = NULL;
+}
+
+static int reg_arg(const Inst* inst, int i) {
+    if (i >= inst->num_args) {
+        return -1;
+    }
+    return translate_reg(inst->args[i]);
+}
+
+static uint32_t reg_bit(int reg) {
+    return reg > 0 ? 1u << reg : 0;
+}
+
+void inst_regs(const Inst* inst, uint32_t* def, uint32_t* use) {
+    const char* name = inst->name;
+    *def = 0;
+    *use = 0;
+    if (strcmp(name, "addu") == 0 || strcmp(name, "or") == 0
+        || strcmp(name, "slt") == 0 || strcmp(name, "sltu") == 0) {
+        *def = reg_bit(reg_arg(inst, 0));
+        *use = reg_bit(reg_arg(inst, 1)) | reg_bit(reg_arg(inst, 2));
+    } else if (strcmp(name, "sll") == 0 || strcmp(name, "addiu") == 0
+        || strcmp(name, "ori") == 0) {
+        *def = reg_bit(reg_arg(inst, 0));
+        *use = reg_bit(reg_arg(inst, 1));
+    } else if (strcmp(name, "lui") == 0) {
+        *def = reg_bit(reg_arg(inst, 0));
+    } else if (is_load(inst)) {
+        *def = reg_bit(reg_arg(inst, 0));
+        *use = reg_bit(reg_arg(inst, 2));
+    } else if (is_store(inst)) {
+        *use = reg_bit(reg_arg(inst, 0)) | reg_bit(reg_arg(inst, 2));
+    } else if (strcmp(name, "beq") == 0 || strcmp(name, "bne") == 0) {
+        *use = reg_bit(reg_arg(inst, 0)) | reg_bit(reg_arg(inst, 1));
+    } else if (strcmp(name, "jr") == 0) {
+        *use = reg_bit(reg_arg(inst, 0));
+    } else if (strcmp(name, "jal") == 0) {
+        *def = reg_bit(31);
+    }
+}
+
+int is_block_end(const Inst* inst) {
+    return strcmp(inst->name, "beq") == 0 || strcmp(inst->name, "bne") == 0
+        || strcmp(inst->name, "j") == 0 || strcmp(inst->name, "jr") == 0;
+}
+
+int is_load(const Inst* inst) {
+    return strcmp(inst->name, "lw") == 0 || strcmp(inst->name, "lb") == 0
+        || strcmp(inst->name, "lbu") == 0;
+}
+
+int is_store(const Inst* inst) {
+    return strcmp(inst->name, "sw") == 0 || strcmp(inst->name, "sb") == 0;
+}
+
+/*******************************
+ * Programs
+ *******************************/
+
+static Program* create_program() {
+    Program* program = malloc(sizeof(Program));
+    if (program == NULL) {
+        allocation_failed();
+    }
+    program->cap = 64;
+    program->insts = malloc(sizeof(Inst) * program->cap);
+    if (program->insts == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_IR, 0, sizeof(Program) + sizeof(Inst) * program->cap);
+    mem_unused(MEM_IR, sizeof(Inst) * program->cap);
+    program->len = 0;
+    program->end_labels = NULL;
+    program->num_end_labels = 0;
+    program->next_local_label = 0;
+    return program;
+}
+
+uint32_t append_inst(Program* program, const char* name, char** args,
+    int num_args) {
+    if (program->len == program->cap) {
+        if (program->cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        mem_count(MEM_IR, sizeof(Inst) * program->cap, sizeof(Inst) * 2 * program->cap);
+        mem_unused(MEM_IR, sizeof(Inst) * program->cap);
+        program->cap *= 2;
+        program->insts = realloc(program->insts, sizeof(Inst) * program->cap);
+        if (program->insts == NULL) {
+            allocation_failed();
+        }
+    }
+    mem_unused(MEM_IR, -(int64_t) sizeof(Inst));
+    init_inst(&program->insts[program->len], name, args, num_args);
+    return program->len++;
+}
+
+void add_end_label(Program* program, uint32_t label) {
+    program->end_labels = realloc(program->end_labels,
+        sizeof(uint32_t) * (program->num_end_labels + 1));
+    if (program->end_labels == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_IR, sizeof(uint32_t) * program->num_end_labels,
+        sizeof(uint32_t) * (program->num_end_labels + 1));
+    program->end_labels[program->num_end_labels++] = label;
+}
+
+uint32_t new_local_label(Program* program, SymbolTable* symtbl) {
+    char name[32];
+    sprintf(name, ".L%u", program->next_local_label++);
+    int mode = symtbl->mode;
+    symtbl->mode = SYMTBL_NON_UNIQUE;
+    add_to_table(symtbl, name, 0);
+    symtbl->mode = mode;
+    return symtbl->len - 1;
+}
+
+Program* read_program(FILE* input, SymbolTable* symtbl) {
+    char buf[IR_LINE_LEN], *args[INST_MAX_ARGS];
+    Program* program = create_program();
+
+    while (fgets(buf, IR_LINE_LEN, input)) {
+        char* name = strtok(buf, IR_DELIMS);
+        if (name == NULL) {
+            continue;
+        }
+        int num_args = 0;
+        char* splitter;
+        while ((splitter = strtok(NULL, IR_DELIMS)) != NULL) {
+            if (num_args == INST_MAX_ARGS) {
+                free_program(program);
+                return NULL;
+            }
+            args[num_args++] = splitter;
+        }
+        append_inst(program, name, args, num_args);
+    }
+
+    /* Labels added by an earlier pass over the same symbol table keep
+       their numbers.
+     */
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        const char* name = symtbl->tbl[i].name;
+        if (is_local_label(name)) {
+            uint32_t n = strtoul(name + 2, NULL, 10);
+            if (n >= program->next_local_label) {
+                program->next_local_label = n + 1;
+            }
+        }
+        if (symtbl->tbl[i].addr >= DATA_BASE) {
+            continue;
+        }
+        uint32_t index = symtbl->tbl[i].addr / 4;
+        if (index < program->len) {
+            add_label(&program->insts[index], i);
+        } else {
+            add_end_label(program, i);
+        }
+    }
+    return program;
+}
+
+void write_program(Program* program, FILE* output) {
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        write_inst_string(output, inst->name, inst->args, inst->num_args);
+    }
+}
+
+void free_program(Program* program) {
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        if (inst->name) {
+            mem_count(MEM_IR, inst_text_size(inst), 0);
+        }
+        mem_count(MEM_IR, sizeof(uint32_t) * inst->num_labels, 0);
+        free(inst->text);
+        free(inst->labels);
+    }
+    mem_count(MEM_IR, sizeof(Program) + sizeof(Inst) * program->cap
+        + sizeof(uint32_t) * program->num_end_labels, 0);
+    mem_unused(MEM_IR, -(int64_t) sizeof(Inst) * (program->cap - program->len));
+    free(program->insts);
+    free(program->end_labels);
+    free(program);
+}
+
+void replace_insts(Program* program, Inst* insts, uint32_t len, uint32_t cap) {
+    mem_count(MEM_IR, sizeof(Inst) * program->cap, sizeof(Inst) * cap);
+    mem_unused(MEM_IR, (int64_t) sizeof(Inst) * ((int64_t) (cap - len)
+        - (int64_t) (program->cap - program->len)));
+    free(program->insts);
+    program->insts = insts;
+    program->len = len;
+    program->cap = cap;
+}
+
+void compact_program(Program* program) {
+    uint32_t* carried = NULL;
+    uint32_t num_carried = 0, len = 0;
+
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        if (inst->name == NULL) {
+            carried = realloc(carried, sizeof(uint32_t) * (num_carried + inst->num_labels));
+            if (inst->num_labels && carried == NULL) {
+                allocation_failed();
+            }
+            memcpy(carried + num_carried, inst->labels, sizeof(uint32_t) * inst->num_labels);
+            num_carried += inst->num_labels;
+            mem_count(MEM_IR, sizeof(uint32_t) * inst->num_labels, 0);
+            free(inst->labels);
+            continue;
+        }
+        for (uint32_t j = 0; j < num_carried; j++) {
+            add_label(inst, carried[j]);
+        }
+        num_carried = 0;
+        program->insts[len++] = *inst;
+    }
+    for (uint32_t j = 0; j < num_carried; j++) {
+        add_end_label(program, carried[j]);
+    }
+    free(carried);
+    mem_unused(MEM_IR, sizeof(Inst) * (program->len - len));
+    program->len = len;
+}
+
+void update_symbols(Program* program, SymbolTable* symtbl) {
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        for (uint32_t j = 0; j < inst->num_labels; j++) {
+            symtbl->tbl[inst->labels[j]].addr = 4 * i;
+        }
+    }
+    for (uint32_t j = 0; j < program->num_end_labels; j++) {
+        symtbl->tbl[program->end_labels[j]].addr = 4 * program->len;
+    }
+}
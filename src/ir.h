@@ -0,0 +1,105 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+
+#define INST_MAX_ARGS 3
+#define IR_LINE_LEN 1024
+
+/* One instruction of the intermediate file. NAME and ARGS point into TEXT.
+   LABELS holds the indices (into the symbol table's tbl array) of the labels
+   that point to this instruction. A NULL NAME marks an instruction that has
+   been deleted; its labels move to the next instruction on compaction.
+ */
+typedef struct {
+    char* name;
+    char* args[INST_MAX_ARGS];
+    int num_args;
+    char* text;
+    uint32_t* labels;
+    uint32_t num_labels;
+} Inst;
+
+/* The whole intermediate file held in memory, so that passes between pass
+   one and pass two can move, insert and delete instructions. END_LABELS are
+   labels that point past the last instruction. NEXT_LOCAL_LABEL is the
+   number of the next label new_local_label() adds.
+ */
+typedef struct {
+    Inst* insts;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t* end_labels;
+    uint32_t num_end_labels;
+    uint32_t next_local_label;
+} Program;
+
+/* Reads an intermediate file written by pass one. Labels are attached to
+   instructions using the addresses in SYMTBL; labels of the data segment
+   are left alone. Returns NULL if a line has more than INST_MAX_ARGS
+   arguments.
+ */
+Program* read_program(FILE* input, SymbolTable* symtbl);
+
+/* Writes PROGRAM in the intermediate file format. */
+void write_program(Program* program, FILE* output);
+
+void free_program(Program* program);
+
+/* Sets the address of every label in SYMTBL from the current position of
+   the instruction it is attached to.
+ */
+void update_symbols(Program* program, SymbolTable* symtbl);
+
+/* Initializes INST from NAME and ARGS. The strings are copied. */
+void init_inst(Inst* inst, const char* name, char** args, int num_args);
+
+/* Replaces the name and arguments of INST, keeping its labels. */
+void set_inst(Inst* inst, const char* name, char** args, int num_args);
+
+/* Appends an instruction to the end of PROGRAM and returns its index. */
+uint32_t append_inst(Program* program, const char* name, char** args,
+    int num_args);
+
+/* Marks INST as deleted. Call compact_program() when done. */
+void delete_inst(Inst* inst);
+
+/* Replaces the instruction array of PROGRAM with INSTS, which holds LEN
+   instructions and has room for CAP, and frees the old array.
+ */
+void replace_insts(Program* program, Inst* insts, uint32_t len, uint32_t cap);
+
+/* Removes deleted instructions, moving their labels to the next instruction. */
+void compact_program(Program* program);
+
+/* Adds the label with symbol table index LABEL to INST. */
+void add_label(Inst* inst, uint32_t label);
+
+/* Adds the label with symbol table index LABEL to the end of PROGRAM. */
+void add_end_label(Program* program, uint32_t label);
+
+/* Adds a new local label .L<n> to SYMTBL, for a pass over PROGRAM that needs
+   to refer to an instruction without one, and returns its index. Source
+   labels cannot start with a '.', so the name is taken from a counter and
+   is not checked against the rest of SYMTBL.
+ */
+uint32_t new_local_label(Program* program, SymbolTable* symtbl);
+
+/* Sets DEF and USE to bitmasks of the registers INST writes and reads, using
+   translate_reg() to decode its operands. Unknown instructions and operands
+   that are not registers contribute nothing.
+ */
+void inst_regs(const Inst* inst, uint32_t* def, uint32_t* use);
+
+/* Returns 1 if INST is a beq, bne, j or jr, ie. control does not simply fall
+   through to the next instruction.
+ */
+int is_block_end(const Inst* inst);
+
+/* Returns 1 if INST is a lb, lbu or lw. */
+int is_load(const Inst* inst);
+
+/* Returns 1 if INST is a sb or sw. */
+int is_store(const Inst* inst);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "pseudo.h"
+#include "memstat.h"
+#include "labels.h"
+
+#define EMPTY_BUCKET UINT32_MAX
+
+/* Bytes taken by one id in the arrays, which is what unused capacity is
+   counted in; the bitmaps add three bits more.
+ */
+#define ID_BYTES (sizeof(char*) + 2 * sizeof(uint32_t))
+
+static void* grow(void* ptr, size_t old_size, size_t new_size) {
+    ptr = realloc(ptr, new_size);
+    if (ptr == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_SYMBOLS, old_size, new_size);
+    return ptr;
+}
+
+static uint8_t* grow_bitmap(uint8_t* bits, uint32_t old_cap, uint32_t new_cap) {
+    bits = grow(bits, old_cap / 8, new_cap / 8);
+    memset(bits + old_cap / 8, 0, (new_cap - old_cap) / 8);
+    return bits;
+}
+
+static void rehash(LabelIds* labels, uint32_t num_buckets) {
+    labels->buckets = grow(labels->buckets, sizeof(uint32_t) * labels->num_buckets,
+        sizeof(uint32_t) * num_buckets);
+    memset(labels->buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+    labels->num_buckets = num_buckets;
+    for (uint32_t i = 0; i < labels->len; i++) {
+        const char* name = labels->names[i];
+        uint32_t b = hash_name(name) & (num_buckets - 1);
+        while (labels->buckets[b] != EMPTY_BUCKET) {
+            b = (b + 1) & (num_buckets - 1);
+        }
+        labels->buckets[b] = i;
+    }
+}
+
+/* Makes room for one more id. */
+static void grow_ids(LabelIds* labels) {
+    if (labels->cap > UINT32_MAX / 2) {
+        allocation_failed();
+    }
+    uint32_t cap = labels->cap ? 2 * labels->cap : 64;
+    labels->names = grow(labels->names, sizeof(char*) * labels->cap, sizeof(char*) * cap);
+    labels->addrs = grow(labels->addrs, sizeof(uint32_t) * labels->cap,
+        sizeof(uint32_t) * cap);
+    labels->reloc_symbols = grow(labels->reloc_symbols, sizeof(uint32_t) * labels->cap,
+        sizeof(uint32_t) * cap);
+    labels->defined = grow_bitmap(labels->defined, labels->cap, cap);
+    labels->referenced = grow_bitmap(labels->referenced, labels->cap, cap);
+    labels->undefined = grow_bitmap(labels->undefined, labels->cap, cap);
+    mem_unused(MEM_SYMBOLS, ID_BYTES * (cap - labels->cap));
+    labels->cap = cap;
+}
+
+LabelIds* create_label_ids() {
+    LabelIds* labels = calloc(1, sizeof(LabelIds));
+    if (labels == NULL) {
+        allocation_failed();
+    }
+    mem_count(MEM_SYMBOLS, 0, sizeof(LabelIds));
+    grow_ids(labels);
+    rehash(labels, 128);
+    return labels;
+}
+
+void free_label_ids(LabelIds* labels) {
+    for (uint32_t i = 0; i < labels->len; i++) {
+        mem_count(MEM_NAMES, strlen(labels->names[i]) + 1, 0);
+        free(labels->names[i]);
+    }
+    mem_count(MEM_SYMBOLS, sizeof(char*) * labels->cap, 0);
+    mem_count(MEM_SYMBOLS, sizeof(uint32_t) * labels->cap, 0);
+    mem_count(MEM_SYMBOLS, sizeof(uint32_t) * labels->cap, 0);
+    mem_count(MEM_SYMBOLS, 3 * (labels->cap / 8), 0);
+    mem_count(MEM_SYMBOLS, sizeof(uint32_t) * labels->num_buckets, 0);
+    mem_count(MEM_SYMBOLS, sizeof(uint32_t) * labels->lines_cap, 0);
+    mem_count(MEM_SYMBOLS, sizeof(LabelIds), 0);
+    mem_unused(MEM_SYMBOLS, -(int64_t) (ID_BYTES * (labels->cap - labels->len)
+        + sizeof(uint32_t) * (labels->lines_cap - labels->num_lines)));
+    free(labels->names);
+    free(labels->addrs);
+    free(labels->reloc_symbols);
+    free(labels->defined);
+    free(labels->referenced);
+    free(labels->undefined);
+    free(labels->buckets);
+    free(labels->line_labels);
+    free(labels);
+}
+
+/* Returns the id of the first LEN bytes of NAME. */
+static uint32_t intern_prefix(LabelIds* labels, const char* name, size_t len) {
+    uint32_t mask = labels->num_buckets - 1;
+    uint32_t b = hash_bytes(name, len) & mask;
+    while (labels->buckets[b] != EMPTY_BUCKET) {
+        const char* other = labels->names[labels->buckets[b]];
+        if (strncmp(other, name, len) == 0 && other[len] == '\0') {
+            return labels->buckets[b];
+        }
+        b = (b + 1) & mask;
+    }
+
+    if (labels->len == labels->cap) {
+        grow_ids(labels);
+    }
+    uint32_t id = labels->len++;
+    labels->names[id] = malloc(len + 1);
+    if (labels->names[id] == NULL) {
+        allocation_failed();
+    }
+    memcpy(labels->names[id], name, len);
+    labels->names[id][len] = '\0';
+    mem_count(MEM_NAMES, 0, len + 1);
+    mem_unused(MEM_SYMBOLS, -(int64_t) ID_BYTES);
+    labels->reloc_symbols[id] = LABEL_NONE;
+    labels->buckets[b] = id;
+
+    /* Keep the load factor at or below one half. */
+    if (2 * labels->len > labels->num_buckets) {
+        rehash(labels, 2 * labels->num_buckets);
+    }
+    return id;
+}
+
+uint32_t intern_label(LabelIds* labels, const char* name) {
+    return intern_prefix(labels, name, strlen(name));
+}
+
+void reset_label_ids(LabelIds* labels) {
+    memset(labels->defined, 0, labels->cap / 8);
+    memset(labels->referenced, 0, labels->cap / 8);
+    memset(labels->undefined, 0, labels->cap / 8);
+    mem_unused(MEM_SYMBOLS, sizeof(uint32_t) * labels->num_lines);
+    labels->num_lines = 0;
+    labels->num_undefined = 0;
+}
+
+void define_labels(LabelIds* labels, SymbolTable* symtbl) {
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        uint32_t id = intern_label(labels, symtbl->tbl[i].name);
+        labels->addrs[id] = symtbl->tbl[i].addr;
+        labels->defined[id / 8] |= 1 << (id % 8);
+    }
+}
+
+void add_label_lines(LabelIds* labels, uint32_t id, uint32_t count) {
+    if (labels->num_lines + count > labels->lines_cap) {
+        uint32_t cap = labels->lines_cap ? labels->lines_cap : 256;
+        if (labels->num_lines + count < labels->num_lines) {
+            allocation_failed();
+        }
+        while (cap < labels->num_lines + count) {
+            if (cap > UINT32_MAX / 2) {
+                allocation_failed();
+            }
+            cap *= 2;
+        }
+        labels->line_labels = grow(labels->line_labels, sizeof(uint32_t) * labels->lines_cap,
+            sizeof(uint32_t) * cap);
+        mem_unused(MEM_SYMBOLS, sizeof(uint32_t) * (cap - labels->lines_cap));
+        labels->lines_cap = cap;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        labels->line_labels[labels->num_lines++] = id;
+    }
+    mem_unused(MEM_SYMBOLS, -(int64_t) sizeof(uint32_t) * count);
+    if (id != LABEL_NONE) {
+        labels->referenced[id / 8] |= 1 << (id % 8);
+    }
+}
+
+uint32_t label_operand(LabelIds* labels, const char* name, char** args,
+    int num_args) {
+    const PseudoInst* pseudo = find_pseudo(name);
+    if (pseudo) {
+        const char* l = strchr(pseudo->operands, 'l');
+        if (l && l - pseudo->operands < num_args) {
+            return intern_label(labels, args[l - pseudo->operands]);
+        }
+        return LABEL_NONE;
+    }
+    if ((strcmp(name, "beq") == 0 || strcmp(name, "bne") == 0) && num_args == 3) {
+        return intern_label(labels, args[2]);
+    }
+    if ((strcmp(name, "j") == 0 || strcmp(name, "jal") == 0) && num_args == 1) {
+        return intern_label(labels, args[0]);
+    }
+    if ((strcmp(name, "lui") == 0 && num_args == 2)
+        || (strcmp(name, "addiu") == 0 && num_args == 3)) {
+        const char* imm = args[num_args - 1];
+        const char* at = strrchr(imm, '@');
+        if (at && (strcmp(at, "@hi") == 0 || strcmp(at, "@lo") == 0)) {
+            return intern_prefix(labels, imm, at - imm);
+        }
+    }
+    return LABEL_NONE;
+}
+
+uint32_t check_labels(LabelIds* labels) {
+    labels->num_undefined = 0;
+    for (uint32_t i = 0; i < labels->cap / 8; i++) {
+        labels->undefined[i] = labels->referenced[i] & ~labels->defined[i];
+        labels->num_undefined += __builtin_popcount(labels->undefined[i]);
+    }
+    return labels->num_undefined;
+}
+
+int is_label_undefined(const LabelIds* labels, uint32_t id) {
+    return (labels->undefined[id / 8] >> (id % 8)) & 1;
+}
+
+uint32_t label_reloc_symbol(LabelIds* labels, uint32_t id, RelocTable* reltbl) {
+    if (labels->reloc_symbols[id] == LABEL_NONE) {
+        labels->reloc_symbols[id] = intern_symbol(reltbl, labels->names[id]);
+    }
+    return labels->reloc_symbols[id];
+}
@@ -0,0 +1,81 @@
+#ifndef LABELS_H
+#define LABELS_H
+
+#include <stdint.h>
+
+#include "tables.h"
+#include "reloc.h"
+
+#define LABEL_NONE UINT32_MAX
+
+/* Dense ids for the labels of one program, given out by pass one so that
+   pass two resolves a label operand with array loads instead of a lookup
+   by name.
+
+   NAMES, ADDRS and RELOC_SYMBOLS are indexed by id. DEFINED and REFERENCED
+   are bitmaps over ids, and UNDEFINED, filled in by check_labels(), holds
+   the ids that are referenced but never defined. RELOC_SYMBOLS caches the
+   index of each name in the RelocTable given to label_reloc_symbol(), or
+   LABEL_NONE before its first relocation. LINE_LABELS holds, for each line
+   of the intermediate file, the id of the label it refers to or LABEL_NONE.
+   Names are found through an FNV-1a hash table of ids (BUCKETS).
+ */
+typedef struct {
+    char** names;
+    uint32_t* addrs;
+    uint32_t* reloc_symbols;
+    uint8_t* defined;
+    uint8_t* referenced;
+    uint8_t* undefined;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t* buckets;
+    uint32_t num_buckets;
+    uint32_t* line_labels;
+    uint32_t num_lines;
+    uint32_t lines_cap;
+    uint32_t num_undefined;
+} LabelIds;
+
+LabelIds* create_label_ids();
+
+void free_label_ids(LabelIds* labels);
+
+/* Returns the id of NAME, giving it the next one if it has none yet. */
+uint32_t intern_label(LabelIds* labels, const char* name);
+
+/* Forgets every address, reference and line, keeping the ids. Used when the
+   intermediate file is rewritten.
+ */
+void reset_label_ids(LabelIds* labels);
+
+/* Marks every symbol of SYMTBL as defined at its address. */
+void define_labels(LabelIds* labels, SymbolTable* symtbl);
+
+/* Appends COUNT lines of the intermediate file that refer to label ID,
+   which may be LABEL_NONE, and marks ID as referenced.
+ */
+void add_label_lines(LabelIds* labels, uint32_t id, uint32_t count);
+
+/* Returns the id of the label an instruction refers to, or LABEL_NONE: the
+   target of a beq, bne, j or jal, the LABEL of a LABEL@hi/LABEL@lo
+   immediate, or the 'l' operand of a pseudo-instruction, which all the
+   instructions of its expansion share.
+ */
+uint32_t label_operand(LabelIds* labels, const char* name, char** args,
+    int num_args);
+
+/* Fills in UNDEFINED from the DEFINED and REFERENCED bitmaps and returns how
+   many labels are referenced but not defined.
+ */
+uint32_t check_labels(LabelIds* labels);
+
+/* Returns 1 if ID was referenced and check_labels() found no definition. */
+int is_label_undefined(const LabelIds* labels, uint32_t id);
+
+/* Returns the index of the name of ID in the interned names of RELTBL,
+   interning it on first use only. Every call must pass the same RELTBL.
+ */
+uint32_t label_reloc_symbol(LabelIds* labels, uint32_t id, RelocTable* reltbl);
+
+#endif
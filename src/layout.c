@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "translate_utils.h"
+#include "ir.h"
+#include "layout.h"
+
+#define PROFILE_LINE_LEN 1024
+
+static const char* PROFILE_DELIMS = " \f\n\r\t\v";
+
+/* How control leaves a basic block. */
+enum { BLOCK_FALL, BLOCK_BRANCH, BLOCK_JUMP, BLOCK_RETURN };
+
+/* A run of instructions [START, END) that is only entered at START. FALL is
+   the block control falls through to and TARGET the block a beq, bne or j
+   goes to; both are -1 if there is none and NUM_BLOCKS for the end of the
+   program. The weights are the profile counts of the block and its edges.
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    int kind;
+    int64_t fall;
+    int64_t target;
+    uint64_t weight;
+    uint64_t fall_weight;
+    uint64_t target_weight;
+} Block;
+
+/*******************************
+ * Profiles
+ *******************************/
+
+void free_profile(Profile* profile) {
+    free(profile->counts);
+    free(profile->taken);
+    free(profile);
+}
+
+/* Parses a non-negative decimal count. Returns -1 if STR is not one. */
+static int parse_count(uint64_t* output, const char* str) {
+    char* end;
+    if (!str || *str == '-') {
+        return -1;
+    }
+    *output = strtoull(str, &end, 10);
+    return (end == str || *end != '\0') ? -1 : 0;
+}
+
+/* Returns the index of the instruction named by STR, which is a byte offset
+   or a label in SYMTBL, or -1 if there is none.
+ */
+static int64_t profile_index(const char* str, SymbolTable* symtbl, uint32_t len) {
+    long int addr;
+    if (translate_num(&addr, str, 0, UINT32_MAX) == -1) {
+        addr = get_addr_for_symbol(symtbl, str);
+    }
+    if (addr < 0 || addr % 4 != 0 || addr / 4 >= len) {
+        return -1;
+    }
+    return addr / 4;
+}
+
+Profile* read_profile(FILE* input, SymbolTable* symtbl, uint32_t len) {
+    char buf[PROFILE_LINE_LEN];
+    uint32_t line = 0;
+    Profile* profile = malloc(sizeof(Profile));
+    if (profile == NULL) {
+        allocation_failed();
+    }
+    profile->len = len;
+    profile->counts = calloc(len + 1, sizeof(uint64_t));
+    profile->taken = malloc(sizeof(uint64_t) * (len + 1));
+    if (!profile->counts || !profile->taken) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        profile->taken[i] = PROFILE_UNKNOWN;
+    }
+
+    while (fgets(buf, PROFILE_LINE_LEN, input)) {
+        line++;
+        char* where = strtok(buf, PROFILE_DELIMS);
+        if (where == NULL || where[0] == '#') {
+            continue;
+        }
+        char* count = strtok(NULL, PROFILE_DELIMS);
+        char* taken = strtok(NULL, PROFILE_DELIMS);
+        int64_t index = profile_index(where, symtbl, len);
+        uint64_t value, taken_value = 0;
+        if (index == -1 || parse_count(&value, count) == -1
+            || (taken && parse_count(&taken_value, taken) == -1)) {
+            write_to_log("Error - malformed profile at line %u\n", line);
+            free_profile(profile);
+            return NULL;
+        }
+        profile->counts[index] += value;
+        if (taken) {
+            if (profile->taken[index] == PROFILE_UNKNOWN) {
+                profile->taken[index] = 0;
+            }
+            profile->taken[index] += taken_value;
+        }
+    }
+    return profile;
+}
+
+/*******************************
+ * Blocks
+ *******************************/
+
+/* Returns the instruction index of the label NAME, or -1 if it is unknown. */
+static int64_t label_index(SymbolTable* symtbl, const char* name) {
+    int64_t addr = get_addr_for_symbol(symtbl, name);
+    return addr < 0 ? -1 : addr / 4;
+}
+
+/* Splits PROGRAM into blocks and returns them, setting *NUM_BLOCKS. */
+static Block* find_blocks(Program* program, SymbolTable* symtbl, uint32_t* num_blocks) {
+    uint32_t len = program->len, n = 0;
+    int64_t* block_of = malloc(sizeof(int64_t) * (len + 1));
+    Block* blocks = malloc(sizeof(Block) * (len + 1));
+    if (!block_of || !blocks) {
+        allocation_failed();
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        Inst* inst = &program->insts[i];
+        if (i == 0 || inst->num_labels > 0 || is_block_end(&program->insts[i - 1])) {
+            blocks[n].start = i;
+            n++;
+        }
+        blocks[n - 1].end = i + 1;
+        block_of[i] = n - 1;
+    }
+    block_of[len] = n;
+
+    for (uint32_t b = 0; b < n; b++) {
+        Inst* last = &program->insts[blocks[b].end - 1];
+        blocks[b].kind = BLOCK_FALL;
+        blocks[b].fall = b + 1;
+        blocks[b].target = -1;
+
+        const char* label = NULL;
+        if (strcmp(last->name, "beq") == 0 || strcmp(last->name, "bne") == 0) {
+            blocks[b].kind = BLOCK_BRANCH;
+            label = last->num_args == 3 ? last->args[2] : NULL;
+        } else if (strcmp(last->name, "j") == 0) {
+            blocks[b].kind = BLOCK_JUMP;
+            blocks[b].fall = -1;
+            label = last->num_args == 1 ? last->args[0] : NULL;
+        } else if (strcmp(last->name, "jr") == 0) {
+            blocks[b].kind = BLOCK_RETURN;
+            blocks[b].fall = -1;
+        }
+        if (label) {
+            int64_t index = label_index(symtbl, label);
+            if (index >= 0 && index <= len) {
+                blocks[b].target = block_of[index];
+            }
+        }
+    }
+    free(block_of);
+    *num_blocks = n;
+    return blocks;
+}
+
+/* Sets the block and edge weights from PROFILE. When the profile does not
+   say how often a branch was taken, the edges are weighted by the blocks
+   they lead to.
+ */
+static void weigh_blocks(Block* blocks, uint32_t n, const Profile* profile) {
+    for (uint32_t b = 0; b < n; b++) {
+        blocks[b].weight = 0;
+        for (uint32_t i = blocks[b].start; i < blocks[b].end; i++) {
+            if (profile->counts[i] > blocks[b].weight) {
+                blocks[b].weight = profile->counts[i];
+            }
+        }
+    }
+    for (uint32_t b = 0; b < n; b++) {
+        Block* block = &blocks[b];
+        uint32_t last = block->end - 1;
+        block->fall_weight = block->fall >= 0 ? block->weight : 0;
+        block->target_weight = block->target >= 0 ? block->weight : 0;
+        if (block->kind != BLOCK_BRANCH) {
+            continue;
+        }
+        if (profile->taken[last] != PROFILE_UNKNOWN) {
+            uint64_t taken = profile->taken[last], count = profile->counts[last];
+            block->target_weight = taken;
+            block->fall_weight = count > taken ? count - taken : 0;
+        } else {
+            block->target_weight = block->target >= 0 && block->target < n
+                ? blocks[block->target].weight : 0;
+            block->fall_weight = block->fall < n ? blocks[block->fall].weight : 0;
+        }
+    }
+}
+
+/* Returns the successor of BLOCK that should follow it, or -1 to end the
+   chain. A hot block is only followed by a successor it actually went to;
+   a cold one by its fall-through or jump target.
+ */
+static int64_t best_successor(const Block* blocks, uint32_t n, const Block* block,
+    const uint8_t* placed) {
+    int64_t best = -1;
+    uint64_t best_weight = 0;
+    if (block->fall >= 0 && block->fall < n && !placed[block->fall]) {
+        best = block->fall;
+        best_weight = block->fall_weight;
+    }
+    if (block->target >= 0 && block->target < n && !placed[block->target]
+        && (best == -1 || block->target_weight > best_weight)) {
+        best = block->target;
+        best_weight = block->target_weight;
+    }
+    if (block->weight > 0 && best_weight == 0) {
+        return -1;
+    }
+    return best;
+}
+
+/* Returns the new order of the blocks: the entry block, then chains grown
+   from the hottest blocks left, then the blocks that never ran.
+ */
+static uint32_t* order_blocks(const Block* blocks, uint32_t n) {
+    uint32_t* seeds = malloc(sizeof(uint32_t) * n);
+    uint32_t* order = malloc(sizeof(uint32_t) * n);
+    uint8_t* placed = calloc(n, 1);
+    if (!seeds || !order || !placed) {
+        allocation_failed();
+    }
+
+    for (uint32_t b = 0; b < n; b++) {
+        seeds[b] = b;
+    }
+    /* Insertion sort keeps equal weights in source order. */
+    for (uint32_t i = 2; i < n; i++) {
+        uint32_t seed = seeds[i], j = i;
+        while (j > 1 && blocks[seeds[j - 1]].weight < blocks[seed].weight) {
+            seeds[j] = seeds[j - 1];
+            j--;
+        }
+        seeds[j] = seed;
+    }
+
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        int64_t b = seeds[i];
+        while (b >= 0 && !placed[b]) {
+            placed[b] = 1;
+            order[len++] = b;
+            b = best_successor(blocks, n, &blocks[b], placed);
+        }
+    }
+    free(seeds);
+    free(placed);
+    return order;
+}
+
+/*******************************
+ * Layout
+ *******************************/
+
+/* Returns the symbol table index of a label for block B, adding one if the
+   block has none. B == N is the end of the program.
+ */
+static uint32_t block_label(Program* program, SymbolTable* symtbl, const Block* blocks,
+    uint32_t n, uint32_t b) {
+    if (b == n) {
+        if (program->num_end_labels == 0) {
+            add_end_label(program, new_local_label(program, symtbl));
+        }
+        return program->end_labels[0];
+    }
+    Inst* first = &program->insts[blocks[b].start];
+    if (first->num_labels == 0) {
+        add_label(first, new_local_label(program, symtbl));
+    }
+    return first->labels[0];
+}
+
+/* What has to change at the end of a block once it is placed. */
+enum { FIX_NONE, FIX_ADD_JUMP, FIX_INVERT, FIX_DELETE_JUMP };
+
+int layout_program(Program* program, SymbolTable* symtbl, const Profile* profile) {
+    uint32_t n;
+    if (program->len == 0) {
+        return 0;
+    }
+    Block* blocks = find_blocks(program, symtbl, &n);
+    weigh_blocks(blocks, n, profile);
+    uint32_t* order = order_blocks(blocks, n);
+    int* fixes = malloc(sizeof(int) * n);
+    uint32_t* labels = malloc(sizeof(uint32_t) * n);
+    if (!fixes || !labels) {
+        allocation_failed();
+    }
+
+    /* Decide on the fixes and add the labels they need before any
+       instruction is moved, since adding a label reallocates its array. */
+    int moved = 0;
+    for (uint32_t p = 0; p < n; p++) {
+        const Block* block = &blocks[order[p]];
+        int64_t next = p + 1 < n ? order[p + 1] : n;
+        moved += order[p] != p;
+        fixes[p] = FIX_NONE;
+        if (block->kind == BLOCK_FALL && block->fall != next) {
+            fixes[p] = FIX_ADD_JUMP;
+        } else if (block->kind == BLOCK_BRANCH && block->fall != next) {
+            fixes[p] = block->target == next ? FIX_INVERT : FIX_ADD_JUMP;
+        } else if (block->kind == BLOCK_JUMP && block->target == next) {
+            fixes[p] = FIX_DELETE_JUMP;
+        }
+        if (fixes[p] == FIX_ADD_JUMP || fixes[p] == FIX_INVERT) {
+            labels[p] = block_label(program, symtbl, blocks, n, block->fall);
+        }
+    }
+
+    Inst* insts = malloc(sizeof(Inst) * (program->len + n));
+    if (insts == NULL) {
+        allocation_failed();
+    }
+    uint32_t len = 0;
+    for (uint32_t p = 0; p < n; p++) {
+        const Block* block = &blocks[order[p]];
+        memcpy(insts + len, program->insts + block->start,
+            sizeof(Inst) * (block->end - block->start));
+        len += block->end - block->start;
+
+        Inst* last = &insts[len - 1];
+        if (fixes[p] == FIX_ADD_JUMP) {
+            char* label = symtbl->tbl[labels[p]].name;
+            init_inst(&insts[len++], "j", &label, 1);
+        } else if (fixes[p] == FIX_INVERT) {
+            char* args[] = { last->args[0], last->args[1], symtbl->tbl[labels[p]].name };
+            set_inst(last, strcmp(last->name, "beq") == 0 ? "bne" : "beq", args, 3);
+        } else if (fixes[p] == FIX_DELETE_JUMP) {
+            delete_inst(last);
+        }
+    }
+    replace_insts(program, insts, len, program->len + n);
+    compact_program(program);
+
+    free(blocks);
+    free(order);
+    free(fixes);
+    free(labels);
+    return moved;
+}
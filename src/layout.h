@@ -0,0 +1,39 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdint.h>
+
+#define PROFILE_UNKNOWN UINT64_MAX
+
+/* Execution counts for the instructions of an intermediate file, indexed by
+   instruction. TAKEN holds how often each beq/bne was taken, or
+   PROFILE_UNKNOWN if the profile did not say.
+ */
+typedef struct {
+    uint64_t* counts;
+    uint64_t* taken;
+    uint32_t len;
+} Profile;
+
+/* Reads a counts file for a program of LEN instructions. Every line that is
+   not empty or a '#' comment has the form
+
+       <address or label> <count> [<taken> [<ratio>]]
+
+   which includes the profile written by mipsrun. Labels are looked up in
+   SYMTBL. Returns NULL and logs the line number if a line is malformed.
+ */
+Profile* read_profile(FILE* input, SymbolTable* symtbl, uint32_t len);
+
+void free_profile(Profile* profile);
+
+/* Reorders the basic blocks of PROGRAM so that the hottest successor of
+   each block falls through, and blocks that never ran move to the end. The
+   entry block stays first. Branches are inverted and j instructions added
+   or removed to keep the control flow, and local labels from
+   new_local_label() are added to SYMTBL where a new jump needs a target. Returns the number of blocks that
+   moved.
+ */
+int layout_program(Program* program, SymbolTable* symtbl, const Profile* profile);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include "memstat.h"
+
+const int MEM_SYMBOLS = 0;
+const int MEM_RELOCS = 1;
+const int MEM_NAMES = 2;
+const int MEM_IO = 3;
+const int MEM_IR = 4;
+
+static const char* CATEGORY_NAMES[NUM_MEM_CATEGORIES] = {
+    "symbol table", "relocation table", "name strings", "I/O buffers", "IR"
+};
+
+static int enabled = 0;
+static MemCounter counters[NUM_MEM_CATEGORIES];
+static MemCounter total;
+
+void enable_mem_report() {
+    enabled = 1;
+}
+
+int is_mem_report_enabled() {
+    return enabled;
+}
+
+/* Raises *PEAK to VALUE if it is lower. */
+static void raise_peak(int64_t* peak, int64_t value) {
+    int64_t cur = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > cur && !__atomic_compare_exchange_n(peak, &cur, value, 1,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void mem_count(int category, size_t old_size, size_t new_size) {
+    if (!enabled) {
+        return;
+    }
+    int64_t delta = (int64_t) new_size - (int64_t) old_size;
+    MemCounter* counted[2] = { &counters[category], &total };
+    for (int i = 0; i < 2; i++) {
+        MemCounter* c = counted[i];
+        if (new_size) {
+            __atomic_fetch_add(&c->allocs, 1, __ATOMIC_RELAXED);
+        }
+        raise_peak(&c->peak, __atomic_add_fetch(&c->live, delta, __ATOMIC_RELAXED));
+    }
+}
+
+void mem_unused(int category, int64_t delta) {
+    if (!enabled) {
+        return;
+    }
+    MemCounter* counted[2] = { &counters[category], &total };
+    for (int i = 0; i < 2; i++) {
+        MemCounter* c = counted[i];
+        raise_peak(&c->peak_unused, __atomic_add_fetch(&c->unused, delta, __ATOMIC_RELAXED));
+    }
+}
+
+MemCounter mem_counter(int category) {
+    return counters[category];
+}
+
+static void write_counter(FILE* output, const char* name, const MemCounter* c) {
+    fprintf(output, "%-18s%12llu%14lld%14lld%14lld\n", name,
+        (unsigned long long) c->allocs, (long long) c->peak,
+        (long long) c->peak_unused, (long long) c->live);
+}
+
+void write_mem_report(FILE* output) {
+    fprintf(output, "%-18s%12s%14s%14s%14s\n", "subsystem", "allocs", "peak bytes",
+        "peak unused", "live bytes");
+    for (int i = 0; i < NUM_MEM_CATEGORIES; i++) {
+        write_counter(output, CATEGORY_NAMES[i], &counters[i]);
+    }
+    /* The total peak is of the sum, which may be below the sum of peaks. */
+    write_counter(output, "total", &total);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        /* ru_maxrss is in kilobytes on Linux. */
+        fprintf(output, "peak RSS: %ld KB\n", usage.ru_maxrss);
+    }
+}
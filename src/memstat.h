@@ -0,0 +1,51 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define NUM_MEM_CATEGORIES 5
+
+extern const int MEM_SYMBOLS;     // SymbolTable structs and entry arrays
+extern const int MEM_RELOCS;      // RelocTable entries, name arrays and buckets
+extern const int MEM_NAMES;       // copies of symbol names
+extern const int MEM_IO;          // buffers for reading and writing files
+extern const int MEM_IR;          // Program instructions, text and labels
+
+/* Allocation counters for one category. LIVE is the bytes currently held
+   and UNUSED the part of it that is capacity no entry uses yet; PEAK and
+   PEAK_UNUSED are their largest values.
+ */
+typedef struct {
+    uint64_t allocs;
+    int64_t live;
+    int64_t peak;
+    int64_t unused;
+    int64_t peak_unused;
+} MemCounter;
+
+/* Turns counting on. Until then the functions below return at once. */
+void enable_mem_report();
+
+int is_mem_report_enabled();
+
+/* Records that a block of OLD_SIZE bytes in CATEGORY was replaced by one of
+   NEW_SIZE bytes: OLD_SIZE is 0 for a new allocation and NEW_SIZE is 0 for
+   a free. Counts an allocation whenever NEW_SIZE is not 0. Safe to call
+   from several threads.
+ */
+void mem_count(int category, size_t old_size, size_t new_size);
+
+/* Adds DELTA bytes to the unused capacity of CATEGORY. */
+void mem_unused(int category, int64_t delta);
+
+/* Returns the counters of CATEGORY. */
+MemCounter mem_counter(int category);
+
+/* Writes a table of every category and the peak resident set size of the
+   process to OUTPUT.
+ */
+void write_mem_report(FILE* output);
+
+#endif
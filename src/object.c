@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "translate_utils.h"
+#include "words.h"
+#include "data.h"
+#include "object.h"
+
+#define OBJECT_LINE_LEN 1024
+
+static const int SECTION_NONE = 0;
+static const int SECTION_TEXT = 1;
+static const int SECTION_SYMBOL = 2;
+static const int SECTION_RELOCATION = 3;
+static const int SECTION_DATA = 4;
+
+/* Adds one "<address> <name>" line of the .symbol section to SYMBOLS, or of
+   the .relocation section to RELOCS if SYMBOLS is NULL.
+ */
+static int read_section_entry(SymbolTable* symbols, RelocTable* relocs, char* line,
+    uint32_t line_num) {
+    char* end;
+    unsigned long addr = strtoul(line, &end, 10);
+    char* name = strtok(end, " \t\r\n");
+    int err = (end == line || name == NULL);
+    if (!err && symbols) {
+        err = add_to_table(symbols, name, addr) != 0;
+    } else if (!err) {
+        err = read_relocation(relocs, name, addr) != 0;
+    }
+    if (err) {
+        write_to_log("Error - malformed entry at line %u: %s\n", line_num, line);
+        return -1;
+    }
+    return 0;
+}
+
+Object* read_object(FILE* input) {
+    char buf[OBJECT_LINE_LEN];
+    uint32_t line_num = 0;
+    int section = SECTION_NONE, err = 0;
+
+    Object* object = malloc(sizeof(Object));
+    if (object == NULL) {
+        allocation_failed();
+    }
+    object->text = create_word_buffer();
+    object->data = create_data_section(0);
+    object->symbols = create_table(SYMTBL_UNIQUE_NAME);
+    object->relocations = create_reloc_table();
+    object->delay_slots = 0;
+
+    while (fgets(buf, OBJECT_LINE_LEN, input)) {
+        line_num++;
+        char* line = buf + strspn(buf, " \t\r\n");
+        if (*line == '\0') {
+            continue;
+        }
+        if (section == SECTION_NONE && strncmp(line, ".set", 4) == 0) {
+            char* option = strtok(line + 4, " \t\r\n");
+            if (!option || strcmp(option, "noreorder") != 0 || strtok(NULL, " \t\r\n")) {
+                write_to_log("Error - unknown .set option at line %u\n", line_num);
+                err = -1;
+            }
+            object->delay_slots = 1;
+        } else if (strncmp(line, ".text", 5) == 0) {
+            section = SECTION_TEXT;
+        } else if (strncmp(line, ".data", 5) == 0) {
+            section = SECTION_DATA;
+        } else if (strncmp(line, ".symbol", 7) == 0) {
+            section = SECTION_SYMBOL;
+        } else if (strncmp(line, ".relocation", 11) == 0) {
+            section = SECTION_RELOCATION;
+        } else if (section == SECTION_TEXT) {
+            char* end;
+            uint32_t word = strtoul(line, &end, 16);
+            if (end == line) {
+                write_to_log("Error - malformed word at line %u: %s", line_num, line);
+                err = -1;
+            }
+            add_word(object->text, word);
+        } else if (section == SECTION_DATA) {
+            char* end;
+            uint32_t word = strtoul(line, &end, 16);
+            if (end == line) {
+                write_to_log("Error - malformed word at line %u: %s", line_num, line);
+                err = -1;
+            }
+            uint8_t bytes[4] = { word, word >> 8, word >> 16, word >> 24 };
+            add_data_bytes(object->data, bytes, 4);
+        } else if (section == SECTION_SYMBOL) {
+            err |= read_section_entry(object->symbols, NULL, line, line_num);
+        } else if (section == SECTION_RELOCATION) {
+            err |= read_section_entry(NULL, object->relocations, line, line_num);
+        } else {
+            write_to_log("Error - data outside of a section at line %u\n", line_num);
+            err = -1;
+        }
+    }
+
+    if (err) {
+        free_object(object);
+        return NULL;
+    }
+    return object;
+}
+
+void free_object(Object* object) {
+    free_word_buffer(object->text);
+    free_data_section(object->data);
+    free_table(object->symbols);
+    free_reloc_table(object->relocations);
+    free(object);
+}
+
+int link_object(Object* object) {
+    int err = 0;
+    for (uint32_t i = 0; i < object->relocations->len; i++) {
+        Relocation* reloc = &object->relocations->entries[i];
+        const char* name = reloc_symbol(object->relocations, reloc);
+        int64_t addr = get_addr_for_symbol(object->symbols, name);
+        if (addr == -1 || reloc->offset / 4 >= object->text->len) {
+            write_to_log("Error - unresolved symbol: %s\n", name);
+            err = -1;
+            continue;
+        }
+        uint32_t* word = &object->text->words[reloc->offset / 4];
+        if (reloc->type == RELOC_HI16) {
+            *word = (*word & 0xFFFF0000) | addr_hi(addr);
+        } else if (reloc->type == RELOC_LO16) {
+            *word = (*word & 0xFFFF0000) | (addr & 0xFFFF);
+        } else {
+            *word = (*word & 0xFC000000) | ((addr >> 2) & 0x03FFFFFF);
+        }
+    }
+    return err;
+}
@@ -0,0 +1,33 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdint.h>
+
+/* An assembled output file (.text, .data, .symbol and .relocation
+   sections) read back into memory. DATA holds the bytes of .data, in the
+   byte order of the simulator. DELAY_SLOTS is set if the file starts with
+   .set noreorder, which the assembler writes when it has scheduled the code
+   for branch delay slots.
+ */
+typedef struct {
+    WordBuffer* text;
+    DataSection* data;
+    SymbolTable* symbols;
+    RelocTable* relocations;
+    int delay_slots;
+} Object;
+
+/* Reads an output file written by the assembler. Returns NULL and writes to
+   the log if the file is malformed.
+ */
+Object* read_object(FILE* input);
+
+void free_object(Object* object);
+
+/* Fills in the target field of every j/jal, and the immediate of every half
+   of an la, in the relocation table with the address of its symbol, as if
+   the object were linked on its own at address 0. Returns 0 on success and -1 if a symbol is not defined in the object.
+ */
+int link_object(Object* object);
+
+#endif
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "translate_utils.h"
+#include "ir.h"
+#include "peephole.h"
+
+/*******************************
+ * Helper Functions
+ *******************************/
+
+static int is_imm(const char* str, long int value) {
+    long int imm;
+    return translate_num(&imm, str, INT32_MIN, UINT32_MAX) == 0 && imm == value;
+}
+
+/* Returns 1 if INST leaves every register unchanged, eg. addiu $x $x 0 or
+   or $x $x $0. Instructions that write $0 are kept, since they are the usual
+   way of writing an explicit nop.
+ */
+static int is_redundant(const Inst* inst) {
+    if (inst->num_args != 3) {
+        return 0;
+    }
+    const char* name = inst->name;
+    int rd = translate_reg(inst->args[0]);
+    int rs = translate_reg(inst->args[1]);
+    if (rd <= 0 || rs == -1) {
+        return 0;
+    }
+    if (strcmp(name, "addiu") == 0 || strcmp(name, "ori") == 0
+        || strcmp(name, "sll") == 0) {
+        return rd == rs && is_imm(inst->args[2], 0);
+    }
+    if (strcmp(name, "addu") == 0 || strcmp(name, "or") == 0) {
+        int rt = translate_reg(inst->args[2]);
+        return (rd == rs && rt == 0) || (rd == rt && rs == 0)
+            || (strcmp(name, "or") == 0 && rd == rs && rd == rt);
+    }
+    return 0;
+}
+
+/* Returns 1 if the value in REG is overwritten before it is read again after
+   instruction INDEX. Only the current basic block is examined; if the block
+   ends first the register is assumed to be live.
+ */
+static int is_dead_after(Program* program, uint32_t index, int reg) {
+    uint32_t def, use;
+    for (uint32_t i = index + 1; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        if (inst->name == NULL) {
+            continue;
+        }
+        if (inst->num_labels > 0) {
+            return 0;
+        }
+        inst_regs(inst, &def, &use);
+        if (use & (1u << reg)) {
+            return 0;
+        }
+        if (def & (1u << reg)) {
+            return 1;
+        }
+        if (is_block_end(inst) || strcmp(inst->name, "jal") == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Returns the index of the next instruction after INDEX that has not been
+   deleted, or PROGRAM->len if there is none.
+ */
+static uint32_t next_inst(Program* program, uint32_t index) {
+    do {
+        index++;
+    } while (index < program->len && program->insts[index].name == NULL);
+    return index;
+}
+
+/* Tries to fold a lui into the ori that follows it. "lui $r 0; ori $x $r L"
+   becomes "ori $x $0 L" and "lui $r V; ori $x $r 0" becomes "lui $x V". This
+   is only done if $r is not read again. Returns 1 if the pair was shortened.
+ */
+static int shorten_lui_ori(Program* program, uint32_t index, int reg, long int upper) {
+    uint32_t next = next_inst(program, index);
+    if (next == program->len) {
+        return 0;
+    }
+    Inst* ori = &program->insts[next];
+    if (ori->num_labels > 0 || strcmp(ori->name, "ori") != 0 || ori->num_args != 3
+        || translate_reg(ori->args[1]) != reg || translate_reg(ori->args[0]) == reg
+        || !is_dead_after(program, next, reg)) {
+        return 0;
+    }
+
+    char upper_str[16];
+    char* args[3];
+    if (upper == 0) {
+        args[0] = ori->args[0];
+        args[1] = "$0";
+        args[2] = ori->args[2];
+        set_inst(ori, "ori", args, 3);
+        delete_inst(&program->insts[index]);
+        return 1;
+    }
+    if (is_imm(ori->args[2], 0)) {
+        sprintf(upper_str, "%ld", upper);
+        args[0] = ori->args[0];
+        args[1] = upper_str;
+        set_inst(&program->insts[index], "lui", args, 2);
+        delete_inst(ori);
+        return 1;
+    }
+    return 0;
+}
+
+/*******************************
+ * Peephole Optimizer
+ *******************************/
+
+/* Removes or shortens redundant instructions in PROGRAM:
+
+    1. Instructions that do not change any register (addiu $x $x 0,
+       or $x $x $0, addu $x $0 $x, sll $x $x 0, ...) are removed.
+    2. A lui that loads a register with the value it is already known to
+       hold from an earlier lui in the same basic block is removed. This
+       covers consecutive li expansions that share an upper half.
+    3. A lui/ori pair where either half is zero is shortened to a single
+       instruction, if the register in between is not used again.
+
+   Labels on removed instructions move to the next instruction, so branch
+   targets stay correct once the symbol addresses are updated.
+
+   Returns the number of instructions removed.
+ */
+int optimize_program(Program* program) {
+    long int known[32];
+    uint32_t valid = 0, def, use;
+    uint32_t before = program->len;
+
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        if (inst->name == NULL) {
+            continue;
+        }
+        if (inst->num_labels > 0) {
+            valid = 0;
+        }
+
+        if (is_redundant(inst)) {
+            delete_inst(inst);
+            continue;
+        }
+
+        long int upper;
+        int reg = inst->num_args == 2 ? translate_reg(inst->args[0]) : -1;
+        if (strcmp(inst->name, "lui") == 0 && reg > 0
+            && translate_num(&upper, inst->args[1], 0, 0xFFFF) == 0) {
+            if ((valid & (1u << reg)) && known[reg] == upper) {
+                delete_inst(inst);
+                continue;
+            }
+            if (shorten_lui_ori(program, i, reg, upper)) {
+                inst = &program->insts[i];
+                if (inst->name == NULL) {
+                    valid &= ~(1u << reg);
+                    continue;
+                }
+                reg = translate_reg(inst->args[0]);
+            }
+            known[reg] = upper;
+            valid |= 1u << reg;
+            continue;
+        }
+
+        inst_regs(inst, &def, &use);
+        valid &= ~def;
+        if (is_block_end(inst) || strcmp(inst->name, "jal") == 0) {
+            valid = 0;
+        }
+    }
+
+    compact_program(program);
+    return before - program->len;
+}
@@ -0,0 +1,9 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+/* Runs the peephole optimizer over PROGRAM and returns the number of
+   instructions removed. See peephole.c for the patterns handled.
+ */
+int optimize_program(Program* program);
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "perf.h"
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#define HAVE_PERF_EVENT 1
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const int PERF_CYCLES = 0;
+const int PERF_INSTRUCTIONS = 1;
+const int PERF_BRANCH_MISSES = 2;
+const int PERF_L1D_MISSES = 3;
+const int PERF_LLC_MISSES = 4;
+const int PERF_DTLB_MISSES = 5;
+
+static const char* EVENT_NAMES[NUM_PERF_EVENTS] = {
+    "cycles", "instructions", "branch-miss", "L1d-miss", "LLC-miss", "dTLB-miss"
+};
+
+#ifdef HAVE_PERF_EVENT
+
+/* Cache events are given as cache | operation << 8 | result << 16. */
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} EVENTS[NUM_PERF_EVENTS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+/* Opens event I counting user space in this process and, through INHERIT,
+   the threads it creates afterwards. Those threads are added to the count
+   when they exit, so a phase must join its threads before it ends.
+ */
+static int open_event(int i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = EVENTS[i].type;
+    attr.config = EVENTS[i].config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Reads the value of FD and how long it was enabled and running. */
+static int read_event(int fd, uint64_t* value, uint64_t* enabled, uint64_t* running) {
+    uint64_t buf[3];
+    if (read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+        return -1;
+    }
+    *value = buf[0];
+    *enabled = buf[1];
+    *running = buf[2];
+    return 0;
+}
+
+#else
+
+static int open_event(int i) {
+    return -1;
+}
+
+static int read_event(int fd, uint64_t* value, uint64_t* enabled, uint64_t* running) {
+    return -1;
+}
+
+#endif
+
+PerfCounters* open_perf_counters() {
+    PerfCounters* perf = calloc(1, sizeof(PerfCounters));
+    if (perf == NULL) {
+        allocation_failed();
+    }
+    int opened = 0;
+    for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+        perf->fds[i] = open_event(i);
+        if (perf->fds[i] >= 0) {
+            opened++;
+        }
+    }
+    if (opened == 0) {
+        free(perf);
+        return NULL;
+    }
+    return perf;
+}
+
+void close_perf_counters(PerfCounters* perf) {
+    if (perf == NULL) {
+        return;
+    }
+#ifdef HAVE_PERF_EVENT
+    for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+        if (perf->fds[i] >= 0) {
+            close(perf->fds[i]);
+        }
+    }
+#endif
+    free(perf);
+}
+
+void perf_begin(PerfCounters* perf) {
+    if (perf == NULL) {
+        return;
+    }
+    for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+        if (perf->fds[i] >= 0 && read_event(perf->fds[i], &perf->start[i],
+            &perf->start_enabled[i], &perf->start_running[i]) != 0) {
+            perf->start[i] = perf->start_enabled[i] = perf->start_running[i] = 0;
+        }
+    }
+}
+
+void perf_end(PerfCounters* perf, const char* name) {
+    if (perf == NULL || perf->num_phases == PERF_MAX_PHASES) {
+        return;
+    }
+    PerfPhase* phase = &perf->phases[perf->num_phases++];
+    phase->name = name;
+    for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+        uint64_t value, enabled, running;
+        phase->counts[i] = 0;
+        if (perf->fds[i] < 0 || read_event(perf->fds[i], &value, &enabled, &running) != 0) {
+            continue;
+        }
+        /* A multiplexed counter only ran for part of the phase, so its
+           count is scaled to the whole of it.
+         */
+        uint64_t delta = value - perf->start[i];
+        uint64_t ran = running - perf->start_running[i];
+        uint64_t span = enabled - perf->start_enabled[i];
+        if (ran > 0 && ran < span) {
+            delta = (uint64_t) ((double) delta * span / ran);
+        }
+        phase->counts[i] = delta;
+    }
+}
+
+void write_perf_report(PerfCounters* perf, FILE* output) {
+    if (perf == NULL) {
+        return;
+    }
+    int ipc = perf->fds[PERF_CYCLES] >= 0 && perf->fds[PERF_INSTRUCTIONS] >= 0;
+    fprintf(output, "%-16s", "phase");
+    for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+        if (perf->fds[i] >= 0) {
+            fprintf(output, "%14s", EVENT_NAMES[i]);
+        }
+    }
+    fprintf(output, ipc ? "%8s\n" : "\n", "IPC");
+
+    for (uint32_t p = 0; p < perf->num_phases; p++) {
+        PerfPhase* phase = &perf->phases[p];
+        fprintf(output, "%-16s", phase->name);
+        for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+            if (perf->fds[i] >= 0) {
+                fprintf(output, "%14llu", (unsigned long long) phase->counts[i]);
+            }
+        }
+        if (ipc) {
+            uint64_t cycles = phase->counts[PERF_CYCLES];
+            fprintf(output, "%8.2f", cycles
+                ? (double) phase->counts[PERF_INSTRUCTIONS] / cycles : 0.0);
+        }
+        fprintf(output, "\n");
+    }
+}
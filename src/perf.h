@@ -0,0 +1,61 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define NUM_PERF_EVENTS 6
+#define PERF_MAX_PHASES 16
+
+extern const int PERF_CYCLES;
+extern const int PERF_INSTRUCTIONS;
+extern const int PERF_BRANCH_MISSES;
+extern const int PERF_L1D_MISSES;
+extern const int PERF_LLC_MISSES;
+extern const int PERF_DTLB_MISSES;
+
+/* The counts of one phase. COUNTS[i] is only meaningful if the event was
+   opened, and is scaled up if the kernel had to multiplex it.
+ */
+typedef struct {
+    const char* name;
+    uint64_t counts[NUM_PERF_EVENTS];
+} PerfPhase;
+
+/* Hardware counters for this process and the threads it starts. FDS[i] is
+   -1 for an event the CPU or kernel does not offer. START holds the values
+   read by perf_begin().
+ */
+typedef struct {
+    int fds[NUM_PERF_EVENTS];
+    uint64_t start[NUM_PERF_EVENTS];
+    uint64_t start_enabled[NUM_PERF_EVENTS];
+    uint64_t start_running[NUM_PERF_EVENTS];
+    PerfPhase phases[PERF_MAX_PHASES];
+    uint32_t num_phases;
+} PerfCounters;
+
+/* Opens a counter for every event with perf_event_open(). Returns NULL if
+   none could be opened, for instance outside Linux or when
+   perf_event_paranoid forbids it. Every function below does nothing for a
+   NULL PerfCounters.
+ */
+PerfCounters* open_perf_counters();
+
+void close_perf_counters(PerfCounters* perf);
+
+/* Starts a phase. */
+void perf_begin(PerfCounters* perf);
+
+/* Ends the phase started by the last perf_begin() and records what the
+   counters advanced by under NAME, which must outlive PERF. Phases past
+   PERF_MAX_PHASES are dropped.
+ */
+void perf_end(PerfCounters* perf, const char* name);
+
+/* Writes a row per phase and a column per opened event to OUTPUT, with the
+   instructions per cycle if both were counted.
+ */
+void write_perf_report(PerfCounters* perf, FILE* output);
+
+#endif
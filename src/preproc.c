@@ -0,0 +1,789 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "preproc.h"
+
+/* The separators of pass one (IGNORE_CHARS), apart from quotes, which
+   keep an .include path or a string (with its \" escapes) in one token.
+ */
+static const char* SEPARATORS = " \f\r\t\v,()";
+
+#define MACRO_BUCKETS 256
+#define LINE_TOKENS 32          // most tokens in an expanded line
+#define LINE_LEN 1024           // longest expanded line
+#define MACRO_UNIQUE -2         // piece replaced by the invocation number
+
+typedef struct {
+    const char* text;
+    uint32_t len;
+} Token;
+
+/* The tokens of one non-empty line: TOKENS[FIRST] to TOKENS[FIRST + NUM - 1]
+   of its file.
+ */
+typedef struct {
+    uint64_t line;
+    uint32_t first;
+    uint32_t num;
+} TokenLine;
+
+/* A tokenized source file. The tokens point into DATA, which is the
+   mapping of the file, or a copy of it if it could not be mapped.
+ */
+typedef struct SourceFile {
+    char* path;
+    char* data;
+    size_t size;
+    int mapped;
+    Token* tokens;
+    uint32_t num_tokens;
+    uint32_t tokens_cap;
+    TokenLine* lines;
+    uint32_t num_lines;
+    uint32_t lines_cap;
+    struct SourceFile* next;
+} SourceFile;
+
+/* Line LINE of a file, and its NUM tokens. */
+typedef struct {
+    uint64_t line;
+    const Token* tokens;
+    uint32_t num;
+} SourceLine;
+
+/* The lines of the file PATH, in order: those of FILE if it is not NULL,
+   and otherwise those of INPUT, read one at a time into BUF and tokenized
+   into TOKENS, so that a line is gone once the next one is read. LINE is
+   the number of lines read from INPUT.
+ */
+typedef struct {
+    const char* path;
+    SourceFile* file;
+    uint32_t next;
+    FILE* input;
+    char* buf;
+    size_t buf_cap;
+    Token* tokens;
+    uint32_t tokens_cap;
+    uint64_t line;
+} LineReader;
+
+/* Part of a token of a macro body: the LEN bytes at OFFSET of the macro's
+   text, or PARAM, the index of the parameter it is replaced by
+   (MACRO_UNIQUE for \@).
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    int param;
+} Piece;
+
+/* A macro body split into pieces, whose literal text is copied into TEXT
+   since the line it was read from may not outlive the definition. Body
+   line I has the tokens TOKEN_PIECES[LINES[I].first ...], each of which is
+   a run of PIECES.
+ */
+typedef struct Macro {
+    const char* name;
+    const char* file;
+    uint32_t num_params;
+    char* text;
+    uint32_t text_len;
+    uint32_t text_cap;
+    Piece* pieces;
+    uint32_t num_pieces;
+    uint32_t pieces_cap;
+    TokenLine* token_pieces;
+    uint32_t num_token_pieces;
+    uint32_t token_pieces_cap;
+    TokenLine* lines;
+    uint32_t num_lines;
+    uint32_t lines_cap;
+    struct Macro* next;
+} Macro;
+
+typedef struct {
+    FILE* output;
+    SourceMap* map;
+    Macro* macros[MACRO_BUCKETS];
+    uint32_t invocations;
+    int result;
+} Preprocessor;
+
+/* Every file tokenized by this process. */
+static SourceFile* files = NULL;
+
+/* Makes room in *PTR, an array of LEN elements of SIZE bytes and capacity
+   *CAP, for one more.
+ */
+static void reserve(void* ptr, uint32_t len, uint32_t* cap, size_t size) {
+    void** array = ptr;
+    if (len < *cap) {
+        return;
+    }
+    if (*cap > UINT32_MAX / 2) {
+        allocation_failed();
+    }
+    *cap = *cap ? 2 * *cap : 16;
+    *array = realloc(*array, size * *cap);
+    if (*array == NULL) {
+        allocation_failed();
+    }
+}
+
+static int token_is(const Token* token, const char* str) {
+    return strlen(str) == token->len && memcmp(token->text, str, token->len) == 0;
+}
+
+/*******************************
+ * Source Files
+ *******************************/
+
+/* Appends the tokens of the line that starts at P to *TOKENS, which holds
+   *NUM of them in room for *CAP, dropping its comment. Returns the end of
+   the line, its '\n' or END.
+ */
+static const char* tokenize_line(const char* p, const char* end, Token** tokens,
+    uint32_t* num, uint32_t* cap) {
+    while (p < end && *p != '\n' && *p != '#') {
+        if (strchr(SEPARATORS, *p) || *p == '\0') {
+            p++;
+            continue;
+        }
+        const char* start = p;
+        if (*p == '"') {
+            for (p++; p < end && *p != '"' && *p != '\n'; p++) {
+                if (*p == '\\' && p + 1 < end && p[1] != '\n') {
+                    p++;
+                }
+            }
+            if (p < end && *p == '"') {
+                p++;
+            }
+        } else {
+            for (; p < end && *p != '\n' && *p != '#' && *p != '"' && *p != '\0'
+                && !strchr(SEPARATORS, *p); p++);
+        }
+        reserve(tokens, *num, cap, sizeof(Token));
+        (*tokens)[*num].text = start;
+        (*tokens)[(*num)++].len = p - start;
+    }
+    for (; p < end && *p != '\n'; p++);
+    return p;
+}
+
+/* Splits the data of FILE into lines of tokens, dropping comments. */
+static void tokenize(SourceFile* file) {
+    const char* p = file->data;
+    const char* end = p + file->size;
+    uint64_t line = 1;
+    while (p < end) {
+        uint32_t first = file->num_tokens;
+        p = tokenize_line(p, end, &file->tokens, &file->num_tokens, &file->tokens_cap);
+        if (file->num_tokens > first) {
+            reserve(&file->lines, file->num_lines, &file->lines_cap, sizeof(TokenLine));
+            TokenLine* l = &file->lines[file->num_lines++];
+            l->line = line;
+            l->first = first;
+            l->num = file->num_tokens - first;
+        }
+        p++;
+        line++;
+    }
+}
+
+/* Reads all of FD into FILE, mapping it if possible. Returns 0 on success
+   and -1 on error.
+ */
+static int read_source(SourceFile* file, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        file->size = st.st_size;
+        if (file->size == 0) {
+            return 0;
+        }
+        file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (file->data != MAP_FAILED) {
+            file->mapped = 1;
+            return 0;
+        }
+    }
+
+    /* A pipe or a file that cannot be mapped is read into memory. */
+    size_t cap = 0;
+    ssize_t n;
+    file->data = NULL;
+    file->size = 0;
+    do {
+        if (file->size == cap) {
+            cap = cap ? 2 * cap : 64 * 1024;
+            file->data = realloc(file->data, cap);
+            if (file->data == NULL) {
+                allocation_failed();
+            }
+        }
+        n = read(fd, file->data + file->size, cap - file->size);
+        if (n > 0) {
+            file->size += n;
+        }
+    } while (n > 0);
+    return n < 0 ? -1 : 0;
+}
+
+/* Returns the tokenized file at PATH, reading it only the first time.
+   Returns NULL if it cannot be read.
+ */
+static SourceFile* load_source(const char* path) {
+    for (SourceFile* file = files; file; file = file->next) {
+        if (strcmp(file->path, path) == 0) {
+            return file;
+        }
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    SourceFile* file = calloc(1, sizeof(SourceFile));
+    if (file == NULL) {
+        allocation_failed();
+    }
+    int err = read_source(file, fd);
+    close(fd);
+    if (err) {
+        free(file->data);
+        free(file);
+        return NULL;
+    }
+    file->path = malloc(strlen(path) + 1);
+    if (file->path == NULL) {
+        allocation_failed();
+    }
+    strcpy(file->path, path);
+    tokenize(file);
+    file->next = files;
+    files = file;
+    return file;
+}
+
+void free_preprocessor_cache() {
+    while (files) {
+        SourceFile* next = files->next;
+        if (files->mapped) {
+            munmap(files->data, files->size);
+        } else {
+            free(files->data);
+        }
+        free(files->path);
+        free(files->tokens);
+        free(files->lines);
+        free(files);
+        files = next;
+    }
+}
+
+/* Reads the next non-empty line of R into LINE. Returns 0 on success and
+   -1 at the end of the file.
+ */
+static int next_line(LineReader* r, SourceLine* line) {
+    if (r->file) {
+        if (r->next == r->file->num_lines) {
+            return -1;
+        }
+        TokenLine* l = &r->file->lines[r->next++];
+        line->line = l->line;
+        line->tokens = &r->file->tokens[l->first];
+        line->num = l->num;
+        return 0;
+    }
+    uint32_t num = 0;
+    while (num == 0) {
+        ssize_t n = getline(&r->buf, &r->buf_cap, r->input);
+        if (n == -1) {
+            return -1;
+        }
+        r->line++;
+        tokenize_line(r->buf, r->buf + n, &r->tokens, &num, &r->tokens_cap);
+    }
+    line->line = r->line;
+    line->tokens = r->tokens;
+    line->num = num;
+    return 0;
+}
+
+/*******************************
+ * Source Map
+ *******************************/
+
+SourceMap* create_source_map() {
+    SourceMap* map = calloc(1, sizeof(SourceMap));
+    if (map == NULL) {
+        allocation_failed();
+    }
+    return map;
+}
+
+void free_source_map(SourceMap* map) {
+    for (uint32_t i = 0; i < map->num_names; i++) {
+        free(map->names[i]);
+    }
+    free(map->names);
+    free(map->runs);
+    free(map);
+}
+
+/* Returns a copy of the LEN bytes at TEXT that lives as long as MAP. */
+static const char* add_name(SourceMap* map, const char* text, size_t len) {
+    reserve(&map->names, map->num_names, &map->names_cap, sizeof(char*));
+    char* name = malloc(len + 1);
+    if (name == NULL) {
+        allocation_failed();
+    }
+    memcpy(name, text, len);
+    name[len] = '\0';
+    map->names[map->num_names++] = name;
+    return name;
+}
+
+/* Records that the next output line came from LOC, extending the last run
+   if it is the line that follows it.
+ */
+static void add_map_line(SourceMap* map, const SourceLoc* loc) {
+    map->lines++;
+    if (map->len > 0) {
+        const SourceRun* run = &map->runs[map->len - 1];
+        if (run->loc.file == loc->file && run->loc.macro == loc->macro
+            && run->loc.call_file == loc->call_file && run->loc.call_line == loc->call_line
+            && run->loc.line + (map->lines - run->first) == loc->line) {
+            return;
+        }
+    }
+    reserve(&map->runs, map->len, &map->cap, sizeof(SourceRun));
+    map->runs[map->len].first = map->lines;
+    map->runs[map->len++].loc = *loc;
+}
+
+/* Writes FILE and LINE to BUF, leaving out FILE if it is the main file. */
+static int format_place(const SourceMap* map, const char* file, uint64_t line,
+    char* buf, size_t len) {
+    if (file == map->main_file) {
+        return snprintf(buf, len, "%llu", (unsigned long long) line);
+    }
+    return snprintf(buf, len, "%s:%llu", file, (unsigned long long) line);
+}
+
+static void format_loc(const SourceMap* map, const SourceLoc* loc, char* buf, size_t len) {
+    size_t n = format_place(map, loc->file, loc->line, buf, len);
+    if (loc->macro && n < len) {
+        n += snprintf(buf + n, len - n, " in macro %s, called at ", loc->macro);
+        if (n < len) {
+            format_place(map, loc->call_file, loc->call_line, buf + n, len - n);
+        }
+    }
+}
+
+void format_source_loc(const SourceMap* map, uint64_t line, char* buf, size_t len) {
+    if (line == 0 || line > map->lines) {
+        snprintf(buf, len, "%llu", (unsigned long long) line);
+        return;
+    }
+    /* Find the last run that starts at or before LINE. */
+    uint32_t lo = 0, hi = map->len;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (map->runs[mid].first <= line) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    SourceLoc loc = map->runs[lo].loc;
+    loc.line += line - map->runs[lo].first;
+    format_loc(map, &loc, buf, len);
+}
+
+/* Logs an error "Error - WHAT at line LOC: DETAIL". */
+static void raise_error(Preprocessor* pp, const SourceLoc* loc, const char* what,
+    const Token* detail) {
+    char where[LINE_LEN];
+    format_loc(pp->map, loc, where, sizeof(where));
+    if (detail) {
+        write_to_log("Error - %s at line %s: %.*s\n", what, where, (int) detail->len,
+            detail->text);
+    } else {
+        write_to_log("Error - %s at line %s\n", what, where);
+    }
+    pp->result = -1;
+}
+
+/*******************************
+ * Macros
+ *******************************/
+
+static Macro* find_macro(Preprocessor* pp, const Token* name) {
+    Macro* macro = pp->macros[hash_bytes(name->text, name->len) % MACRO_BUCKETS];
+    for (; macro; macro = macro->next) {
+        if (token_is(name, macro->name)) {
+            return macro;
+        }
+    }
+    return NULL;
+}
+
+/* Appends LEN bytes at TEXT to the text of MACRO, returning their offset. */
+static uint32_t add_text(Macro* macro, const char* text, uint32_t len) {
+    if (macro->text_len + len > macro->text_cap) {
+        uint32_t cap = macro->text_cap ? macro->text_cap : 256;
+        while (cap < macro->text_len + len) {
+            if (cap > UINT32_MAX / 2) {
+                allocation_failed();
+            }
+            cap *= 2;
+        }
+        macro->text = realloc(macro->text, cap);
+        if (macro->text == NULL) {
+            allocation_failed();
+        }
+        macro->text_cap = cap;
+    }
+    memcpy(macro->text + macro->text_len, text, len);
+    macro->text_len += len;
+    return macro->text_len - len;
+}
+
+static void add_piece(Macro* macro, const char* text, uint32_t len, int param) {
+    if (len == 0 && param == -1) {
+        return;
+    }
+    reserve(&macro->pieces, macro->num_pieces, &macro->pieces_cap, sizeof(Piece));
+    Piece* piece = &macro->pieces[macro->num_pieces++];
+    piece->offset = len ? add_text(macro, text, len) : 0;
+    piece->len = len;
+    piece->param = param;
+}
+
+/* Splits TOKEN of a macro body into literal text and the \PARAM and \@
+   references it contains. PARAMS are the NUM_PARAMS parameter names.
+ */
+static void add_body_token(Macro* macro, const Token* token, const Token* params) {
+    reserve(&macro->token_pieces, macro->num_token_pieces, &macro->token_pieces_cap,
+        sizeof(TokenLine));
+    TokenLine* pieces = &macro->token_pieces[macro->num_token_pieces++];
+    pieces->first = macro->num_pieces;
+
+    const char* text = token->text;
+    const char* end = text + token->len;
+    const char* literal = text;
+    while (text < end) {
+        if (*text != '\\' || text + 1 == end) {
+            text++;
+            continue;
+        }
+        if (text[1] == '@') {
+            add_piece(macro, literal, text - literal, -1);
+            add_piece(macro, NULL, 0, MACRO_UNIQUE);
+            text += 2;
+            literal = text;
+            continue;
+        }
+        const char* name = text + 1;
+        const char* name_end = name;
+        while (name_end < end && (name_end[0] == '_' || (name_end[0] >= '0' && name_end[0] <= '9')
+            || ((name_end[0] | 0x20) >= 'a' && (name_end[0] | 0x20) <= 'z'))) {
+            name_end++;
+        }
+        Token ref = { name, name_end - name };
+        int param = -1;
+        for (uint32_t i = 0; i < macro->num_params; i++) {
+            if (params[i].len == ref.len && memcmp(params[i].text, ref.text, ref.len) == 0) {
+                param = i;
+            }
+        }
+        if (param == -1) {
+            text++;
+            continue;
+        }
+        add_piece(macro, literal, text - literal, -1);
+        add_piece(macro, NULL, 0, param);
+        text = name_end;
+        literal = text;
+    }
+    add_piece(macro, literal, text - literal, -1);
+    pieces->num = macro->num_pieces - pieces->first;
+}
+
+static void free_macro(Macro* macro) {
+    free(macro->text);
+    free(macro->pieces);
+    free(macro->token_pieces);
+    free(macro->lines);
+    free(macro);
+}
+
+/* Returns a copy of the NUM tokens at TOKENS, with their text copied into
+   *TEXT. Both are released with free().
+ */
+static Token* copy_tokens(const Token* tokens, uint32_t num, char** text) {
+    size_t size = 0;
+    for (uint32_t i = 0; i < num; i++) {
+        size += tokens[i].len;
+    }
+    Token* copy = malloc(sizeof(Token) * num);
+    *text = malloc(size + 1);
+    if (copy == NULL || *text == NULL) {
+        allocation_failed();
+    }
+    char* p = *text;
+    for (uint32_t i = 0; i < num; i++) {
+        memcpy(p, tokens[i].text, tokens[i].len);
+        copy[i].text = p;
+        copy[i].len = tokens[i].len;
+        p += tokens[i].len;
+    }
+    return copy;
+}
+
+/* Defines the macro whose .macro line is DEF, reading its body from R up
+   to the .endm line, or to the end of the file if there is none.
+ */
+static void define_macro(Preprocessor* pp, LineReader* r, const SourceLine* def) {
+    SourceLoc loc = { r->path, def->line, NULL, NULL, 0 };
+
+    /* The header is copied first, since reading the body may overwrite it. */
+    char* text;
+    uint32_t num = def->num;
+    Token* header = copy_tokens(def->tokens, num, &text);
+    Macro* macro = calloc(1, sizeof(Macro));
+    if (macro == NULL) {
+        allocation_failed();
+    }
+    macro->file = r->path;
+    macro->num_params = num > 2 ? num - 2 : 0;
+
+    SourceLine body;
+    int ended = 0;
+    while (!ended && next_line(r, &body) == 0) {
+        if (token_is(&body.tokens[0], ".endm")) {
+            ended = 1;
+        } else if (token_is(&body.tokens[0], ".macro")) {
+            SourceLoc nested = { r->path, body.line, NULL, NULL, 0 };
+            raise_error(pp, &nested, "nested macro definition", &header[num > 1]);
+        } else {
+            reserve(&macro->lines, macro->num_lines, &macro->lines_cap, sizeof(TokenLine));
+            TokenLine* l = &macro->lines[macro->num_lines++];
+            l->line = body.line;
+            l->first = macro->num_token_pieces;
+            l->num = body.num;
+            for (uint32_t k = 0; k < body.num; k++) {
+                add_body_token(macro, &body.tokens[k], header + 2);
+            }
+        }
+    }
+
+    if (!ended) {
+        raise_error(pp, &loc, "missing .endm for macro", num > 1 ? &header[1] : NULL);
+    } else if (num < 2) {
+        raise_error(pp, &loc, "invalid directive", &header[0]);
+    } else if (find_macro(pp, &header[1])) {
+        raise_error(pp, &loc, "macro already defined", &header[1]);
+    } else {
+        macro->name = add_name(pp->map, header[1].text, header[1].len);
+        uint32_t b = hash_bytes(header[1].text, header[1].len) % MACRO_BUCKETS;
+        macro->next = pp->macros[b];
+        pp->macros[b] = macro;
+        macro = NULL;
+    }
+    if (macro) {
+        free_macro(macro);
+    }
+    free(header);
+    free(text);
+}
+
+/*******************************
+ * Expansion
+ *******************************/
+
+/* Writes a line of NUM tokens to the output, and LOC to the map. */
+static void write_line(Preprocessor* pp, const Token* tokens, uint32_t num,
+    const SourceLoc* loc) {
+    for (uint32_t i = 0; i < num; i++) {
+        if (i) {
+            fputc(' ', pp->output);
+        }
+        fwrite(tokens[i].text, 1, tokens[i].len, pp->output);
+    }
+    fputc('\n', pp->output);
+    add_map_line(pp->map, loc);
+}
+
+static void write_statement(Preprocessor* pp, const Token* tokens, uint32_t num,
+    const SourceLoc* loc, uint32_t depth);
+
+/* Expands MACRO with the NUM_ARGS arguments ARGS, called from CALL. */
+static void expand_macro(Preprocessor* pp, Macro* macro, const Token* args,
+    uint32_t num_args, const SourceLoc* call, uint32_t depth) {
+    if (num_args > macro->num_params) {
+        raise_error(pp, call, "wrong number of macro arguments", &args[macro->num_params]);
+        return;
+    }
+    if (depth == MAX_MACRO_DEPTH) {
+        Token name = { macro->name, strlen(macro->name) };
+        raise_error(pp, call, "macro expansion nested too deeply", &name);
+        return;
+    }
+    char unique[16];
+    Token unique_token = { unique, sprintf(unique, "%u", pp->invocations++) };
+
+    for (uint32_t i = 0; i < macro->num_lines; i++) {
+        TokenLine* line = &macro->lines[i];
+        SourceLoc loc = { macro->file, line->line, macro->name, call->file, call->line };
+        char text[LINE_LEN];
+        Token tokens[LINE_TOKENS];
+        uint32_t num = 0, used = 0;
+        for (uint32_t t = 0; t < line->num; t++) {
+            TokenLine* pieces = &macro->token_pieces[line->first + t];
+            uint32_t start = used;
+            for (uint32_t p = 0; p < pieces->num; p++) {
+                Piece* piece = &macro->pieces[pieces->first + p];
+                Token literal = { macro->text + piece->offset, piece->len };
+                const Token* value = &literal;
+                if (piece->param == MACRO_UNIQUE) {
+                    value = &unique_token;
+                } else if (piece->param >= 0) {
+                    value = piece->param < num_args ? &args[piece->param] : NULL;
+                }
+                if (value && used + value->len <= LINE_LEN) {
+                    memcpy(text + used, value->text, value->len);
+                    used += value->len;
+                }
+            }
+            /* An empty argument leaves out the token. */
+            if (used > start && num < LINE_TOKENS) {
+                tokens[num].text = text + start;
+                tokens[num++].len = used - start;
+            }
+        }
+        if (num > 0) {
+            write_statement(pp, tokens, num, &loc, depth + 1);
+        }
+    }
+}
+
+/* Writes a statement, expanding it if its instruction is a macro. */
+static void write_statement(Preprocessor* pp, const Token* tokens, uint32_t num,
+    const SourceLoc* loc, uint32_t depth) {
+    uint32_t inst = tokens[0].len && tokens[0].text[tokens[0].len - 1] == ':' ? 1 : 0;
+    Macro* macro = inst < num ? find_macro(pp, &tokens[inst]) : NULL;
+    if (!macro) {
+        write_line(pp, tokens, num, loc);
+        return;
+    }
+    if (inst) {
+        write_line(pp, tokens, 1, loc);
+    }
+    expand_macro(pp, macro, tokens + inst + 1, num - inst - 1, loc, depth);
+}
+
+/*******************************
+ * Files
+ *******************************/
+
+static void preprocess_file(Preprocessor* pp, LineReader* r, uint32_t depth);
+
+/* Handles the .include on LINE of the file PATH. */
+static void include_file(Preprocessor* pp, const char* path, const SourceLine* line,
+    uint32_t depth) {
+    const Token* tokens = line->tokens;
+    SourceLoc loc = { path, line->line, NULL, NULL, 0 };
+    const Token* arg = &tokens[1];
+    if (line->num != 2 || arg->len < 2 || arg->text[0] != '"'
+        || arg->text[arg->len - 1] != '"') {
+        raise_error(pp, &loc, "invalid directive", &tokens[0]);
+        return;
+    }
+    if (depth == MAX_INCLUDE_DEPTH) {
+        raise_error(pp, &loc, "include nested too deeply", arg);
+        return;
+    }
+
+    /* A relative path is taken from the directory of PATH. */
+    const char* slash = strrchr(path, '/');
+    size_t dir_len = arg->text[1] != '/' && slash ? slash - path + 1 : 0;
+    char included_path[dir_len + arg->len - 1];
+    memcpy(included_path, path, dir_len);
+    memcpy(included_path + dir_len, arg->text + 1, arg->len - 2);
+    included_path[dir_len + arg->len - 2] = '\0';
+
+    SourceFile* included = load_source(included_path);
+    if (!included) {
+        raise_error(pp, &loc, "unable to open include file", arg);
+        return;
+    }
+    LineReader reader = { included->path, included };
+    preprocess_file(pp, &reader, depth + 1);
+}
+
+/* Writes a blank line for each line of FILE after *PREV and before LINE,
+   and sets *PREV to LINE.
+ */
+static void pad_lines(Preprocessor* pp, const char* file, uint64_t* prev, uint64_t line) {
+    SourceLoc loc = { file, *prev + 1, NULL, NULL, 0 };
+    for (; loc.line < line; loc.line++) {
+        fputc('\n', pp->output);
+        add_map_line(pp->map, &loc);
+    }
+    *prev = line;
+}
+
+static void preprocess_file(Preprocessor* pp, LineReader* r, uint32_t depth) {
+    SourceLine line;
+    uint64_t prev = 0;
+    while (next_line(r, &line) == 0) {
+        const Token* tokens = line.tokens;
+        SourceLoc loc = { r->path, line.line, NULL, NULL, 0 };
+        if (token_is(&tokens[0], ".macro")) {
+            define_macro(pp, r, &line);
+        } else if (token_is(&tokens[0], ".endm")) {
+            raise_error(pp, &loc, "invalid directive", &tokens[0]);
+        } else if (token_is(&tokens[0], ".include")) {
+            pad_lines(pp, r->path, &prev, line.line);
+            include_file(pp, r->path, &line, depth);
+        } else {
+            pad_lines(pp, r->path, &prev, line.line);
+            write_statement(pp, tokens, line.num, &loc, 0);
+        }
+    }
+}
+
+int preprocess(FILE* input, const char* name, FILE* output, SourceMap* map) {
+    Preprocessor pp;
+    memset(&pp, 0, sizeof(pp));
+    pp.output = output;
+    pp.map = map;
+    map->main_file = add_name(map, name, strlen(name));
+
+    LineReader reader = { map->main_file, NULL, 0, input };
+    preprocess_file(&pp, &reader, 0);
+    if (ferror(input)) {
+        write_to_log("Error: unable to read input file: %s\n", name);
+        pp.result = -1;
+    }
+    free(reader.buf);
+    free(reader.tokens);
+
+    for (int i = 0; i < MACRO_BUCKETS; i++) {
+        while (pp.macros[i]) {
+            Macro* next = pp.macros[i]->next;
+            free_macro(pp.macros[i]);
+            pp.macros[i] = next;
+        }
+    }
+    return pp.result;
+}
@@ -0,0 +1,93 @@
+#ifndef PREPROC_H
+#define PREPROC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Nesting limits, which also stop an .include or a macro from expanding
+   itself forever.
+ */
+#define MAX_INCLUDE_DEPTH 16
+#define MAX_MACRO_DEPTH 64
+
+/* Where one line of preprocessed source came from: line LINE of FILE. For a
+   line expanded from a macro, MACRO is its name and CALL_FILE/CALL_LINE the
+   line that invoked it; otherwise MACRO is NULL.
+ */
+typedef struct {
+    const char* file;
+    uint64_t line;
+    const char* macro;
+    const char* call_file;
+    uint64_t call_line;
+} SourceLoc;
+
+/* A run of output lines, starting at output line FIRST (counting from 1),
+   that come from consecutive lines of one file: output line FIRST + I is
+   line LOC.line + I.
+ */
+typedef struct {
+    uint64_t first;
+    SourceLoc loc;
+} SourceRun;
+
+/* The origin of every line written by preprocess(), as runs. Since lines
+   that produce no output are written as blank lines, a file only starts a
+   new run after an .include or a macro expansion, so the map stays small
+   however long the input is. LINES is the number of lines written.
+   MAIN_FILE is the file that was preprocessed; its lines are reported by
+   number alone, as pass one always has. NAMES holds copies of the main
+   file name and of the macro names the runs point to, which live as long
+   as the map.
+ */
+typedef struct {
+    SourceRun* runs;
+    uint32_t len;
+    uint32_t cap;
+    uint64_t lines;
+    const char* main_file;
+    char** names;
+    uint32_t num_names;
+    uint32_t names_cap;
+} SourceMap;
+
+SourceMap* create_source_map();
+
+void free_source_map(SourceMap* map);
+
+/* Expands the .include and .macro directives of INPUT, the file NAME, into
+   OUTPUT, with one statement per line and comments removed. Every other
+   line is passed through unchanged, apart from its separators, and a line
+   with no statement (blank, a comment or a directive) is written as a
+   blank line.
+
+   .include "FILE" reads FILE, relative to the directory of the file that
+   includes it. .macro NAME [PARAM ...] starts a definition that .endm
+   ends; in its body \PARAM is replaced by the argument given for PARAM and
+   \@ by a number unique to each invocation, so that labels inside a macro
+   stay unique. A line whose instruction is NAME invokes the macro, with at
+   most as many arguments as it has parameters (missing ones are empty).
+
+   INPUT is read one line at a time and only the macros it defines are
+   kept, so memory does not grow with its length. Included files are
+   memory-mapped and tokenized once per process, however many times they
+   are included (so a later change to one is not seen), and a macro body
+   is split into literal text and parameter references once, when it is
+   defined. The origin of each output line is appended to MAP.
+
+   Errors are written to the log with their location, and preprocessing
+   continues. Returns 0 on success and -1 if there was any error.
+ */
+int preprocess(FILE* input, const char* name, FILE* output, SourceMap* map);
+
+/* Writes the location of line LINE (counting from 1) of the preprocessed
+   output into BUF: the line number for the main file, FILE:LINE for an
+   included one, and for a macro the line in its body followed by
+   "in macro NAME, called at" and the location of the call.
+ */
+void format_source_loc(const SourceMap* map, uint64_t line, char* buf, size_t len);
+
+/* Releases the tokenized files kept by preprocess(). */
+void free_preprocessor_cache();
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "translate_utils.h"
+#include "pseudo.h"
+
+/*******************************
+ * Size Functions
+ *******************************/
+
+static unsigned size_one(const long int* imms) {
+    return 1;
+}
+
+static unsigned size_two(const long int* imms) {
+    return 2;
+}
+
+/* li fits in a single addiu if the immediate is a signed 16-bit value. */
+static unsigned size_li(const long int* imms) {
+    return (imms[1] >= IMM16_MIN && imms[1] <= IMM16_MAX) ? 1 : 2;
+}
+
+/* mul by a constant is expanded with Horner's rule over the set bits of the
+   constant, so the size is two instructions per set bit, or a single
+   instruction for zero and powers of two.
+ */
+static unsigned size_mul(const long int* imms) {
+    long int c = imms[2];
+    if (c < 0 || c > 0xFFFF) {
+        return 0;
+    }
+    int bits = __builtin_popcountl(c);
+    return bits <= 1 ? 1 : 2 * bits;
+}
+
+/*******************************
+ * Expansion Helpers
+ *******************************/
+
+static int append_line(Expansion* exp, const char* fmt, ...) {
+    if (exp->len == MAX_EXPANSION) {
+        return -1;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(exp->lines[exp->len], EXPANSION_LINE_LEN, fmt, ap);
+    va_end(ap);
+    if (n < 0 || n >= EXPANSION_LINE_LEN) {
+        return -1;
+    }
+    exp->len++;
+    return 0;
+}
+
+static int expand_mul(Expansion* exp, char** args, const long int* imms) {
+    long int c = imms[2];
+    if (c == 0) {
+        return append_line(exp, "addu %s $0 $0", args[0]);
+    }
+    int high = 63 - __builtin_clzl(c);
+    if (__builtin_popcountl(c) == 1) {
+        return append_line(exp, "sll %s %s %d", args[0], args[1], high);
+    }
+    if (translate_reg(args[1]) == 1) {
+        return -1;      // $at is the accumulator
+    }
+    int err = append_line(exp, "addu $at %s $0", args[1]);
+    int prev = high;
+    for (int bit = high - 1; bit >= 0; bit--) {
+        if (c & (1L << bit)) {
+            err |= append_line(exp, "sll $at $at %d", prev - bit);
+            err |= append_line(exp, "addu $at $at %s", args[1]);
+            prev = bit;
+        }
+    }
+    err |= append_line(exp, "sll %s $at %d", args[0], prev);
+    return err ? -1 : 0;
+}
+
+/* Fills in one template line into DST. See pseudo.h for the syntax. */
+static int format_template(char* dst, const char* tmpl, size_t len, char** args,
+    const long int* imms) {
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        char piece[EXPANSION_LINE_LEN];
+        const char* text = piece;
+        if (tmpl[i] != '%') {
+            piece[0] = tmpl[i];
+            piece[1] = '\0';
+        } else {
+            char kind = tmpl[++i];
+            if (kind >= '0' && kind <= '9') {
+                text = args[kind - '0'];
+            } else {
+                int arg = tmpl[++i] - '0';
+                long int value = imms[arg];
+                if (kind == 'h') {
+                    value = (value >> 16) & 0xFFFF;
+                } else if (kind == 'l') {
+                    value = value & 0xFFFF;
+                }
+                sprintf(piece, "%ld", value);
+            }
+        }
+        size_t n = strlen(text);
+        if (out + n >= EXPANSION_LINE_LEN) {
+            return -1;
+        }
+        memcpy(dst + out, text, n);
+        out += n;
+    }
+    dst[out] = '\0';
+    return 0;
+}
+
+static int expand_templates(Expansion* exp, const char* tmpl, char** args,
+    const long int* imms) {
+    while (*tmpl) {
+        if (exp->len == MAX_EXPANSION) {
+            return -1;
+        }
+        size_t len = strcspn(tmpl, "\n");
+        if (format_template(exp->lines[exp->len], tmpl, len, args, imms) != 0) {
+            return -1;
+        }
+        exp->len++;
+        tmpl += len;
+        if (*tmpl == '\n') {
+            tmpl++;
+        }
+    }
+    return 0;
+}
+
+/*******************************
+ * Pseudo-instruction Table
+ *******************************/
+
+static const PseudoInst PSEUDO_TABLE[] = {
+    { "li",   "ri",  size_li,  { "addiu %0 $0 %v1",
+                                 "lui $at %h1\nori %0 $at %l1" }, NULL },
+    { "blt",  "rrl", size_two, { NULL, "slt $at %0 %1\nbne $at $0 %2" }, NULL },
+    { "bgt",  "rrl", size_two, { NULL, "slt $at %1 %0\nbne $at $0 %2" }, NULL },
+    { "ble",  "rrl", size_two, { NULL, "slt $at %1 %0\nbeq $at $0 %2" }, NULL },
+    { "bge",  "rrl", size_two, { NULL, "slt $at %0 %1\nbeq $at $0 %2" }, NULL },
+    { "move", "rr",  size_one, { "addu %0 $0 %1" }, NULL },
+    { "la",   "rl",  size_two, { NULL, "lui $at %1@hi\naddiu %0 $at %1@lo" }, NULL },
+    { "mul",  "rri", size_mul, { NULL }, expand_mul },
+    { "nop",  "",    size_one, { "sll $0 $0 0" }, NULL },
+};
+
+static const int NUM_PSEUDO = sizeof(PSEUDO_TABLE) / sizeof(PseudoInst);
+
+const PseudoInst* find_pseudo(const char* name) {
+    for (int i = 0; i < NUM_PSEUDO; i++) {
+        if (strcmp(PSEUDO_TABLE[i].name, name) == 0) {
+            return &PSEUDO_TABLE[i];
+        }
+    }
+    return NULL;
+}
+
+/* Checks the operand pattern, parses the immediates once and produces the
+   expansion chosen by the size function. Registers and labels are validated
+   in pass two like every other instruction.
+ */
+unsigned expand_pseudo(Expansion* exp, const PseudoInst* pseudo, char** args,
+    int num_args) {
+    long int imms[MAX_PSEUDO_ARGS] = { 0 };
+    exp->len = 0;
+
+    if (num_args != strlen(pseudo->operands)) {
+        return 0;
+    }
+    for (int i = 0; i < num_args; i++) {
+        if (pseudo->operands[i] == 'i'
+            && translate_num(&imms[i], args[i], INT32_MIN, UINT32_MAX) == -1) {
+            return 0;
+        }
+    }
+
+    unsigned size = pseudo->size(imms);
+    if (size == 0) {
+        return 0;
+    }
+    int err;
+    if (pseudo->expand) {
+        err = pseudo->expand(exp, args, imms);
+    } else {
+        err = expand_templates(exp, pseudo->templates[size - 1], args, imms);
+    }
+    if (err != 0 || exp->len != size) {
+        exp->len = 0;
+        return 0;
+    }
+    return size;
+}
@@ -0,0 +1,52 @@
+#ifndef PSEUDO_H
+#define PSEUDO_H
+
+#include <stdint.h>
+
+#define MAX_EXPANSION 32        // longest expansion (mul by 0xFFFF)
+#define EXPANSION_LINE_LEN 256
+#define MAX_PSEUDO_ARGS 3
+
+/* A pseudo-instruction is described declaratively:
+
+   OPERANDS has one character per argument: 'r' for a register, 'l' for a
+   label and 'i' for a 32-bit immediate. Immediates are parsed exactly once,
+   before SIZE is called.
+
+   SIZE returns the number of real instructions the expansion takes for the
+   given immediates, or 0 if the operands are invalid. The same value is used
+   by pass one to advance the byte offset, so sizes can never disagree with
+   what was written.
+
+   TEMPLATES[n - 1] is the expansion used when SIZE returns n. Lines are
+   separated by '\n'. "%N" is replaced by argument N as written, "%vN" by the
+   value of immediate N, and "%hN" / "%lN" by its upper / lower 16 bits.
+
+   EXPAND may be given instead of TEMPLATES for expansions whose shape depends
+   on the value of an immediate. It returns 0 on success and -1 on error.
+ */
+typedef struct Expansion Expansion;
+
+typedef struct {
+    const char* name;
+    const char* operands;
+    unsigned (*size)(const long int* imms);
+    const char* templates[2];
+    int (*expand)(Expansion* exp, char** args, const long int* imms);
+} PseudoInst;
+
+struct Expansion {
+    char lines[MAX_EXPANSION][EXPANSION_LINE_LEN];
+    unsigned len;
+};
+
+/* Returns the table entry for NAME, or NULL if NAME is not a pseudo-instruction. */
+const PseudoInst* find_pseudo(const char* name);
+
+/* Expands PSEUDO with the given arguments into EXP. Returns the number of
+   instructions in the expansion, or 0 if the arguments are invalid.
+ */
+unsigned expand_pseudo(Expansion* exp, const PseudoInst* pseudo, char** args,
+    int num_args);
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "ir.h"
+#include "relax.h"
+
+#define NO_TARGET UINT32_MAX
+
+static int is_branch(const Inst* inst) {
+    return inst->num_args == 3
+        && (strcmp(inst->name, "beq") == 0 || strcmp(inst->name, "bne") == 0);
+}
+
+/* Returns the symbol table index of the label of every beq/bne of PROGRAM,
+   or NO_TARGET for other instructions and for branches to labels that are
+   not in the text, which pass two reports. With DELAY_SLOTS, a branch
+   without a delay slot after it, or in the delay slot of another, is left
+   alone too.
+ */
+static uint32_t* find_targets(Program* program, SymbolTable* symtbl, int delay_slots) {
+    uint32_t num_buckets = 16;
+    while (num_buckets < 2 * symtbl->len) {
+        num_buckets *= 2;
+    }
+    uint32_t* buckets = malloc(sizeof(uint32_t) * num_buckets);
+    uint32_t* targets = malloc(sizeof(uint32_t) * program->len);
+    if (!buckets || !targets) {
+        allocation_failed();
+    }
+    memset(buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+    for (uint32_t i = 0; i < symtbl->len; i++) {
+        uint32_t b = hash_name(symtbl->tbl[i].name) & (num_buckets - 1);
+        while (buckets[b] != NO_TARGET) {
+            b = (b + 1) & (num_buckets - 1);
+        }
+        buckets[b] = i;
+    }
+
+    for (uint32_t i = 0; i < program->len; i++) {
+        Inst* inst = &program->insts[i];
+        targets[i] = NO_TARGET;
+        if (!inst->name || !is_branch(inst)) {
+            continue;
+        }
+        if (delay_slots && (i + 1 == program->len
+            || (i > 0 && program->insts[i - 1].name
+                && is_block_end(&program->insts[i - 1])))) {
+            continue;
+        }
+        uint32_t b = hash_name(inst->args[2]) & (num_buckets - 1);
+        for (; buckets[b] != NO_TARGET; b = (b + 1) & (num_buckets - 1)) {
+            Symbol* symbol = &symtbl->tbl[buckets[b]];
+            if (strcmp(symbol->name, inst->args[2]) == 0) {
+                if (symbol->addr <= 4 * program->len) {
+                    targets[i] = buckets[b];
+                }
+                break;
+            }
+        }
+    }
+    free(buckets);
+    return targets;
+}
+
+/* Returns the symbol table index of a label for instruction I of PROGRAM,
+   adding one if it has none. I == PROGRAM->len is the end of the program.
+ */
+static uint32_t inst_label(Program* program, SymbolTable* symtbl, uint32_t i) {
+    if (i == program->len) {
+        if (program->num_end_labels == 0) {
+            add_end_label(program, new_local_label(program, symtbl));
+        }
+        return program->end_labels[0];
+    }
+    Inst* inst = &program->insts[i];
+    if (inst->num_labels == 0) {
+        add_label(inst, new_local_label(program, symtbl));
+    }
+    return inst->labels[0];
+}
+
+/* The rewritten branches are counted in a Fenwick tree over the
+   instruction indices, so the new address of an instruction is found in
+   O(log n) without walking the program. Marks a branch whose code grows
+   after instruction I.
+ */
+static void add_growth(uint32_t* tree, uint32_t len, uint32_t i) {
+    for (i++; i <= len; i += i & -i) {
+        tree[i]++;
+    }
+}
+
+/* Returns the address, in words, of instruction I given the growth in TREE.
+   STEP is the number of words each rewrite adds.
+ */
+static uint32_t new_addr(const uint32_t* tree, uint32_t i, uint32_t step) {
+    uint32_t grown = 0;
+    for (uint32_t j = i; j > 0; j -= j & -j) {
+        grown += tree[j];
+    }
+    return i + step * grown;
+}
+
+uint32_t relax_branches(Program* program, SymbolTable* symtbl, int delay_slots) {
+    uint32_t len = program->len;
+    if (len <= BRANCH_RANGE) {
+        return 0;
+    }
+    update_symbols(program, symtbl);
+    uint32_t* targets = find_targets(program, symtbl, delay_slots);
+    uint8_t* relaxed = calloc(len, 1);
+    uint32_t* tree = calloc(len + 1, sizeof(uint32_t));
+    uint32_t* pending = malloc(sizeof(uint32_t) * len);
+    if (!relaxed || !tree || !pending) {
+        allocation_failed();
+    }
+    uint32_t num_pending = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (targets[i] != NO_TARGET) {
+            pending[num_pending++] = i;
+        }
+    }
+
+    /* A rewritten branch grows by its j, which goes after its delay slot
+       with a nop of its own. Branches only ever grow, so each round only
+       looks at the branches still in their short form, and this stops once
+       all of them are in range.
+     */
+    uint32_t step = delay_slots ? 2 : 1;
+    uint32_t num_relaxed = 0, grown = 1;
+    while (grown) {
+        grown = 0;
+        uint32_t kept = 0;
+        for (uint32_t k = 0; k < num_pending; k++) {
+            uint32_t i = pending[k];
+            int64_t offset = (int64_t) new_addr(tree, symtbl->tbl[targets[i]].addr / 4, step)
+                - new_addr(tree, i, step) - 1;
+            if (offset < INT16_MIN || offset > INT16_MAX) {
+                relaxed[i] = 1;
+                add_growth(tree, len, delay_slots ? i + 1 : i);
+                num_relaxed++;
+                grown++;
+            } else {
+                pending[kept++] = i;
+            }
+        }
+        num_pending = kept;
+    }
+    free(tree);
+    free(pending);
+
+    if (num_relaxed > 0) {
+        /* Add the labels before any instruction is moved, since adding a
+           label reallocates its array.
+         */
+        uint32_t* skips = malloc(sizeof(uint32_t) * len);
+        if (skips == NULL) {
+            allocation_failed();
+        }
+        for (uint32_t i = 0; i < len; i++) {
+            if (relaxed[i]) {
+                skips[i] = inst_label(program, symtbl, i + (delay_slots ? 2 : 1));
+            }
+        }
+
+        uint32_t new_len = len + step * num_relaxed;
+        Inst* insts = malloc(sizeof(Inst) * new_len);
+        if (insts == NULL) {
+            allocation_failed();
+        }
+        uint32_t out = 0, pending = NO_TARGET;
+        for (uint32_t i = 0; i < len; i++) {
+            Inst* inst = &insts[out++];
+            *inst = program->insts[i];
+            uint32_t jump = NO_TARGET;
+            if (relaxed[i]) {
+                char* args[] = { inst->args[0], inst->args[1], symtbl->tbl[skips[i]].name };
+                jump = targets[i];
+                set_inst(inst, strcmp(inst->name, "beq") == 0 ? "bne" : "beq", args, 3);
+                if (delay_slots) {
+                    pending = jump;
+                    continue;
+                }
+            } else if (pending != NO_TARGET) {
+                jump = pending;
+                pending = NO_TARGET;
+            }
+            if (jump != NO_TARGET) {
+                char* label = symtbl->tbl[jump].name;
+                init_inst(&insts[out++], "j", &label, 1);
+                if (delay_slots) {
+                    init_inst(&insts[out++], "sll", (char*[]){ "$0", "$0", "0" }, 3);
+                }
+            }
+        }
+        replace_insts(program, insts, out, new_len);
+        free(skips);
+    }
+    free(targets);
+    free(relaxed);
+    return num_relaxed;
+}
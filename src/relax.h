@@ -0,0 +1,26 @@
+#ifndef RELAX_H
+#define RELAX_H
+
+#include <stdint.h>
+
+/* A program of at most this many instructions has every beq/bne in range. */
+#define BRANCH_RANGE 32768
+
+/* Rewrites every beq/bne of PROGRAM whose label is too far away for its
+   16-bit offset into the inverted branch around a j to the label:
+
+       beq $s $t far        bne $s $t .L1
+                      ->    j far
+                            .L1:
+
+   If DELAY_SLOTS is set, the instruction after each branch is its delay
+   slot and stays there, and the j is followed by a nop. Every rewrite moves
+   the code after it, which can take more branches out of range, so the
+   addresses are recomputed until no branch changes, and each branch keeps
+   its short form unless it has to grow. Local labels from new_local_label()
+   are added to SYMTBL for the instructions after the jumps where needed;
+   call update_symbols() afterwards. Returns the number of branches rewritten.
+ */
+uint32_t relax_branches(Program* program, SymbolTable* symtbl, int delay_slots);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "memstat.h"
+
+const int RELOC_JUMP26 = 0;
+const int RELOC_HI16 = 1;
+const int RELOC_LO16 = 2;
+
+#define EMPTY_BUCKET UINT32_MAX
+
+static void rehash(RelocTable* table, uint32_t num_buckets) {
+    arena_free(table->arena, table->buckets);
+    table->buckets = arena_alloc(table->arena, sizeof(uint32_t) * num_buckets);
+    mem_count(MEM_RELOCS, sizeof(uint32_t) * table->num_buckets,
+        sizeof(uint32_t) * num_buckets);
+    memset(table->buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+    table->num_buckets = num_buckets;
+
+    for (uint32_t i = 0; i < table->num_names; i++) {
+        uint32_t b = hash_name(table->names[i]) & (num_buckets - 1);
+        while (table->buckets[b] != EMPTY_BUCKET) {
+            b = (b + 1) & (num_buckets - 1);
+        }
+        table->buckets[b] = i;
+    }
+}
+
+RelocTable* create_reloc_table() {
+    return create_reloc_table_in(NULL);
+}
+
+RelocTable* create_reloc_table_in(Arena* arena) {
+    RelocTable* table = arena_alloc(arena, sizeof(RelocTable));
+    table->arena = arena;
+    table->cap = 16;
+    table->entries = arena_alloc(arena, sizeof(Relocation) * table->cap);
+    table->names_cap = 16;
+    table->names = arena_alloc(arena, sizeof(char*) * table->names_cap);
+    table->len = 0;
+    table->num_names = 0;
+    table->buckets = NULL;
+    table->num_buckets = 0;
+    mem_count(MEM_RELOCS, 0, sizeof(RelocTable));
+    mem_count(MEM_RELOCS, 0, sizeof(Relocation) * table->cap);
+    mem_count(MEM_RELOCS, 0, sizeof(char*) * table->names_cap);
+    mem_unused(MEM_RELOCS, sizeof(Relocation) * table->cap + sizeof(char*) * table->names_cap);
+    rehash(table, 32);
+    return table;
+}
+
+void free_reloc_table(RelocTable* table) {
+    if (is_mem_report_enabled()) {
+        for (uint32_t i = 0; i < table->num_names; i++) {
+            mem_count(MEM_NAMES, strlen(table->names[i]) + 1, 0);
+        }
+        mem_count(MEM_RELOCS, sizeof(RelocTable) + sizeof(Relocation) * table->cap
+            + sizeof(char*) * table->names_cap + sizeof(uint32_t) * table->num_buckets, 0);
+        mem_unused(MEM_RELOCS, -(int64_t) (sizeof(Relocation) * (table->cap - table->len)
+            + sizeof(char*) * (table->names_cap - table->num_names)));
+    }
+    if (table->arena) {
+        return;
+    }
+    for (uint32_t i = 0; i < table->num_names; i++) {
+        free(table->names[i]);
+    }
+    free(table->names);
+    free(table->entries);
+    free(table->buckets);
+    free(table);
+}
+
+uint32_t intern_symbol(RelocTable* table, const char* name) {
+    uint32_t mask = table->num_buckets - 1;
+    uint32_t b = hash_name(name) & mask;
+    while (table->buckets[b] != EMPTY_BUCKET) {
+        if (strcmp(table->names[table->buckets[b]], name) == 0) {
+            return table->buckets[b];
+        }
+        b = (b + 1) & mask;
+    }
+
+    if (table->num_names == table->names_cap) {
+        if (table->names_cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        table->names = arena_realloc(table->arena, table->names,
+            sizeof(char*) * table->names_cap, sizeof(char*) * 2 * table->names_cap);
+        mem_count(MEM_RELOCS, sizeof(char*) * table->names_cap,
+            sizeof(char*) * 2 * table->names_cap);
+        mem_unused(MEM_RELOCS, sizeof(char*) * table->names_cap);
+        table->names_cap *= 2;
+    }
+    uint32_t id = table->num_names++;
+    table->names[id] = arena_strdup(table->arena, name);
+    mem_count(MEM_NAMES, 0, strlen(name) + 1);
+    mem_unused(MEM_RELOCS, -(int64_t) sizeof(char*));
+    table->buckets[b] = id;
+
+    /* Keep the load factor at or below one half. */
+    if (2 * table->num_names > table->num_buckets) {
+        rehash(table, 2 * table->num_buckets);
+    }
+    return id;
+}
+
+int add_relocation(RelocTable* table, const char* name, uint32_t offset, int type) {
+    if (offset % 4 != 0) {
+        addr_alignment_incorrect();
+        return -1;
+    }
+    return add_relocation_for(table, intern_symbol(table, name), offset, type);
+}
+
+int add_relocation_for(RelocTable* table, uint32_t symbol, uint32_t offset, int type) {
+    if (offset % 4 != 0) {
+        addr_alignment_incorrect();
+        return -1;
+    }
+    if (table->len == table->cap) {
+        if (table->cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        table->entries = arena_realloc(table->arena, table->entries,
+            sizeof(Relocation) * table->cap, sizeof(Relocation) * 2 * table->cap);
+        mem_count(MEM_RELOCS, sizeof(Relocation) * table->cap,
+            sizeof(Relocation) * 2 * table->cap);
+        mem_unused(MEM_RELOCS, sizeof(Relocation) * table->cap);
+        table->cap *= 2;
+    }
+    mem_unused(MEM_RELOCS, -(int64_t) sizeof(Relocation));
+    Relocation* reloc = &table->entries[table->len++];
+    reloc->offset = offset;
+    reloc->symbol = symbol;
+    reloc->type = type;
+    return 0;
+}
+
+const char* reloc_symbol(const RelocTable* table, const Relocation* reloc) {
+    return table->names[reloc->symbol];
+}
+
+void write_relocations(const RelocTable* table, FILE* output) {
+    for (uint32_t i = 0; i < table->len; i++) {
+        const Relocation* reloc = &table->entries[i];
+        if (is_local_label(table->names[reloc->symbol])) {
+            continue;
+        }
+        const char* suffix = reloc->type == RELOC_HI16 ? "@hi"
+            : reloc->type == RELOC_LO16 ? "@lo" : "";
+        fprintf(output, "%u\t%s%s\n", reloc->offset, table->names[reloc->symbol], suffix);
+    }
+}
+
+int read_relocation(RelocTable* table, char* name, uint32_t offset) {
+    char* at = strrchr(name, '@');
+    int type = RELOC_JUMP26;
+    if (at && strcmp(at, "@hi") == 0) {
+        type = RELOC_HI16;
+        *at = '\0';
+    } else if (at && strcmp(at, "@lo") == 0) {
+        type = RELOC_LO16;
+        *at = '\0';
+    }
+    return add_relocation(table, name, offset, type);
+}
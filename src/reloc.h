@@ -0,0 +1,79 @@
+#ifndef RELOC_H
+#define RELOC_H
+
+#include <stdint.h>
+
+#include "arena.h"
+
+extern const int RELOC_JUMP26;   // 26-bit target field of a j/jal
+extern const int RELOC_HI16;     // imm field holding the upper half of an address
+extern const int RELOC_LO16;     // imm field holding the lower half of an address
+
+/* One site that needs the address of a symbol. OFFSET is the byte offset of
+   the instruction and SYMBOL an index into the table's interned names.
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t symbol;
+    int type;
+} Relocation;
+
+/* An append-only list of relocations. Each symbol name is stored once in
+   NAMES and found through a hash table of indices into NAMES (BUCKETS, with
+   UINT32_MAX marking an empty bucket), so adding a relocation takes
+   constant time however many there are.
+ */
+typedef struct {
+    Relocation* entries;
+    uint32_t len;
+    uint32_t cap;
+    char** names;
+    uint32_t num_names;
+    uint32_t names_cap;
+    uint32_t* buckets;
+    uint32_t num_buckets;
+    Arena* arena;
+} RelocTable;
+
+RelocTable* create_reloc_table();
+
+/* Creates a RelocTable whose memory all comes from ARENA. Such a table is
+   released with the arena, and free_reloc_table() does nothing for it.
+ */
+RelocTable* create_reloc_table_in(Arena* arena);
+
+void free_reloc_table(RelocTable* table);
+
+/* Returns the index of NAME in the interned names of TABLE, adding a copy
+   of it if it is not there yet.
+ */
+uint32_t intern_symbol(RelocTable* table, const char* name);
+
+/* Appends a relocation of TYPE for the symbol NAME at byte offset OFFSET.
+   If OFFSET is not word-aligned, calls addr_alignment_incorrect() and
+   returns -1. Otherwise returns 0.
+ */
+int add_relocation(RelocTable* table, const char* name, uint32_t offset, int type);
+
+/* Appends a relocation as add_relocation() does, for the symbol with index
+   SYMBOL in the interned names of TABLE.
+ */
+int add_relocation_for(RelocTable* table, uint32_t symbol, uint32_t offset, int type);
+
+/* Returns the name of the symbol RELOC refers to. */
+const char* reloc_symbol(const RelocTable* table, const Relocation* reloc);
+
+/* Writes TABLE to OUTPUT in the format of write_table(), in the order the
+   relocations were added. The name of a RELOC_HI16 or RELOC_LO16 entry has
+   an @hi or @lo suffix, as in the la expansion. Relocations against local
+   labels are skipped, since pass two fills in their fields itself.
+ */
+void write_relocations(const RelocTable* table, FILE* output);
+
+/* Appends the relocation at OFFSET written as NAME by write_relocations(),
+   taking its type from the suffix. NAME is truncated at the suffix. Returns
+   0 on success and -1 on error, as add_relocation() does.
+ */
+int read_relocation(RelocTable* table, char* name, uint32_t offset);
+
+#endif
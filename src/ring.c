@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#include "tables.h"
+#include "ring.h"
+
+/* Number of times to poll before giving up the processor. */
+#define RING_SPINS 64
+
+Ring* create_ring(uint32_t cap) {
+    Ring* ring = malloc(sizeof(Ring));
+    if (ring == NULL) {
+        allocation_failed();
+    }
+    ring->cap = 1;
+    while (ring->cap < cap) {
+        ring->cap *= 2;
+    }
+    ring->slots = malloc(sizeof(void*) * ring->cap);
+    if (ring->slots == NULL) {
+        allocation_failed();
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    return ring;
+}
+
+void free_ring(Ring* ring) {
+    free(ring->slots);
+    free(ring);
+}
+
+static void backoff(int* spins) {
+    if (++*spins >= RING_SPINS) {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+void ring_push(Ring* ring, void* item) {
+    uint32_t tail = ring->tail;
+    int spins = 0;
+    while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->cap) {
+        backoff(&spins);
+    }
+    ring->slots[tail & (ring->cap - 1)] = item;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void* ring_pop(Ring* ring) {
+    uint32_t head = ring->head;
+    int spins = 0;
+    while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+        backoff(&spins);
+    }
+    void* item = ring->slots[head & (ring->cap - 1)];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
@@ -0,0 +1,35 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#define RING_CACHE_LINE 64
+
+/* A bounded single-producer/single-consumer queue of pointers. Exactly one
+   thread may push and exactly one other thread may pop. HEAD is only written
+   by the consumer and TAIL only by the producer, each on its own cache line,
+   and they are published with acquire/release atomics, so no lock is taken.
+   CAP is a power of two; HEAD and TAIL count up and wrap naturally.
+ */
+typedef struct {
+    void** slots;
+    uint32_t cap;
+    char pad0[RING_CACHE_LINE];
+    uint32_t head;
+    char pad1[RING_CACHE_LINE];
+    uint32_t tail;
+    char pad2[RING_CACHE_LINE];
+} Ring;
+
+/* Creates a ring holding at least CAP entries. */
+Ring* create_ring(uint32_t cap);
+
+void free_ring(Ring* ring);
+
+/* Appends ITEM, waiting while the ring is full. */
+void ring_push(Ring* ring, void* item);
+
+/* Removes and returns the oldest item, waiting while the ring is empty. */
+void* ring_pop(Ring* ring);
+
+#endif
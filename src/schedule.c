@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "ir.h"
+#include "schedule.h"
+
+/*******************************
+ * Helper Functions
+ *******************************/
+
+/* Returns 1 if INST is followed by a delay slot on the target. */
+static int has_delay_slot(const Inst* inst) {
+    return is_block_end(inst) || strcmp(inst->name, "jal") == 0;
+}
+
+static int is_mem(const Inst* inst) {
+    return is_load(inst) || is_store(inst);
+}
+
+/* Returns 1 if A and B can be swapped: neither reads or writes a register
+   the other writes, and they are not two memory accesses one of which is a
+   store.
+ */
+static int independent(const Inst* a, const Inst* b) {
+    uint32_t def_a, use_a, def_b, use_b;
+    inst_regs(a, &def_a, &use_a);
+    inst_regs(b, &def_b, &use_b);
+    if ((def_a & (def_b | use_b)) || (use_a & def_b)) {
+        return 0;
+    }
+    if (is_mem(a) && is_mem(b) && (is_store(a) || is_store(b))) {
+        return 0;
+    }
+    return 1;
+}
+
+/* Returns 1 if INST reads the register loaded by LOAD. */
+static int uses_load(const Inst* load, const Inst* inst) {
+    uint32_t load_def, load_use, def, use;
+    inst_regs(load, &load_def, &load_use);
+    inst_regs(inst, &def, &use);
+    return (load_def & use) != 0;
+}
+
+/* Returns 1 if BODY[FROM] can be moved to just before BODY[TO], past every
+   instruction in between.
+ */
+static int can_move_up(Inst** body, uint32_t to, uint32_t from) {
+    for (uint32_t k = to; k < from; k++) {
+        if (!independent(body[from], body[k])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void move_inst(Inst** body, uint32_t to, uint32_t from) {
+    Inst* inst = body[from];
+    if (from > to) {
+        memmove(body + to + 1, body + to, sizeof(Inst*) * (from - to));
+    } else {
+        memmove(body + from, body + from + 1, sizeof(Inst*) * (to - from));
+    }
+    body[to] = inst;
+}
+
+/* Separates every load in BODY from the first instruction that uses its
+   result. An independent instruction from later in the body is moved in
+   between if there is one, otherwise a nop is inserted. NEXT is the
+   instruction that follows the body (the branch ending the block, or the
+   first instruction of the next block), or NULL.
+
+   Returns the new length of BODY, which must have room for one nop per load.
+ */
+static uint32_t schedule_loads(Inst** body, uint32_t len, const Inst* next, Inst* nops,
+    uint32_t* num_nops) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (!is_load(body[i])) {
+            continue;
+        }
+        const Inst* user = i + 1 < len ? body[i + 1] : next;
+        if (user == NULL || !uses_load(body[i], user)) {
+            continue;
+        }
+
+        uint32_t j;
+        for (j = i + 2; j < len; j++) {
+            if (!uses_load(body[i], body[j]) && can_move_up(body, i + 1, j)) {
+                break;
+            }
+        }
+        if (j < len) {
+            move_inst(body, i + 1, j);
+            continue;
+        }
+
+        Inst* nop = &nops[(*num_nops)++];
+        init_inst(nop, "sll", (char*[]){ "$0", "$0", "0" }, 3);
+        memmove(body + i + 2, body + i + 1, sizeof(Inst*) * (len - i - 1));
+        body[i + 1] = nop;
+        len++;
+        i++;
+    }
+    return len;
+}
+
+/* Finds an instruction in BODY that can be moved into the delay slot of
+   BRANCH. It must be independent of the branch and of every instruction
+   after it, must not carry a label, must not be a load, and removing it must
+   not put a load right before a user of its result. Returns its index, or
+   LEN if there is none.
+ */
+static uint32_t find_delay_slot(Inst** body, uint32_t len, const Inst* branch) {
+    for (uint32_t c = len; c-- > 0; ) {
+        Inst* cand = body[c];
+        if (cand->num_labels > 0 || is_load(cand) || !independent(cand, branch)) {
+            continue;
+        }
+        uint32_t k;
+        for (k = c + 1; k < len && independent(cand, body[k]); k++);
+        if (k < len) {
+            continue;
+        }
+        const Inst* after = c + 1 < len ? body[c + 1] : branch;
+        if (c > 0 && is_load(body[c - 1]) && uses_load(body[c - 1], after)) {
+            continue;
+        }
+        return c;
+    }
+    return len;
+}
+
+/*******************************
+ * Scheduler
+ *******************************/
+
+/* Reorders the instructions of each basic block of PROGRAM for a 5-stage
+   MIPS pipeline. The input is assumed to be written without delay slots.
+
+    1. A load is separated from the first instruction that uses the loaded
+       register by moving an independent instruction from later in the block
+       in between, or by inserting a nop.
+    2. The delay slot after every beq, bne, j, jal and jr is filled with an
+       independent instruction from earlier in the block, or with a nop.
+
+   Register dependences come from inst_regs(). Loads and stores are never
+   reordered with stores. Instructions with labels are never moved, so every
+   label still starts its block.
+
+   The result only runs correctly on a machine with delay slots, which is
+   why pass two marks the output with .set noreorder and the simulator and
+   cost report follow it.
+
+   Returns the number of nops inserted.
+ */
+int schedule_program(Program* program) {
+    uint32_t cap = 2 * program->len + 1, len = 0, num_nops = 0;
+    Inst* out = malloc(sizeof(Inst) * cap);
+    Inst* nops = malloc(sizeof(Inst) * cap);
+    Inst** body = malloc(sizeof(Inst*) * cap);
+    if (out == NULL || nops == NULL || body == NULL) {
+        allocation_failed();
+    }
+
+    uint32_t start = 0;
+    while (start < program->len) {
+        uint32_t end = start + 1;
+        while (end < program->len && !has_delay_slot(&program->insts[end - 1])
+            && program->insts[end].num_labels == 0) {
+            end++;
+        }
+
+        Inst* branch = NULL;
+        uint32_t body_len = 0;
+        for (uint32_t i = start; i < end; i++) {
+            body[body_len++] = &program->insts[i];
+        }
+        if (has_delay_slot(body[body_len - 1])) {
+            branch = body[--body_len];
+        }
+
+        const Inst* next = branch;
+        if (!next && end < program->len) {
+            next = &program->insts[end];
+        }
+        body_len = schedule_loads(body, body_len, next, nops, &num_nops);
+
+        Inst* slot = NULL;
+        if (branch) {
+            uint32_t c = find_delay_slot(body, body_len, branch);
+            if (c < body_len) {
+                slot = body[c];
+                move_inst(body, body_len - 1, c);
+                body_len--;
+            } else {
+                slot = &nops[num_nops++];
+                init_inst(slot, "sll", (char*[]){ "$0", "$0", "0" }, 3);
+            }
+        }
+
+        for (uint32_t i = 0; i < body_len; i++) {
+            out[len++] = *body[i];
+        }
+        if (branch) {
+            out[len++] = *branch;
+            out[len++] = *slot;
+        }
+        start = end;
+    }
+
+    free(nops);
+    free(body);
+    replace_insts(program, out, len, cap);
+    return num_nops;
+}
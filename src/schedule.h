@@ -0,0 +1,10 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+/* Schedules PROGRAM for a pipeline with branch delay slots and a one cycle
+   load-use delay. See schedule.c for details. Returns the number of nops
+   that had to be inserted.
+ */
+int schedule_program(Program* program);
+
+#endif
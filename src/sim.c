@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "decode.h"
+#include "sim.h"
+
+/* A pre-decoded instruction. HANDLER is the address of the code that
+   executes it in run_machine(). D is the register written (32 instead of $0
+   so that $0 stays zero), S and T the registers read, and TARGET the index
+   of the instruction a branch or jump goes to.
+ */
+typedef struct {
+    const void* handler;
+    uint32_t d;
+    uint32_t s;
+    uint32_t t;
+    int32_t imm;
+    uint32_t target;
+} Record;
+
+/*******************************
+ * Machine
+ *******************************/
+
+Machine* create_machine(const uint32_t* text, uint32_t text_len, uint32_t data_size,
+    uint32_t stack_size) {
+    Machine* m = calloc(1, sizeof(Machine));
+    if (m == NULL) {
+        allocation_failed();
+    }
+    m->text = text;
+    m->text_len = text_len;
+    m->data_size = data_size;
+    m->stack_size = stack_size;
+    m->data = calloc(data_size, 1);
+    m->stack = calloc(stack_size, 1);
+    m->counts = calloc(text_len + 2, sizeof(uint64_t));
+    m->taken = calloc(text_len + 2, sizeof(uint64_t));
+    if (!m->data || !m->stack || !m->counts || !m->taken) {
+        allocation_failed();
+    }
+    m->regs[29] = STACK_TOP;
+    m->regs[31] = 4 * text_len;
+    return m;
+}
+
+void free_machine(Machine* m) {
+    free(m->data);
+    free(m->stack);
+    free(m->counts);
+    free(m->taken);
+    free(m);
+}
+
+/* Returns a pointer to the SIZE bytes of simulated memory at ADDR, or NULL if
+   they are not all in the data segment or the stack.
+ */
+static inline uint8_t* mem_at(Machine* m, uint32_t addr, uint32_t size) {
+    if (addr - DATA_BASE <= m->data_size - size) {
+        return m->data + (addr - DATA_BASE);
+    }
+    uint32_t stack_base = STACK_TOP - m->stack_size;
+    if (addr - stack_base <= m->stack_size - size) {
+        return m->stack + (addr - stack_base);
+    }
+    return NULL;
+}
+
+static inline uint32_t load_word(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void store_word(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+/* Decodes the instruction at index I into REC, using HANDLERS to find the
+   code for each operation.
+ */
+static void predecode(Record* rec, uint32_t word, uint32_t i, uint32_t len,
+    const void* const* handlers) {
+    DecodedInst inst;
+    if (decode_inst(word, &inst) == -1) {
+        inst.op = OP_INVALID;
+    }
+    rec->handler = handlers[inst.op];
+    rec->s = inst.rs;
+    rec->t = inst.rt;
+    rec->imm = inst.imm;
+    rec->target = len + 1;
+
+    switch (inst.op) {
+        case OP_ADDU: case OP_OR: case OP_SLT: case OP_SLTU:
+            rec->d = inst.rd;
+            break;
+        case OP_SLL:
+            rec->d = inst.rd;
+            rec->imm = inst.shamt;
+            break;
+        case OP_BEQ: case OP_BNE:
+            if ((int64_t) i + 1 + inst.imm >= 0 && i + 1 + inst.imm <= len) {
+                rec->target = i + 1 + inst.imm;
+            }
+            break;
+        case OP_J: case OP_JAL:
+            if (inst.target <= len) {
+                rec->target = inst.target;
+            }
+            break;
+        default:
+            rec->d = inst.rt;
+            break;
+    }
+    if (rec->d == 0) {
+        rec->d = 32;
+    }
+}
+
+/* Runs the machine with threaded code: every record holds the address of
+   its handler, and each handler ends by jumping straight to the handler of
+   the next record (computed goto), so there is no central dispatch switch.
+   NPC is the index of the instruction that runs after the one at PC, so that
+   a jump with a delay slot only has to set NPC.
+ */
+int run_machine(Machine* m) {
+    static const void* const HANDLERS[NUM_OPS] = {
+        [OP_INVALID] = &&op_invalid,
+        [OP_ADDU] = &&op_addu, [OP_OR] = &&op_or, [OP_SLT] = &&op_slt,
+        [OP_SLTU] = &&op_sltu, [OP_JR] = &&op_jr, [OP_SLL] = &&op_sll,
+        [OP_ADDIU] = &&op_addiu, [OP_ORI] = &&op_ori, [OP_LUI] = &&op_lui,
+        [OP_LB] = &&op_lb, [OP_LBU] = &&op_lbu, [OP_LW] = &&op_lw,
+        [OP_SB] = &&op_sb, [OP_SW] = &&op_sw,
+        [OP_BEQ] = &&op_beq, [OP_BNE] = &&op_bne,
+        [OP_J] = &&op_j, [OP_JAL] = &&op_jal,
+    };
+
+    uint32_t len = m->text_len;
+    Record* records = malloc(sizeof(Record) * (len + 2));
+    if (records == NULL) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        predecode(&records[i], m->text[i], i, len, HANDLERS);
+    }
+    records[len].handler = &&op_halt;
+    records[len + 1].handler = &&op_bad_target;
+
+    uint32_t* regs = m->regs;
+    uint64_t* counts = m->counts;
+    uint64_t executed = m->executed;
+    uint64_t limit = m->max_steps ? m->max_steps : UINT64_MAX;
+    uint32_t pc = m->pc / 4, npc = pc + 1, addr;
+    int delay_slots = m->delay_slots;
+    CacheSim* caches = m->caches;
+    const Record* r;
+    uint8_t* p;
+
+    m->fault = NULL;
+
+#define DISPATCH() do {                                 \
+        r = &records[pc];                               \
+        counts[pc]++;                                   \
+        executed++;                                     \
+        if (caches && pc < len) {                       \
+            cache_fetch(caches, pc);                    \
+        }                                               \
+        goto *r->handler;                               \
+    } while (0)
+#define NEXT() do { pc = npc++; DISPATCH(); } while (0)
+#define JUMP(index) do {                                \
+        if (delay_slots) {                              \
+            pc = npc;                                   \
+            npc = (index);                              \
+        } else {                                        \
+            pc = (index);                               \
+            npc = pc + 1;                               \
+        }                                               \
+        if (executed >= limit) {                        \
+            m->fault = "instruction limit reached";     \
+            goto done;                                  \
+        }                                               \
+        DISPATCH();                                     \
+    } while (0)
+#define FAULT(msg) do { m->fault = (msg); goto done; } while (0)
+#define ACCESS(addr) do {                               \
+        if (caches) {                                   \
+            cache_data(caches, pc, (addr));             \
+        }                                               \
+    } while (0)
+
+    if (pc > len) {
+        FAULT("start address outside of the text segment");
+    }
+    DISPATCH();
+
+op_addu:
+    regs[r->d] = regs[r->s] + regs[r->t];
+    NEXT();
+op_or:
+    regs[r->d] = regs[r->s] | regs[r->t];
+    NEXT();
+op_slt:
+    regs[r->d] = (int32_t) regs[r->s] < (int32_t) regs[r->t];
+    NEXT();
+op_sltu:
+    regs[r->d] = regs[r->s] < regs[r->t];
+    NEXT();
+op_sll:
+    regs[r->d] = regs[r->t] << r->imm;
+    NEXT();
+op_addiu:
+    regs[r->d] = regs[r->s] + r->imm;
+    NEXT();
+op_ori:
+    regs[r->d] = regs[r->s] | r->imm;
+    NEXT();
+op_lui:
+    regs[r->d] = (uint32_t) r->imm << 16;
+    NEXT();
+op_lb:
+    addr = regs[r->s] + r->imm;
+    if (!(p = mem_at(m, addr, 1))) {
+        FAULT("load from an unmapped address");
+    }
+    ACCESS(addr);
+    regs[r->d] = (int8_t) *p;
+    NEXT();
+op_lbu:
+    addr = regs[r->s] + r->imm;
+    if (!(p = mem_at(m, addr, 1))) {
+        FAULT("load from an unmapped address");
+    }
+    ACCESS(addr);
+    regs[r->d] = *p;
+    NEXT();
+op_lw:
+    addr = regs[r->s] + r->imm;
+    if ((addr & 3) || !(p = mem_at(m, addr, 4))) {
+        FAULT("unaligned or unmapped word load");
+    }
+    ACCESS(addr);
+    regs[r->d] = load_word(p);
+    NEXT();
+op_sb:
+    addr = regs[r->s] + r->imm;
+    if (!(p = mem_at(m, addr, 1))) {
+        FAULT("store to an unmapped address");
+    }
+    ACCESS(addr);
+    *p = regs[r->t];
+    NEXT();
+op_sw:
+    addr = regs[r->s] + r->imm;
+    if ((addr & 3) || !(p = mem_at(m, addr, 4))) {
+        FAULT("unaligned or unmapped word store");
+    }
+    ACCESS(addr);
+    store_word(p, regs[r->t]);
+    NEXT();
+op_beq:
+    if (regs[r->s] == regs[r->t]) {
+        m->taken[pc]++;
+        JUMP(r->target);
+    }
+    NEXT();
+op_bne:
+    if (regs[r->s] != regs[r->t]) {
+        m->taken[pc]++;
+        JUMP(r->target);
+    }
+    NEXT();
+op_j:
+    JUMP(r->target);
+op_jal:
+    regs[31] = 4 * (pc + 1 + delay_slots);
+    JUMP(r->target);
+op_jr:
+    addr = regs[r->s];
+    if ((addr & 3) || addr / 4 > len) {
+        FAULT("jump to an address outside of the text segment");
+    }
+    JUMP(addr / 4);
+op_invalid:
+    FAULT("invalid instruction");
+op_bad_target:
+    FAULT("branch to an address outside of the text segment");
+op_halt:
+    counts[pc]--;
+    executed--;
+
+done:
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef FAULT
+#undef ACCESS
+    m->pc = 4 * pc;
+    m->executed = executed;
+    regs[32] = 0;
+    free(records);
+    return m->fault ? -1 : 0;
+}
+
+/*******************************
+ * Profile
+ *******************************/
+
+static int compare_symbol_addrs(const void* a, const void* b) {
+    uint32_t x = (*(Symbol**) a)->addr, y = (*(Symbol**) b)->addr;
+    return (x > y) - (x < y);
+}
+
+/* Profile format, one line per executed instruction:
+
+       <address> <count>                   for most instructions
+       <address> <count> <taken> <ratio>   for beq and bne
+
+   Lines starting with '#' are comments; each label is written as a comment
+   before the first instruction it points to.
+ */
+void write_profile(Machine* m, SymbolTable* symbols, FILE* output) {
+    uint32_t num_symbols = symbols ? symbols->len : 0, next = 0;
+    Symbol** sorted = malloc(sizeof(Symbol*) * (num_symbols + 1));
+    if (sorted == NULL) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < num_symbols; i++) {
+        sorted[i] = &symbols->tbl[i];
+    }
+    qsort(sorted, num_symbols, sizeof(Symbol*), compare_symbol_addrs);
+
+    fprintf(output, "# %llu instructions executed\n", (unsigned long long) m->executed);
+    fprintf(output, "# address\tcount\ttaken\tratio\n");
+    for (uint32_t i = 0; i < m->text_len; i++) {
+        while (next < num_symbols && sorted[next]->addr <= 4 * i) {
+            fprintf(output, "# %s:\n", sorted[next++]->name);
+        }
+        if (m->counts[i] == 0) {
+            continue;
+        }
+        DecodedInst inst;
+        fprintf(output, "%u\t%llu", 4 * i, (unsigned long long) m->counts[i]);
+        if (decode_inst(m->text[i], &inst) == 0
+            && (inst.op == OP_BEQ || inst.op == OP_BNE)) {
+            fprintf(output, "\t%llu\t%.3f", (unsigned long long) m->taken[i],
+                (double) m->taken[i] / m->counts[i]);
+        }
+        fprintf(output, "\n");
+    }
+    free(sorted);
+}
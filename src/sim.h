@@ -0,0 +1,66 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#include "data.h"
+#include "cache.h"
+
+#define STACK_TOP 0x80000000u   // the stack grows down from here
+
+/* The state of a simulated MIPS machine running a linked object. The text
+   segment starts at address 0. Execution stops when control reaches the end
+   of the text segment, which is where $ra points initially, so a program can
+   finish by falling off its end or returning with jr $ra.
+
+   COUNTS[i] is the number of times the instruction at byte offset 4 * i was
+   executed, and TAKEN[i] how often it branched if it is a beq or bne.
+
+   If CACHES is not NULL, every instruction fetch and every load and store
+   is also run through it.
+
+   With DELAY_SLOTS set, the machine runs code scheduled for branch delay
+   slots: the instruction after a taken branch or a jump is executed before
+   control moves to the target, and jal links to the instruction after its
+   delay slot.
+ */
+typedef struct {
+    uint32_t regs[33];          // regs[32] absorbs writes to $0
+    uint32_t pc;
+    const uint32_t* text;
+    uint32_t text_len;
+    uint8_t* data;
+    uint32_t data_size;
+    uint8_t* stack;
+    uint32_t stack_size;
+    uint64_t* counts;
+    uint64_t* taken;
+    uint64_t executed;
+    uint64_t max_steps;         // 0 for no limit
+    CacheSim* caches;           // NULL to run without caches
+    int delay_slots;
+    const char* fault;          // why execution stopped early, or NULL
+} Machine;
+
+/* Creates a machine for the TEXT_LEN words of TEXT, with DATA_SIZE bytes of
+   data memory and STACK_SIZE bytes of stack. TEXT must stay valid while the
+   machine is in use.
+ */
+Machine* create_machine(const uint32_t* text, uint32_t text_len, uint32_t data_size,
+    uint32_t stack_size);
+
+void free_machine(Machine* m);
+
+/* Pre-decodes the text segment and runs it from address 0. Returns 0 if the
+   program ran to completion and -1 if it stopped because of a fault, in which
+   case M->fault describes the problem and M->pc is the faulting address.
+ */
+int run_machine(Machine* m);
+
+/* Writes the execution count of every instruction that ran, and for
+   branches the number of times they were taken, to OUTPUT. Addresses are
+   annotated with the label from SYMBOLS that contains them.
+ */
+void write_profile(Machine* m, SymbolTable* symbols, FILE* output);
+
+#endif
@@ -5,6 +5,8 @@
 
 #include "utils.h"
 #include "tables.h"
+#include "data.h"
+#include "memstat.h"
 
 const int SYMTBL_NON_UNIQUE = 0;
 const int SYMTBL_UNIQUE_NAME = 1;
@@ -30,6 +32,10 @@ void write_symbol(FILE* output, uint32_t addr, const char* name) {
     fprintf(output, "%u\t%s\n", addr, name);
 }
 
+int is_local_label(const char* name) {
+    return name[0] == '.' && name[1] == 'L';
+}
+
 /*******************************
  * Symbol Table Functions
  *******************************/
@@ -41,14 +47,24 @@ void write_symbol(FILE* output, uint32_t addr, const char* name) {
    to store this value for use during add_to_table().
  */
 SymbolTable* create_table(int mode) {
-    SymbolTable *t = malloc(sizeof(SymbolTable));
-    if (t == NULL) {
-      allocation_failed();
-    }
-    (*t).tbl = malloc(sizeof(Symbol) * 10);
+    return create_table_in(mode, NULL);
+}
+
+/* Creates a SymbolTable as create_table() does, but takes the table, its
+   entries and its names from ARENA. Such a table is released with the
+   arena, and free_table() only updates --mem-report counts for it. If ARENA is NULL, malloc()
+   is used instead.
+ */
+SymbolTable* create_table_in(int mode, Arena* arena) {
+    SymbolTable *t = arena_alloc(arena, sizeof(SymbolTable));
+    (*t).tbl = arena_alloc(arena, sizeof(Symbol) * 10);
     (*t).len = 0;
     (*t).cap = 10;
     (*t).mode = mode;
+    (*t).arena = arena;
+    mem_count(MEM_SYMBOLS, 0, sizeof(SymbolTable));
+    mem_count(MEM_SYMBOLS, 0, sizeof(Symbol) * 10);
+    mem_unused(MEM_SYMBOLS, sizeof(Symbol) * 10);
     return t;
 }
 
@@ -56,6 +72,17 @@ SymbolTable* create_table(int mode) {
 void free_table(SymbolTable* table) {
     Symbol *t = table->tbl;
     int i;
+    if (is_mem_report_enabled()) {
+        for (i = 0; i < table->len; i++) {
+            mem_count(MEM_NAMES, strlen(t[i].name) + 1, 0);
+        }
+        mem_count(MEM_SYMBOLS, sizeof(Symbol) * table->cap, 0);
+        mem_count(MEM_SYMBOLS, sizeof(SymbolTable), 0);
+        mem_unused(MEM_SYMBOLS, -(int64_t) sizeof(Symbol) * (table->cap - table->len));
+    }
+    if (table->arena) {
+        return;
+    }
     for (i = 0; i < table->len; i++) {
       free(t[i].name);
     }
@@ -71,41 +98,42 @@ void free_table(SymbolTable* table) {
    store the NAME pointer. You must store a copy of the given string.
 
    If ADDR is not word-aligned, you should call addr_alignment_incorrect() and
-   return -1. If the table's mode is SYMTBL_UNIQUE_NAME and NAME already exists 
+   return -1; labels of the data segment, from DATA_BASE up, may be at any
+   byte. If the table's mode is SYMTBL_UNIQUE_NAME and NAME already exists 
    in the table, you should call name_already_exists() and return -1. If memory
    allocation fails, you should call allocation_failed(). 
 
    Otherwise, you should store the symbol name and address and return 0.
  */
 int add_to_table(SymbolTable* table, const char* name, uint32_t addr) {
-    if ((addr % 4) != 0) {
+    if (addr < DATA_BASE && (addr % 4) != 0) {
         addr_alignment_incorrect();
         return -1;
     }
     if ((*table).len == (*table).cap) {
-        int r = (4 * (*table).cap) * (sizeof(Symbol));
-        table->tbl = realloc(table->tbl, r);
-        if (table->tbl == NULL) {
+        if (table->cap > UINT32_MAX / 2) {
             allocation_failed();
-            return -1;
         }
-        table->cap = table->cap * 4;
+        table->tbl = arena_realloc(table->arena, table->tbl,
+            table->cap * sizeof(Symbol), 2 * table->cap * sizeof(Symbol));
+        mem_count(MEM_SYMBOLS, table->cap * sizeof(Symbol), 2 * table->cap * sizeof(Symbol));
+        mem_unused(MEM_SYMBOLS, table->cap * sizeof(Symbol));
+        table->cap = table->cap * 2;
     }
     int i;
     Symbol* t = table->tbl;
-    for (i = 0; i < table->len; i++) {
-      if (strcmp(t[i].name, name) == 0 && table->mode) {
+    for (i = 0; table->mode && i < table->len; i++) {
+      if (strcmp(t[i].name, name) == 0) {
           name_already_exists(name);
           return -1;
       }
     }
-    Symbol *temp = malloc(sizeof(Symbol));
-    temp->name = malloc(sizeof(name)*4 + 1);
-    strcpy(temp->name, name);
-    temp->addr = addr;
+    i = table->len;
+    t[i].name = arena_strdup(table->arena, name);
+    t[i].addr = addr;
+    mem_count(MEM_NAMES, 0, strlen(name) + 1);
+    mem_unused(MEM_SYMBOLS, -(int64_t) sizeof(Symbol));
     (*table).len += 1;
-    t[i] = *temp;
-    free(temp);
     return 0;
   }
 
@@ -125,11 +153,35 @@ int64_t get_addr_for_symbol(SymbolTable* table, const char* name) {
 
 /* Writes the SymbolTable TABLE to OUTPUT. You should use write_symbol() to
    perform the write. Do not print any additional whitespace or characters.
+   Local labels are skipped.
  */
 void write_table(SymbolTable* table, FILE* output) {
     int i;
     Symbol* t = (*table).tbl;
     for (i = 0; i < (*table).len; i++) {
-      write_symbol(output, t[i].addr, t[i].name);
+      if (!is_local_label(t[i].name)) {
+        write_symbol(output, t[i].addr, t[i].name);
+      }
+    }
+}
+
+uint32_t* remove_symbols(SymbolTable* table, const uint8_t* keep) {
+    uint32_t* remap = malloc(sizeof(uint32_t) * (table->len + 1));
+    if (remap == NULL) {
+        allocation_failed();
+    }
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < table->len; i++) {
+        if (keep[i]) {
+            remap[i] = len;
+            table->tbl[len++] = table->tbl[i];
+        } else {
+            remap[i] = UINT32_MAX;
+            mem_count(MEM_NAMES, strlen(table->tbl[i].name) + 1, 0);
+            mem_unused(MEM_SYMBOLS, sizeof(Symbol));
+            arena_free(table->arena, table->tbl[i].name);
+        }
     }
+    table->len = len;
+    return remap;
 }
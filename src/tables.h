@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "arena.h"
+
 extern const int SYMTBL_NON_UNIQUE;      // allows duplicate names in table
 extern const int SYMTBL_UNIQUE_NAME;     // duplicate names not allowed
 
@@ -22,6 +24,7 @@ typedef struct {
     uint32_t len;
     uint32_t cap;
     int mode;
+    Arena* arena;
 } SymbolTable;
 
 /* Helper functions: */
@@ -34,9 +37,17 @@ void name_already_exists(const char* name);
 
 void write_symbol(FILE* output, uint32_t addr, const char* name);
 
+/* Returns 1 if NAME is a label the assembler made up (.L<n>), which no
+   source label can be, and which is left out of the output.
+ */
+int is_local_label(const char* name);
+
 /* IMPLEMENT ME - see documentation in tables.c */
 SymbolTable* create_table();
 
+/* Creates a SymbolTable whose memory all comes from ARENA. */
+SymbolTable* create_table_in(int mode, Arena* arena);
+
 /* IMPLEMENT ME - see documentation in tables.c */
 void free_table(SymbolTable* table);
 
@@ -49,4 +60,10 @@ int64_t get_addr_for_symbol(SymbolTable* table, const char* name);
 /* IMPLEMENT ME - see documentation in tables.c */
 void write_table(SymbolTable* table, FILE* output);
 
+/* Removes every symbol whose entry in KEEP is 0, keeping the rest in order.
+   Returns an array mapping each old index to its new one (UINT32_MAX for a
+   removed symbol), which the caller must free().
+ */
+uint32_t* remove_symbols(SymbolTable* table, const uint8_t* keep);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "trace.h"
+
+/* Events per chunk of a thread's buffer. */
+#define TRACE_CHUNK 4096
+
+typedef struct {
+    const char* name;
+    const char* detail;
+    uint64_t ns;
+    char phase;
+} TraceEvent;
+
+typedef struct TraceChunk {
+    TraceEvent events[TRACE_CHUNK];
+    uint32_t len;
+    struct TraceChunk* next;
+} TraceChunk;
+
+/* The events of one thread. Only that thread appends to them, so nothing is
+   locked; the buffer is published once, on the thread's first event, by
+   pushing it onto THREADS.
+ */
+typedef struct TraceThread {
+    uint32_t tid;
+    const char* name;
+    TraceChunk* head;
+    TraceChunk* tail;
+    struct TraceThread* next;
+} TraceThread;
+
+static int enabled = 0;
+static uint64_t start_ns;
+static uint32_t next_tid = 0;
+static TraceThread* threads = NULL;
+static __thread TraceThread* self = NULL;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void enable_trace() {
+    start_ns = now_ns();
+    enabled = 1;
+}
+
+int is_trace_enabled() {
+    return enabled;
+}
+
+static TraceChunk* create_chunk() {
+    TraceChunk* chunk = malloc(sizeof(TraceChunk));
+    if (chunk == NULL) {
+        allocation_failed();
+    }
+    chunk->len = 0;
+    chunk->next = NULL;
+    return chunk;
+}
+
+/* Returns the buffer of the calling thread, creating it on first use. */
+static TraceThread* current_thread() {
+    if (self) {
+        return self;
+    }
+    TraceThread* t = malloc(sizeof(TraceThread));
+    if (t == NULL) {
+        allocation_failed();
+    }
+    t->tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+    t->name = NULL;
+    t->head = t->tail = create_chunk();
+    t->next = __atomic_load_n(&threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&threads, &t->next, t, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    self = t;
+    return t;
+}
+
+static void record(char phase, const char* name, const char* detail) {
+    TraceThread* t = current_thread();
+    if (t->tail->len == TRACE_CHUNK) {
+        t->tail->next = create_chunk();
+        t->tail = t->tail->next;
+    }
+    TraceEvent* e = &t->tail->events[t->tail->len++];
+    e->name = name;
+    e->detail = detail;
+    e->phase = phase;
+    e->ns = now_ns();
+}
+
+void trace_thread_name(const char* name) {
+    if (enabled) {
+        current_thread()->name = name;
+    }
+}
+
+void trace_begin(const char* name, const char* detail) {
+    if (enabled) {
+        record('B', name, detail);
+    }
+}
+
+void trace_end(const char* name) {
+    if (enabled) {
+        record('E', name, NULL);
+    }
+}
+
+/* Writes STR as a JSON string. */
+static void write_json_string(FILE* output, const char* str) {
+    fputc('"', output);
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\') {
+            fprintf(output, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(output, "\\u%04x", c);
+        } else {
+            fputc(c, output);
+        }
+    }
+    fputc('"', output);
+}
+
+int write_trace(const char* path) {
+    FILE* output = fopen(path, "w");
+    if (!output) {
+        write_to_log("Error: unable to open trace file: %s\n", path);
+        return -1;
+    }
+    int pid = getpid();
+    const char* sep = "\n";
+    fprintf(output, "{\"traceEvents\":[");
+    for (TraceThread* t = __atomic_load_n(&threads, __ATOMIC_ACQUIRE); t; t = t->next) {
+        if (t->name) {
+            fprintf(output, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"tid\":%u,\"args\":{\"name\":", sep, pid, t->tid);
+            write_json_string(output, t->name);
+            fprintf(output, "}}");
+            sep = ",\n";
+        }
+        for (TraceChunk* chunk = t->head; chunk; chunk = chunk->next) {
+            for (uint32_t i = 0; i < chunk->len; i++) {
+                TraceEvent* e = &chunk->events[i];
+                uint64_t ns = e->ns - start_ns;
+                fprintf(output, "%s{\"name\":", sep);
+                write_json_string(output, e->name);
+                fprintf(output, ",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%u",
+                    e->phase, (unsigned long long) (ns / 1000), (unsigned) (ns % 1000),
+                    pid, t->tid);
+                if (e->detail) {
+                    fprintf(output, ",\"args\":{\"file\":");
+                    write_json_string(output, e->detail);
+                    fprintf(output, "}");
+                }
+                fprintf(output, "}");
+                sep = ",\n";
+            }
+        }
+    }
+    fprintf(output, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    if (fclose(output) != 0) {
+        write_to_log("Error: unable to write trace file: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
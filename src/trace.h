@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/* Turns event recording on. Until then the functions below, apart from
+   write_trace(), return at once.
+ */
+void enable_trace();
+
+int is_trace_enabled();
+
+/* Names the calling thread in the trace. NAME must be a string literal or
+   otherwise outlive the trace.
+ */
+void trace_thread_name(const char* name);
+
+/* Begins a span called NAME on the calling thread. DETAIL, which may be
+   NULL, is shown as the span's argument, such as the file it works on. Both
+   strings must outlive the trace. Spans on one thread must nest.
+ */
+void trace_begin(const char* name, const char* detail);
+
+/* Ends the span begun by the matching trace_begin() with NAME. */
+void trace_end(const char* name);
+
+/* Writes every recorded event to PATH in the Chrome trace-event JSON
+   format. Threads that recorded events must have finished or be idle.
+   Returns 0 on success and -1 if PATH could not be written.
+ */
+int write_trace(const char* path);
+
+#endif
@@ -3,73 +3,46 @@
 #include <stdlib.h>
 
 #include "tables.h"
+#include "reloc.h"
 #include "translate_utils.h"
+#include "pseudo.h"
 #include "translate.h"
 
-/* Writes instructions during the assembler's first pass to OUTPUT. The case
-   for general instructions has already been completed, but you need to write
-   code to translate the li and blt pseudoinstructions. Your pseudoinstruction 
-   expansions should not have any side effects.
+static int write_label_half(long int* output, const char* str, uint32_t addr,
+    SymbolTable* symtbl, RelocTable* reltbl);
+
+/* Writes instructions during the assembler's first pass to OUTPUT. Regular
+   instructions are written unchanged. Pseudoinstructions are looked up in the
+   table in pseudo.c, which checks their arguments and decides how they expand.
+   Pseudoinstruction expansions do not have any side effects.
 
    NAME is the name of the instruction, ARGS is an array of the arguments, and
    NUM_ARGS specifies the number of items in ARGS.
 
    Error checking for regular instructions are done in pass two. However, for
-   pseudoinstructions, you must make sure that ARGS contains the correct number
-   of arguments. You do NOT need to check whether the registers / label are 
-   valid, since that will be checked in part two.
-
-   Also for li:
-    - make sure that the number is representable by 32 bits. (Hint: the number 
-        can be both signed or unsigned).
-    - if the immediate can fit in the imm field of an addiu instruction, then
-        expand li into a single addiu instruction. Otherwise, expand it into 
-        a lui-ori pair.
-
-   And for blt:
-    - your expansion should use the fewest number of instructions possible.
+   pseudoinstructions, the argument count and any immediates are checked here.
+   Registers and labels are checked in pass two.
 
-   MARS has slightly different translation rules for li, and it allows numbers
-   larger than the largest 32 bit number to be loaded with li. You should follow
-   the above rules if MARS behaves differently.
-
-   Use fprintf() to write. If writing multiple instructions, make sure that 
-   each instruction is on a different line.
+   For li, a number that fits in the imm field of an addiu is expanded into a
+   single addiu instruction, otherwise into a lui-ori pair. Numbers must be
+   representable by 32 bits (signed or unsigned).
 
    Returns the number of instructions written (so 0 if there were any errors).
+   Pass one advances the byte offset by exactly this many instructions.
  */
 unsigned write_pass_one(FILE* output, const char* name, char** args, int num_args) {
-    if (strcmp(name, "li") == 0) {
-        if (num_args == 2) {
-          long int out1;
-          uint32_t num = translate_num(&out1, args[1], -2147483648, 4294967295);
-          if (num == -1) {
-            return 0;
-          }
-          long int out2;
-          uint32_t num2 = translate_num(&out2, args[1], -32767, 6553);
-          if (num2 != -1) {
-            fprintf(output, "addiu %s $0 %ld\n", args[0], out2);
-            return 1;
-          }
-          uint16_t upper =  (out1 & 0xFFFF0000) >> 16;
-          uint16_t lower =( out1 << 15) >> 15;
-          fprintf(output, "lui $at %d\n", upper);
-          fprintf(output, "ori %s $at %d\n", args[0], lower);
-          return 1;
-        }
-        return 0;
-    } else if (strcmp(name, "blt") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "slt $at %s %s\n", args[0], args[1]);
-          fprintf(output, "bne $at $0 %s\n", args[2]);
-          return 1;
-        }
-        return 0;
-    } else {
+    const PseudoInst* pseudo = find_pseudo(name);
+    if (!pseudo) {
         write_inst_string(output, name, args, num_args);
         return 1;
     }
+
+    Expansion exp;
+    unsigned size = expand_pseudo(&exp, pseudo, args, num_args);
+    for (unsigned i = 0; i < size; i++) {
+        fprintf(output, "%s\n", exp.lines[i]);
+    }
+    return size;
 }
 
 /* Writes the instruction in hexadecimal format to OUTPUT during pass #2.
@@ -93,7 +66,24 @@ unsigned write_pass_one(FILE* output, const char* name, char** args, int num_arg
    Returns 0 on success and -1 on error. 
  */
 int translate_inst(FILE* output, const char* name, char** args, size_t num_args, uint32_t addr,
-    SymbolTable* symtbl, SymbolTable* reltbl) {
+    SymbolTable* symtbl, RelocTable* reltbl) {
+
+    uint32_t instruction;
+    if (encode_inst(&instruction, name, args, num_args, addr, symtbl, reltbl) == -1) {
+      return -1;
+    }
+    write_inst_hex(output, instruction);
+    return 0;
+}
+
+/* Encodes the instruction into OUTPUT instead of writing it to a file. This
+   does the actual work for translate_inst(), and is used directly by callers
+   that keep the machine code in memory.
+
+   Returns 0 on success and -1 on error, in which case OUTPUT is unchanged.
+ */
+int encode_inst(uint32_t* output, const char* name, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl) {
 
     if (num_args > 3) {
       return -1;
@@ -105,9 +95,9 @@ int translate_inst(FILE* output, const char* name, char** args, size_t num_args,
     else if (strcmp(name, "sltu") == 0)  return write_rtype (0x2b, output, args, num_args);
     else if (strcmp(name, "jr") == 0)    return write_jr (0x08, output, args, num_args);
     else if (strcmp(name, "sll") == 0)   return write_shift (0x00, output, args, num_args);
-    else if (strcmp(name, "addiu") == 0) return write_addiu (0x9, output, args, num_args);
+    else if (strcmp(name, "addiu") == 0) return write_addiu (0x9, output, args, num_args, addr, symtbl, reltbl);
     else if (strcmp(name, "ori") == 0)   return write_ori (0xd, output, args, num_args);
-    else if (strcmp(name, "lui") == 0)   return write_lui (0xf, output, args, num_args);
+    else if (strcmp(name, "lui") == 0)   return write_lui (0xf, output, args, num_args, addr, symtbl, reltbl);
     else if (strcmp(name, "lb") == 0)    return write_mem (0x20, output, args, num_args);
     else if (strcmp(name, "lbu") == 0)   return write_mem (0x24, output, args, num_args);
     else if (strcmp(name, "lw") == 0)    return write_mem (0x23, output, args, num_args);
@@ -120,6 +110,76 @@ int translate_inst(FILE* output, const char* name, char** args, size_t num_args,
     else                                 return -1;
 }
 
+/* Encodes the instruction as encode_inst() does, but takes the label it
+   refers to as id LABEL of LABELS, which pass one assigned and resolved, so
+   no name is looked up: a branch target is an array load, an undefined
+   label a bit test, and a j/jal reuses the relocation symbol of its label.
+   A j/jal to a local label gets its target filled in here, since the label
+   is not written to the output for the relocation to be resolved against.
+   If LABEL is LABEL_NONE the instruction is passed to encode_inst() with
+   SYMTBL.
+
+   Returns 0 on success and -1 on error, in which case OUTPUT is unchanged.
+ */
+int encode_inst_label(uint32_t* output, const char* name, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl, LabelIds* labels,
+    uint32_t label) {
+
+    if (label == LABEL_NONE || num_args > 3) {
+      return encode_inst(output, name, args, num_args, addr, symtbl, reltbl);
+    }
+    int undefined = is_label_undefined(labels, label);
+    uint32_t target = labels->addrs[label];
+    uint32_t instruction;
+
+    if (strcmp(name, "beq") == 0 || strcmp(name, "bne") == 0) {
+      if (num_args != 3 || undefined || !branch_in_range(addr, target)
+          || encode_inst(&instruction, name, args, num_args, addr, NULL, reltbl) == -1) {
+        return -1;
+      }
+      *output = set_branch_target(instruction, addr, target);
+      return 0;
+    }
+    if (strcmp(name, "j") == 0 || strcmp(name, "jal") == 0) {
+      if (num_args != 1) {
+        return -1;
+      }
+      uint32_t symbol = label_reloc_symbol(labels, label, reltbl);
+      if (add_relocation_for(reltbl, symbol, addr, RELOC_JUMP26) == -1) {
+        return -1;
+      }
+      *output = (strcmp(name, "j") == 0 ? 0x2 : 0x3) << 26;
+      if (!undefined && is_local_label(labels->names[label])) {
+        *output |= (target >> 2) & 0x03FFFFFF;
+      }
+      return 0;
+    }
+
+    /* The lui/addiu of an la: encode with a zero immediate, then fill in
+       the half of the address and record a relocation for it.
+     */
+    const char* at = num_args ? strrchr(args[num_args - 1], '@') : NULL;
+    if (at && (strcmp(name, "lui") == 0 || strcmp(name, "addiu") == 0)
+        && (strcmp(at, "@hi") == 0 || strcmp(at, "@lo") == 0)) {
+      char* fixed_args[3];
+      int hi = strcmp(at, "@hi") == 0;
+      memcpy(fixed_args, args, sizeof(char*) * num_args);
+      fixed_args[num_args - 1] = "0";
+      if (undefined
+          || encode_inst(&instruction, name, fixed_args, num_args, addr, NULL, reltbl) == -1) {
+        return -1;
+      }
+      uint32_t symbol = label_reloc_symbol(labels, label, reltbl);
+      if (add_relocation_for(reltbl, symbol, addr, hi ? RELOC_HI16 : RELOC_LO16) == -1) {
+        return -1;
+      }
+      uint32_t half = hi ? addr_hi(target) : target & 0xFFFF;
+      *output = (instruction & 0xFFFF0000) | half;
+      return 0;
+    }
+    return encode_inst(output, name, args, num_args, addr, symtbl, reltbl);
+}
+
 /* A helper function for writing most R-type instructions. You should use
    translate_reg() to parse registers and write_inst_hex() to write to 
    OUTPUT. Both are defined in translate_utils.h.
@@ -127,7 +187,7 @@ int translate_inst(FILE* output, const char* name, char** args, size_t num_args,
    This function is INCOMPLETE. Complete the implementation below. You will
    find bitwise operations to be the cleanest way to complete this function.
  */
-int write_rtype(uint8_t funct, FILE* output, char** args, size_t num_args) {
+int write_rtype(uint8_t funct, uint32_t* output, char** args, size_t num_args) {
 
     if (num_args != 3) {
       return -1;
@@ -146,7 +206,7 @@ int write_rtype(uint8_t funct, FILE* output, char** args, size_t num_args) {
 
     instruction = instruction ^ rd ^ rs ^ rt ^ funct;
 
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
@@ -157,7 +217,7 @@ int write_rtype(uint8_t funct, FILE* output, char** args, size_t num_args) {
    This function is INCOMPLETE. Complete the implementation below. You will
    find bitwise operations to be the cleanest way to complete this function.
  */
-int write_shift(uint8_t funct, FILE* output, char** args, size_t num_args) {
+int write_shift(uint8_t funct, uint32_t* output, char** args, size_t num_args) {
     if (num_args != 3 || !args[0] || !args[1] || !args[2]) {
       return -1;
     }
@@ -179,11 +239,11 @@ int write_shift(uint8_t funct, FILE* output, char** args, size_t num_args) {
     shamt = shamt << 6;
     instruction = instruction ^ rt ^ rd ^ shamt ^ funct;
 
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
-int write_jr(uint8_t funct, FILE* output, char** args, size_t num_args) {
+int write_jr(uint8_t funct, uint32_t* output, char** args, size_t num_args) {
     if (num_args != 1) {
       return -1;
     }
@@ -195,18 +255,22 @@ int write_jr(uint8_t funct, FILE* output, char** args, size_t num_args) {
     rs = rs << 21; 
     uint32_t instruction = 0;
     instruction = instruction ^ rs ^ funct;
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
-int write_addiu(uint8_t opcode, FILE* output, char** args, size_t num_args) {
+int write_addiu(uint8_t opcode, uint32_t* output, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl) {
     if (num_args != 3) {
       return -1;
     }
     long int imm;
     int rs = translate_reg(args[1]);
     int rt = translate_reg(args[0]);
-    int err = translate_num(&imm, args[2], -32767, 6553);
+    int err = translate_num(&imm, args[2], IMM16_MIN, IMM16_MAX);
+    if (err == -1) {
+      err = write_label_half(&imm, args[2], addr, symtbl, reltbl);
+    }
     if (rs == -1 || rt == -1) {
       return -1;
     }
@@ -220,11 +284,58 @@ int write_addiu(uint8_t opcode, FILE* output, char** args, size_t num_args) {
     int o = opcode << 26;
     instruction = instruction ^ rs ^ rt ^ o ^ imm;
 
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
-int write_ori(uint8_t opcode, FILE* output, char** args, size_t num_args) {
+/* Resolves an immediate of the form LABEL@hi or LABEL@lo, as written by the
+   la expansion, to addr_hi() of the address of LABEL or to its lower half,
+   sign-extended as addiu uses it.
+ */
+int translate_label_half(long int* output, const char* str,
+    SymbolTable* symtbl) {
+    const char* at = strrchr(str, '@');
+    if (!at || !symtbl) {
+      return -1;
+    }
+    char label[at - str + 1];
+    memcpy(label, str, at - str);
+    label[at - str] = '\0';
+    int64_t addr = get_addr_for_symbol(symtbl, label);
+    if (addr == -1) {
+      return -1;
+    }
+    if (strcmp(at, "@hi") == 0) {
+      *output = addr_hi(addr);
+    } else if (strcmp(at, "@lo") == 0) {
+      *output = (int16_t) (addr & 0xFFFF);
+    } else {
+      return -1;
+    }
+    return 0;
+}
+
+/* Resolves LABEL@hi or LABEL@lo as translate_label_half() does for the
+   instruction at ADDR, and records a relocation for the half in RELTBL if
+   it is not NULL.
+ */
+static int write_label_half(long int* output, const char* str, uint32_t addr,
+    SymbolTable* symtbl, RelocTable* reltbl) {
+    if (translate_label_half(output, str, symtbl) == -1) {
+      return -1;
+    }
+    if (!reltbl) {
+      return 0;
+    }
+    const char* at = strrchr(str, '@');
+    char label[at - str + 1];
+    memcpy(label, str, at - str);
+    label[at - str] = '\0';
+    return add_relocation(reltbl, label, addr,
+      strcmp(at, "@hi") == 0 ? RELOC_HI16 : RELOC_LO16);
+}
+
+int write_ori(uint8_t opcode, uint32_t* output, char** args, size_t num_args) {
   if (num_args != 3) {
     return -1;
   }
@@ -243,11 +354,12 @@ int write_ori(uint8_t opcode, FILE* output, char** args, size_t num_args) {
   rt = rt << 16;
   int o = opcode << 26;
   instruction = instruction ^ rs ^ rt ^ o ^ imm;
-  write_inst_hex(output, instruction);
+  *output = instruction;
   return 0;
 }
 
-int write_lui(uint8_t opcode, FILE* output, char** args, size_t num_args) {
+int write_lui(uint8_t opcode, uint32_t* output, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl) {
   if (num_args != 2) {
     return -1;
   }
@@ -257,6 +369,9 @@ int write_lui(uint8_t opcode, FILE* output, char** args, size_t num_args) {
       return -1;
     }
   int err = translate_num(&imm, args[1], -2147483648, 2147483647);
+  if (err == -1) {
+    err = write_label_half(&imm, args[1], addr, symtbl, reltbl);
+  }
   if (err == -1) {
     return -1;
   }
@@ -264,11 +379,11 @@ int write_lui(uint8_t opcode, FILE* output, char** args, size_t num_args) {
   rt = rt << 16;
   int o = opcode << 26;
   instruction = instruction ^ rt ^ o ^ imm;
-  write_inst_hex(output, instruction);
+  *output = instruction;
   return 0;
 }
 
-int write_mem(uint8_t opcode, FILE* output, char** args, size_t num_args) {
+int write_mem(uint8_t opcode, uint32_t* output, char** args, size_t num_args) {
     if (num_args != 3) {
       return -1;
     }
@@ -288,13 +403,17 @@ int write_mem(uint8_t opcode, FILE* output, char** args, size_t num_args) {
     int o = opcode << 26;
     uint32_t instruction = 0;
     instruction = instruction ^ o ^ rs ^ rt ^ imm;
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
 
 
-int write_branch(uint8_t opcode, FILE* output, char** args, size_t num_args, 
+/* Writes a beq/bne. If SYMTBL is NULL the label is not resolved and the offset
+   field is left as zero, so that the caller can fill it in later with
+   set_branch_target() once the label's address is known.
+ */
+int write_branch(uint8_t opcode, uint32_t* output, char** args, size_t num_args, 
     uint32_t addr, SymbolTable* symtbl) {
     if (num_args > 3) {
       return -1;
@@ -309,31 +428,47 @@ int write_branch(uint8_t opcode, FILE* output, char** args, size_t num_args,
     uint16_t result;
     if (symtbl) {
       uint64_t a = get_addr_for_symbol(symtbl, target_name);
-      if (a == -1) {
+      if (a == -1 || !branch_in_range(addr, a)) {
         return -1;
       }
       result = ((a - addr) >> 2) - 1;
     } else {
-      return -1;
+      result = 0;
     }
     uint32_t instruction = 0;
     instruction = instruction ^ rs ^ rt ^ op ^ result;
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
-int write_jump(uint8_t opcode, FILE* output, char** args, size_t num_args, 
-    uint32_t addr, SymbolTable* reltbl) {
+/* Returns 1 if a branch located at ADDR can reach TARGET, ie. the offset
+   in words from the instruction after it fits in 16 signed bits.
+ */
+int branch_in_range(uint32_t addr, uint32_t target) {
+    int64_t offset = ((int64_t) target - addr) / 4 - 1;
+    return offset >= INT16_MIN && offset <= INT16_MAX;
+}
+
+/* Returns INSTRUCTION, a branch located at ADDR, with its offset field set so
+   that it branches to TARGET. Check branch_in_range() first.
+ */
+uint32_t set_branch_target(uint32_t instruction, uint32_t addr, uint32_t target) {
+    uint16_t offset = ((target - addr) >> 2) - 1;
+    return (instruction & 0xFFFF0000) | offset;
+}
+
+int write_jump(uint8_t opcode, uint32_t* output, char** args, size_t num_args, 
+    uint32_t addr, RelocTable* reltbl) {
     if (num_args != 1) {
       return -1;
     }
     int o = opcode << 26;
-    int err = add_to_table(reltbl, args[0], addr);
+    int err = add_relocation(reltbl, args[0], addr, RELOC_JUMP26);
     if (err == -1) {
       return -1;
     }
     uint32_t instruction = 0;
     instruction = instruction ^ o;
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
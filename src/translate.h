@@ -3,35 +3,55 @@
 
 #include <stdint.h>
 
+#include "labels.h"
+
 /* IMPLEMENT ME - see documentation in translate.c */
 unsigned write_pass_one(FILE* output, const char* name, char** args, int num_args);
 
 /* IMPLEMENT ME - see documentation in translate.c */
 int translate_inst(FILE* output, const char* name, char** args, size_t num_args, 
-    uint32_t addr, SymbolTable* symtbl, SymbolTable* reltbl);
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl);
+
+/* See documentation in translate.c */
+int encode_inst(uint32_t* output, const char* name, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl);
+
+/* See documentation in translate.c */
+int encode_inst_label(uint32_t* output, const char* name, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl, LabelIds* labels,
+    uint32_t label);
 
 /* Declaring helper functions: */
 
-int write_rtype(uint8_t funct, FILE* output, char** args, size_t num_args);
+int write_rtype(uint8_t funct, uint32_t* output, char** args, size_t num_args);
 
-int write_shift(uint8_t funct, FILE* output, char** args, size_t num_args);
+int write_shift(uint8_t funct, uint32_t* output, char** args, size_t num_args);
 
 /* SOLUTION CODE BELOW */
 
-int write_jr(uint8_t funct, FILE* output, char** args, size_t num_args);
+int write_jr(uint8_t funct, uint32_t* output, char** args, size_t num_args);
 
-int write_addiu(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_addiu(uint8_t opcode, uint32_t* output, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl);
 
-int write_ori(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_ori(uint8_t opcode, uint32_t* output, char** args, size_t num_args);
 
-int write_lui(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_lui(uint8_t opcode, uint32_t* output, char** args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl, RelocTable* reltbl);
 
-int write_mem(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_mem(uint8_t opcode, uint32_t* output, char** args, size_t num_args);
 
-int write_branch(uint8_t opcode, FILE* output, char** args, size_t num_args, 
+int write_branch(uint8_t opcode, uint32_t* output, char** args, size_t num_args, 
     uint32_t addr, SymbolTable* symtbl);
 
-int write_jump(uint8_t opcode, FILE* output, char** args, size_t num_args, 
-    uint32_t addr, SymbolTable* reltbl);
+/* See documentation in translate.c */
+int translate_label_half(long int* output, const char* str, SymbolTable* symtbl);
+
+int branch_in_range(uint32_t addr, uint32_t target);
+
+uint32_t set_branch_target(uint32_t instruction, uint32_t addr, uint32_t target);
+
+int write_jump(uint8_t opcode, uint32_t* output, char** args, size_t num_args, 
+    uint32_t addr, RelocTable* reltbl);
 
 #endif
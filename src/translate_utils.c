@@ -5,6 +5,9 @@
 
 #include "translate_utils.h"
 
+const long int IMM16_MIN = -32768;
+const long int IMM16_MAX = 32767;
+
 void write_inst_string(FILE* output, const char* name, char** args, int num_args) {
     fprintf(output, "%s", name);
     for (int i = 0; i < num_args; i++) {
@@ -103,3 +106,7 @@ int translate_reg(const char* str) {
     else if (strcmp(str, "$ra") == 0)   return 31;
     else                                return -1;
 }
+
+uint32_t addr_hi(uint32_t addr) {
+    return ((addr + 0x8000) >> 16) & 0xFFFF;
+}
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 
+extern const long int IMM16_MIN;    // range of the signed imm field of addiu
+extern const long int IMM16_MAX;
+
 /* Writes the instruction as a string to OUTPUT. NAME is the name of the 
    instruction, and its arguments are in ARGS. NUM_ARGS is the length of
    the array.
@@ -25,4 +28,10 @@ int translate_num(long int* output, const char* str, long int lower_bound,
 /* IMPLEMENT ME - see documentation in translate_utils.c */
 int translate_reg(const char* str);
 
+/* Returns the upper half of ADDR for the lui of an la. It is rounded up
+   when bit 15 of ADDR is set, since the addiu that follows adds the lower
+   half sign-extended. This is %hi in the MIPS ABI, as in R_MIPS_HI16.
+ */
+uint32_t addr_hi(uint32_t addr);
+
 #endif
@@ -3,59 +3,66 @@
 #include <stdarg.h>
 #include <unistd.h>
 
-static const char* output_file = NULL;
+#include "trace.h"
+#include "utils.h"
+
+/* The log file stays open from set_log_file() until the next call, and is
+   flushed after every message so that it can be read while assembling.
+ */
+static FILE* log_file = NULL;
 
 int is_log_file_set() {
-    return output_file != NULL;
+    return log_file != NULL;
 }
 
 void set_log_file(const char* filename) {
+    if (log_file) {
+        fclose(log_file);
+        log_file = NULL;
+    }
     if (filename) {
-        output_file = filename;
         unlink(filename);
-    } else {
-        output_file = NULL;
+        log_file = fopen(filename, "a");
     }
 }
 
 void write_to_log(char* fmt, ...) {
     va_list args;
+    FILE* f = log_file ? log_file : stderr;
 
-    if (output_file) {
-        FILE* f = fopen(output_file, "a");
-        if (!f) {
-            return;
-        }
-        
-        va_start(args, fmt);
-        vfprintf(f, fmt, args);
-        va_end(args);
-        fclose(f);
-    } else {
-        va_start(args, fmt);
-        vfprintf(stderr, fmt, args);
-        va_end(args);
-    }
+    va_start(args, fmt);
+    vfprintf(f, fmt, args);
+    va_end(args);
+    trace_begin("log flush", NULL);
+    fflush(f);
+    trace_end("log flush");
 }
 
 void log_inst(const char* name, char** args, int num_args) {
-    if (output_file) {
-        FILE* f = fopen(output_file, "a");
-        if (!f) {
-            return;
-        }
-        
-        fprintf(f, "%s", name);
-        for (int i = 0; i < num_args; i++) {
-            fprintf(f, " %s", args[i]);
-        }
-        fprintf(f, "\n");
-        fclose(f);
-    } else {
-        fprintf(stderr, "%s", name);
-        for (int i = 0; i < num_args; i++) {
-            fprintf(stderr, " %s", args[i]);
-        }
-        fprintf(stderr, "\n");
+    FILE* f = log_file ? log_file : stderr;
+
+    fprintf(f, "%s", name);
+    for (int i = 0; i < num_args; i++) {
+        fprintf(f, " %s", args[i]);
+    }
+    fprintf(f, "\n");
+    trace_begin("log flush", NULL);
+    fflush(f);
+    trace_end("log flush");
+}
+
+uint32_t hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ (uint8_t) *name) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t hash_bytes(const char* data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t) data[i]) * 16777619u;
     }
+    return hash;
 }
@@ -1,8 +1,17 @@
 
+#include <stdint.h>
+#include <stddef.h>
+
 int is_log_file_set();
 
 void set_log_file(const char* filename);
 
 void write_to_log(char* fmt, ...);
 
-void log_inst(const char* name, char** args, int num_args);
\ No newline at end of file
+void log_inst(const char* name, char** args, int num_args);
+
+/* FNV-1a hash of the string NAME, used by every name table. */
+uint32_t hash_name(const char* name);
+
+/* The same hash over the LEN bytes at DATA, which need not end in a NUL. */
+uint32_t hash_bytes(const char* data, size_t len);
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "reloc.h"
+#include "translate_utils.h"
+#include "translate.h"
+#include "words.h"
+#include "decode.h"
+#include "disasm.h"
+#include "ir.h"
+#include "verify.h"
+
+/* Returns the operation named NAME, or OP_INVALID. */
+static int find_op(const char* name) {
+    for (int op = 1; op < NUM_OPS; op++) {
+        if (strcmp(op_name(op), name) == 0) {
+            return op;
+        }
+    }
+    return OP_INVALID;
+}
+
+/* Appends " <reg>" for the register ARG to BUF. Returns -1 if ARG is not a
+   register.
+ */
+static int append_reg(char* buf, const char* arg) {
+    int reg = translate_reg(arg);
+    if (reg == -1) {
+        return -1;
+    }
+    strcat(buf, " ");
+    strcat(buf, reg_name(reg));
+    return 0;
+}
+
+/* Appends " <number>" for the immediate ARG to BUF, resolving label@hi and
+   label@lo through SYMTBL. The value is not truncated, so one that does not
+   fit its field will not match the disassembly.
+ */
+static int append_imm(char* buf, const char* arg, SymbolTable* symtbl) {
+    long int value;
+    if (translate_num(&value, arg, INT32_MIN, UINT32_MAX) == -1
+        && translate_label_half(&value, arg, symtbl) == -1) {
+        return -1;
+    }
+    sprintf(buf + strlen(buf), " %ld", value);
+    return 0;
+}
+
+/* Appends the immediate ARG of WORD, the instruction at index I, to BUF. A
+   label@hi or label@lo at a site with a relocation of TYPE is written as it
+   is, like disasm_inst() writes it, if the field of WORD holds that half of
+   the address. Otherwise the value is written, so a wrong field shows up as
+   a difference.
+ */
+static int append_half(char* buf, const char* arg, uint32_t word, uint32_t i, int type,
+    SymbolTable* symtbl, const TextSymbols* syms) {
+    long int value;
+    if (i >= syms->len || !syms->relocs[i] || syms->reloc_types[i] != type
+        || translate_label_half(&value, arg, symtbl) == -1) {
+        return append_imm(buf, arg, symtbl);
+    }
+    if (((uint32_t) value & 0xFFFF) == (word & 0xFFFF)) {
+        strcat(buf, " ");
+        strcat(buf, arg);
+    } else {
+        sprintf(buf + strlen(buf), " %ld", value);
+    }
+    return 0;
+}
+
+/* Writes INST, assembled to WORD at index I, into BUF in the format of
+   disasm_inst(). Branch targets are
+   named after the first label at their address, like the disassembler does.
+   Returns -1 if INST is malformed.
+ */
+static int format_ir_inst(char* buf, const Inst* inst, uint32_t word, uint32_t i,
+    SymbolTable* symtbl, const TextSymbols* syms) {
+    int op = find_op(inst->name);
+    char* const* args = inst->args;
+    int n = inst->num_args, err = 0;
+    strcpy(buf, inst->name);
+
+    switch (op) {
+        case OP_ADDU: case OP_OR: case OP_SLT: case OP_SLTU:
+            if (n != 3) {
+                return -1;
+            }
+            err = append_reg(buf, args[0]) | append_reg(buf, args[1])
+                | append_reg(buf, args[2]);
+            break;
+        case OP_SLL:
+        case OP_ADDIU: case OP_ORI:
+            if (n != 3) {
+                return -1;
+            }
+            err = append_reg(buf, args[0]) | append_reg(buf, args[1])
+                | append_half(buf, args[2], word, i, RELOC_LO16, symtbl, syms);
+            break;
+        case OP_JR:
+            if (n != 1) {
+                return -1;
+            }
+            err = append_reg(buf, args[0]);
+            break;
+        case OP_LUI:
+            if (n != 2) {
+                return -1;
+            }
+            err = append_reg(buf, args[0])
+                | append_half(buf, args[1], word, i, RELOC_HI16, symtbl, syms);
+            break;
+        case OP_LB: case OP_LBU: case OP_LW: case OP_SB: case OP_SW:
+            if (n != 3 || translate_reg(args[2]) == -1) {
+                return -1;
+            }
+            err = append_reg(buf, args[0]) | append_imm(buf, args[1], symtbl);
+            sprintf(buf + strlen(buf), "(%s)", reg_name(translate_reg(args[2])));
+            break;
+        case OP_BEQ: case OP_BNE: {
+            int64_t addr = n == 3 ? get_addr_for_symbol(symtbl, args[2]) : -1;
+            if (addr == -1 || addr / 4 > syms->len || !syms->labels[addr / 4]) {
+                return -1;
+            }
+            err = append_reg(buf, args[0]) | append_reg(buf, args[1]);
+            sprintf(buf + strlen(buf), " %s", syms->labels[addr / 4]);
+            break;
+        }
+        case OP_J: case OP_JAL:
+            if (n != 1) {
+                return -1;
+            }
+            sprintf(buf + strlen(buf), " %s", args[0]);
+            break;
+        default:
+            return -1;
+    }
+    return err ? -1 : 0;
+}
+
+uint32_t verify_program(Program* program, WordBuffer* text, SymbolTable* symtbl,
+    RelocTable* reltbl) {
+    char expected[DISASM_LINE_LEN + IR_LINE_LEN], actual[DISASM_LINE_LEN];
+    uint32_t errors = 0;
+
+    if (program->len != text->len) {
+        write_to_log("Error - verification failed: %u instructions in the intermediate "
+            "file but %u in .text\n", program->len, text->len);
+        return 1;
+    }
+    TextSymbols* syms = create_text_symbols(text->words, text->len, symtbl, reltbl);
+    for (uint32_t i = 0; i < text->len; i++) {
+        Inst* inst = &program->insts[i];
+        if (disasm_inst(actual, text->words[i], i, syms) == -1) {
+            strcpy(actual, "(invalid)");
+        }
+        if (format_ir_inst(expected, inst, text->words[i], i, symtbl, syms) == -1) {
+            strcpy(expected, "(malformed)");
+        }
+        if (strcmp(expected, actual) != 0) {
+            write_to_log("Error - verification failed at address %u: expected %s, "
+                "got %s\n", 4 * i, expected, actual);
+            errors++;
+        }
+    }
+    free_text_symbols(syms);
+    return errors;
+}
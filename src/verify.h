@@ -0,0 +1,16 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdint.h>
+
+/* Disassembles TEXT, the output of pass two, and checks every instruction
+   against PROGRAM, the intermediate file it was assembled from. The operands
+   of PROGRAM are resolved with SYMTBL the same way pass two resolves them,
+   but independently of the encoders, so a field that was truncated or
+   misplaced shows up as a difference. Each difference is written to the log.
+   Returns the number of instructions that differ.
+ */
+uint32_t verify_program(Program* program, WordBuffer* text, SymbolTable* symtbl,
+    RelocTable* reltbl);
+
+#endif
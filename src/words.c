@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tables.h"
+#include "translate_utils.h"
+#include "words.h"
+
+WordBuffer* create_word_buffer() {
+    WordBuffer* buf = malloc(sizeof(WordBuffer));
+    if (buf == NULL) {
+        allocation_failed();
+    }
+    buf->words = malloc(sizeof(uint32_t) * 64);
+    if (buf->words == NULL) {
+        allocation_failed();
+    }
+    buf->len = 0;
+    buf->cap = 64;
+    return buf;
+}
+
+void free_word_buffer(WordBuffer* buf) {
+    free(buf->words);
+    free(buf);
+}
+
+uint32_t add_word(WordBuffer* buf, uint32_t word) {
+    if (buf->len == buf->cap) {
+        if (buf->cap > UINT32_MAX / 2) {
+            allocation_failed();
+        }
+        buf->words = realloc(buf->words, sizeof(uint32_t) * buf->cap * 2);
+        if (buf->words == NULL) {
+            allocation_failed();
+        }
+        buf->cap *= 2;
+    }
+    buf->words[buf->len] = word;
+    return buf->len++;
+}
+
+void write_words(WordBuffer* buf, FILE* output, uint32_t start, uint32_t end) {
+    for (uint32_t i = start; i < end; i++) {
+        write_inst_hex(output, buf->words[i]);
+    }
+}
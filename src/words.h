@@ -0,0 +1,27 @@
+#ifndef WORDS_H
+#define WORDS_H
+
+#include <stdint.h>
+
+/* A growable buffer of encoded instructions. Index i holds the instruction
+   at byte offset 4 * i.
+ */
+typedef struct {
+    uint32_t* words;
+    uint32_t len;
+    uint32_t cap;
+} WordBuffer;
+
+WordBuffer* create_word_buffer();
+
+void free_word_buffer(WordBuffer* buf);
+
+/* Appends WORD to BUF and returns its index. */
+uint32_t add_word(WordBuffer* buf, uint32_t word);
+
+/* Writes the words with indices START up to (not including) END to OUTPUT,
+   one per line in the same format as write_inst_hex().
+ */
+void write_words(WordBuffer* buf, FILE* output, uint32_t start, uint32_t end);
+
+#endif
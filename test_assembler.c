@@ -1,13 +1,42 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
 
 #include <CUnit/Basic.h>
 
 #include "src/utils.h"
 #include "src/tables.h"
+#include "src/reloc.h"
 #include "src/translate_utils.h"
 #include "src/translate.h"
+#include "src/preproc.h"
+#include "src/fixups.h"
+#include "src/ir.h"
+#include "src/peephole.h"
+#include "src/schedule.h"
+#include "src/words.h"
+#include "src/data.h"
+#include "src/cost.h"
+#include "src/layout.h"
+#include "src/relax.h"
+#include "src/disasm.h"
+#include "src/verify.h"
+#include "src/gc.h"
+#include "src/elf.h"
+#include "src/ring.h"
+#include "src/aio.h"
+#include "src/arena.h"
+#include "src/memstat.h"
+#include "src/perf.h"
+#include "src/trace.h"
+#include "src/ctable.h"
+#include "src/object.h"
+#include "src/archive.h"
+#include "src/cache.h"
+#include "src/sim.h"
 const char* TMP_FILE = "test_output.txt";
 const int BUF_SIZE = 1024;
 const int MAX_ARGS = 3;
@@ -153,6 +182,404 @@ void test_table_2() {
 }
 
 
+void test_arena() {
+    Arena* arena = create_arena(64);
+    ArenaMark empty = arena_mark(arena);
+
+    SymbolTable* tbl = create_table_in(SYMTBL_UNIQUE_NAME, arena);
+    char buf[32];
+    for (int i = 0; i < 50; i++) {
+        sprintf(buf, "a_rather_long_label_%d", i);
+        CU_ASSERT_EQUAL(add_to_table(tbl, buf, 4 * i), 0);
+    }
+    CU_ASSERT_EQUAL(add_to_table(tbl, "a_rather_long_label_7", 0), -1);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(tbl, "a_rather_long_label_49"), 196);
+    CU_ASSERT_EQUAL(((uintptr_t) tbl->tbl) % sizeof(void*), 0);
+    free_table(tbl);
+
+    size_t high_water = arena->high_water;
+    uint32_t num_chunks = arena->num_chunks;
+    CU_ASSERT(high_water > 50 * sizeof(Symbol));
+    arena_reset(arena, empty);
+    CU_ASSERT_EQUAL(arena->in_use, 0);
+
+    /* The same job again reuses the chunks of the first. */
+    tbl = create_table_in(SYMTBL_UNIQUE_NAME, arena);
+    for (int i = 0; i < 50; i++) {
+        sprintf(buf, "a_rather_long_label_%d", i);
+        add_to_table(tbl, buf, 4 * i);
+    }
+    CU_ASSERT_EQUAL(arena->num_chunks, num_chunks);
+    CU_ASSERT_EQUAL(arena->high_water, high_water);
+
+    char* grown = arena_alloc(arena, 8);
+    strcpy(grown, "abcdefg");
+    grown = arena_realloc(arena, grown, 8, 32);
+    CU_ASSERT_STRING_EQUAL(grown, "abcdefg");
+    CU_ASSERT_EQUAL(arena->resets, 1);
+    free_arena(arena);
+}
+
+void test_mem_report() {
+    enable_mem_report();
+    MemCounter symbols = mem_counter(MEM_SYMBOLS);
+    MemCounter names = mem_counter(MEM_NAMES);
+
+    SymbolTable* tbl = create_table(SYMTBL_UNIQUE_NAME);
+    CU_ASSERT_EQUAL(mem_counter(MEM_SYMBOLS).live - symbols.live,
+        sizeof(SymbolTable) + 10 * sizeof(Symbol));
+    CU_ASSERT_EQUAL(mem_counter(MEM_SYMBOLS).unused - symbols.unused, 10 * sizeof(Symbol));
+
+    /* The eleventh symbol doubles the entries, leaving nine unused. */
+    char buf[32];
+    for (int i = 0; i < 11; i++) {
+        sprintf(buf, "label_%d", i);
+        add_to_table(tbl, buf, 4 * i);
+    }
+    CU_ASSERT_EQUAL(mem_counter(MEM_SYMBOLS).live - symbols.live,
+        sizeof(SymbolTable) + 20 * sizeof(Symbol));
+    CU_ASSERT_EQUAL(mem_counter(MEM_SYMBOLS).unused - symbols.unused, 9 * sizeof(Symbol));
+    CU_ASSERT_EQUAL(mem_counter(MEM_NAMES).allocs - names.allocs, 11);
+    CU_ASSERT_EQUAL(mem_counter(MEM_NAMES).live - names.live, 10 * 8 + 9);
+
+    free_table(tbl);
+    CU_ASSERT_EQUAL(mem_counter(MEM_SYMBOLS).live, symbols.live);
+    CU_ASSERT_EQUAL(mem_counter(MEM_SYMBOLS).unused, symbols.unused);
+    CU_ASSERT_EQUAL(mem_counter(MEM_NAMES).live, names.live);
+    CU_ASSERT(mem_counter(MEM_SYMBOLS).peak >= symbols.live
+        + sizeof(SymbolTable) + 20 * sizeof(Symbol));
+
+    /* Arena-backed tables are counted the same way. */
+    MemCounter relocs = mem_counter(MEM_RELOCS);
+    Arena* arena = create_arena(1024);
+    RelocTable* reltbl = create_reloc_table_in(arena);
+    add_relocation(reltbl, "label_0", 0, RELOC_JUMP26);
+    CU_ASSERT(mem_counter(MEM_RELOCS).live > relocs.live);
+    free_reloc_table(reltbl);
+    free_arena(arena);
+    CU_ASSERT_EQUAL(mem_counter(MEM_RELOCS).live, relocs.live);
+
+    FILE* report = tmpfile();
+    write_mem_report(report);
+    rewind(report);
+    char line[128];
+    CU_ASSERT_PTR_NOT_NULL(fgets(line, sizeof(line), report));
+    CU_ASSERT_PTR_NOT_NULL(strstr(line, "peak bytes"));
+    int rss = 0;
+    while (fgets(line, sizeof(line), report)) {
+        rss |= strncmp(line, "peak RSS:", 9) == 0;
+    }
+    CU_ASSERT(rss);
+    fclose(report);
+}
+
+void test_perf_counters() {
+    /* Without counters every call does nothing. */
+    perf_begin(NULL);
+    perf_end(NULL, "nothing");
+    write_perf_report(NULL, stdout);
+    close_perf_counters(NULL);
+
+    PerfCounters* perf = open_perf_counters();
+    if (perf == NULL) {
+        return;
+    }
+    for (int i = 0; i < PERF_MAX_PHASES + 2; i++) {
+        perf_begin(perf);
+        volatile uint32_t sum = 0;
+        for (uint32_t j = 0; j < 100000; j++) {
+            sum += j;
+        }
+        perf_end(perf, "loop");
+    }
+    CU_ASSERT_EQUAL(perf->num_phases, PERF_MAX_PHASES);
+    CU_ASSERT_STRING_EQUAL(perf->phases[0].name, "loop");
+    if (perf->fds[PERF_INSTRUCTIONS] >= 0) {
+        CU_ASSERT(perf->phases[0].counts[PERF_INSTRUCTIONS] >= 100000);
+    }
+    FILE* report = tmpfile();
+    write_perf_report(perf, report);
+    CU_ASSERT(ftell(report) > 0);
+    fclose(report);
+    close_perf_counters(perf);
+}
+
+static void* trace_worker(void* arg) {
+    trace_thread_name("worker");
+    for (int i = 0; i < 5000; i++) {
+        trace_begin("job", arg);
+        trace_end("job");
+    }
+    return NULL;
+}
+
+void test_trace() {
+    trace_begin("ignored", NULL);
+    enable_trace();
+    trace_thread_name("main");
+    trace_begin("outer", "a \"quoted\" name");
+
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], NULL, trace_worker, "input.s");
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    trace_end("outer");
+    CU_ASSERT_EQUAL(write_trace("test_trace.txt"), 0);
+    CU_ASSERT_EQUAL(write_trace("missing_dir/test_trace.txt"), -1);
+
+    FILE* file = fopen("test_trace.txt", "r");
+    char line[256];
+    int begins = 0, ends = 0, names = 0, ignored = 0, escaped = 0;
+    while (fgets(line, sizeof(line), file)) {
+        begins += strstr(line, "\"ph\":\"B\"") != NULL;
+        ends += strstr(line, "\"ph\":\"E\"") != NULL;
+        names += strstr(line, "\"thread_name\"") != NULL;
+        ignored += strstr(line, "ignored") != NULL;
+        escaped += strstr(line, "a \\\"quoted\\\" name") != NULL;
+    }
+    fclose(file);
+    /* The workers fill more than one chunk each. */
+    CU_ASSERT_EQUAL(begins, 2 * 5000 + 1);
+    CU_ASSERT_EQUAL(ends, 2 * 5000 + 1);
+    CU_ASSERT(names >= 3);
+    CU_ASSERT_EQUAL(ignored, 0);
+    CU_ASSERT_EQUAL(escaped, 1);
+}
+
+void test_reloc_table() {
+    RelocTable* reltbl = create_reloc_table();
+    CU_ASSERT_PTR_NOT_NULL(reltbl);
+
+    char buf[10];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(buf, "f%d", i % 100);
+        CU_ASSERT_EQUAL(add_relocation(reltbl, buf, 4 * i, RELOC_JUMP26), 0);
+    }
+    CU_ASSERT_EQUAL(add_relocation(reltbl, "f0", 6, RELOC_JUMP26), -1);
+    CU_ASSERT_EQUAL(reltbl->len, 1000);
+    CU_ASSERT_EQUAL(reltbl->num_names, 100);
+    CU_ASSERT_EQUAL(reltbl->entries[250].offset, 1000);
+    CU_ASSERT_EQUAL(reltbl->entries[250].symbol, reltbl->entries[50].symbol);
+    CU_ASSERT_EQUAL(strcmp(reloc_symbol(reltbl, &reltbl->entries[250]), "f50"), 0);
+    CU_ASSERT_EQUAL(intern_symbol(reltbl, "f50"), reltbl->entries[50].symbol);
+
+    FILE* file_out = fopen("test_relocations.txt", "w");
+    write_relocations(reltbl, file_out);
+    fclose(file_out);
+    file_out = fopen("test_relocations.txt", "r");
+    char line[32];
+    fgets(line, sizeof(line), file_out);
+    CU_ASSERT_EQUAL(strcmp(line, "0\tf0\n"), 0);
+    fgets(line, sizeof(line), file_out);
+    CU_ASSERT_EQUAL(strcmp(line, "4\tf1\n"), 0);
+    fclose(file_out);
+
+    /* The halves of an la carry their type as a suffix. */
+    char name[] = "tbl@lo";
+    CU_ASSERT_EQUAL(add_relocation(reltbl, "tbl", 4000, RELOC_HI16), 0);
+    CU_ASSERT_EQUAL(read_relocation(reltbl, name, 4004), 0);
+    CU_ASSERT_EQUAL(reltbl->entries[1001].type, RELOC_LO16);
+    CU_ASSERT_EQUAL(reltbl->entries[1001].symbol, reltbl->entries[1000].symbol);
+    file_out = fopen("test_relocations.txt", "w");
+    write_relocations(reltbl, file_out);
+    fclose(file_out);
+    file_out = fopen("test_relocations.txt", "r");
+    while (fgets(line, sizeof(line), file_out) && strncmp(line, "4000", 4) != 0) {
+    }
+    CU_ASSERT_EQUAL(strcmp(line, "4000\ttbl@hi\n"), 0);
+    fgets(line, sizeof(line), file_out);
+    CU_ASSERT_EQUAL(strcmp(line, "4004\ttbl@lo\n"), 0);
+    fclose(file_out);
+
+    /* The upper half makes up for the sign extension of the lower one. */
+    CU_ASSERT_EQUAL(addr_hi(0x10007FFC), 0x1000);
+    CU_ASSERT_EQUAL(addr_hi(0x10008000), 0x1001);
+
+    free_reloc_table(reltbl);
+}
+
+static void* push_numbers(void* arg) {
+    for (uintptr_t i = 1; i <= 100000; i++) {
+        ring_push((Ring*) arg, (void*) i);
+    }
+    ring_push((Ring*) arg, NULL);
+    return NULL;
+}
+
+void test_ring() {
+    Ring* ring = create_ring(3);
+    CU_ASSERT_EQUAL(ring->cap, 4);
+
+    pthread_t producer;
+    CU_ASSERT_EQUAL(pthread_create(&producer, NULL, push_numbers, ring), 0);
+    uintptr_t expected = 1, item;
+    int in_order = 1;
+    while ((item = (uintptr_t) ring_pop(ring)) != 0) {
+        in_order &= item == expected++;
+    }
+    pthread_join(producer, NULL);
+    CU_ASSERT(in_order);
+    CU_ASSERT_EQUAL(expected, 100001);
+    free_ring(ring);
+}
+
+/* Writes four files through a queue of depth 2, then reads them back along
+   with one that does not exist.
+ */
+static void check_io_queue(int backend) {
+    char* names[] = {"test_aio_0.txt", "test_aio_1.txt", "test_aio_2.txt", "test_aio_3.txt"};
+    char* contents[] = {"addiu $t0 $0 1\n", "", "jr $ra\n", "label: sll $t0 $t0 2\n"};
+    IoQueue* queue = create_io_queue(backend, 2);
+    IoCompletion done;
+
+    for (uintptr_t i = 0; i < 4; i++) {
+        io_write_file(queue, names[i], contents[i], strlen(contents[i]), (void*) i);
+    }
+    int written = 0;
+    while (io_wait(queue, &done) == 0) {
+        CU_ASSERT_EQUAL(done.result, 0);
+        CU_ASSERT_PTR_EQUAL(done.data, contents[(uintptr_t) done.tag]);
+        written++;
+    }
+    CU_ASSERT_EQUAL(written, 4);
+
+    for (uintptr_t i = 0; i < 4; i++) {
+        io_read_file(queue, names[i], (void*) i);
+    }
+    io_read_file(queue, "test_aio_missing.txt", (void*) 4);
+    int read = 0;
+    while (io_wait(queue, &done) == 0) {
+        uintptr_t i = (uintptr_t) done.tag;
+        if (i == 4) {
+            CU_ASSERT_EQUAL(done.result, -ENOENT);
+        } else {
+            CU_ASSERT_EQUAL(done.result, 0);
+            CU_ASSERT_EQUAL(done.len, strlen(contents[i]));
+            CU_ASSERT_STRING_EQUAL(done.data, contents[i]);
+        }
+        free(done.data);
+        read++;
+    }
+    CU_ASSERT_EQUAL(read, 5);
+    CU_ASSERT_EQUAL(queue->active, 0);
+    free_io_queue(queue);
+}
+
+void test_aio() {
+    check_io_queue(IO_BACKEND_STDIO);
+    check_io_queue(IO_BACKEND_AUTO);
+}
+
+typedef struct {
+    ConcurrentTable* table;
+    int id;
+} InsertArgs;
+
+/* Adds 100 names of its own and 100 names every thread adds, from lines
+   that are lowest for the last thread.
+ */
+static void* insert_symbols(void* arg) {
+    InsertArgs* args = arg;
+    char buf[32];
+    for (int i = 0; i < 100; i++) {
+        sprintf(buf, "own_%d_%d", args->id, i);
+        add_to_concurrent_table(args->table, buf, 4 * (100 * args->id + i), 100 * args->id + i);
+        sprintf(buf, "shared_%d", i);
+        add_to_concurrent_table(args->table, buf, 4 * args->id, 1000 * (4 - args->id) + i);
+    }
+    return NULL;
+}
+
+void test_concurrent_table() {
+    ConcurrentTable* table = create_concurrent_table(SYMTBL_UNIQUE_NAME, 500);
+    pthread_t threads[4];
+    InsertArgs args[4];
+    for (int i = 0; i < 4; i++) {
+        args[i].table = table;
+        args[i].id = i;
+        CU_ASSERT_EQUAL(pthread_create(&threads[i], NULL, insert_symbols, &args[i]), 0);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    CU_ASSERT_EQUAL(table->len, 500);
+    CU_ASSERT_EQUAL(get_addr_for_concurrent_symbol(table, "own_2_7"), 828);
+    CU_ASSERT_EQUAL(get_addr_for_concurrent_symbol(table, "shared_42"), 12);
+    CU_ASSERT_EQUAL(get_addr_for_concurrent_symbol(table, "shared_100"), -1);
+    CU_ASSERT_EQUAL(add_to_concurrent_table(table, "odd", 3, 0), -1);
+
+    /* Exporting replays the adds by line, so the duplicates are reported
+       the same way every time and the lowest line keeps the name.
+     */
+    SymbolTable* out = create_table(SYMTBL_UNIQUE_NAME);
+    CU_ASSERT_EQUAL(export_concurrent_table(table, out), -1);
+    CU_ASSERT_EQUAL(out->len, 500);
+    CU_ASSERT_STRING_EQUAL(out->tbl[0].name, "own_0_0");
+    CU_ASSERT_STRING_EQUAL(out->tbl[400].name, "shared_0");
+    CU_ASSERT_EQUAL(out->tbl[400].addr, 12);
+    free_table(out);
+
+    /* Lines past 2^32 are not truncated when picking the lowest. */
+    CU_ASSERT_EQUAL(add_to_concurrent_table(table, "late", 16, (1ull << 32) + 1), 0);
+    CU_ASSERT_EQUAL(add_to_concurrent_table(table, "late", 20, 2), 0);
+    CU_ASSERT_EQUAL(get_addr_for_concurrent_symbol(table, "late"), 20);
+    free_concurrent_table(table);
+}
+
+void test_fixups() {
+    FixupTable* fixups = create_fixup_table();
+    CU_ASSERT_PTR_NOT_NULL(fixups);
+
+    add_fixup(fixups, "end", FIXUP_BRANCH, 0, 1, "beq $t0 $t1 end");
+    add_fixup(fixups, "loop", FIXUP_BRANCH, 4, 2, "bne $t0 $t1 loop");
+    add_fixup(fixups, "end", FIXUP_HI16, 8, 3, "lui $at end@hi");
+    CU_ASSERT_EQUAL(fixups->pending, 3);
+    CU_ASSERT_PTR_NULL(find_fixups(fixups, "start"));
+
+    FixupChain* chain = find_fixups(fixups, "end");
+    CU_ASSERT_PTR_NOT_NULL(chain);
+    CU_ASSERT_EQUAL(chain->len, 2);
+    CU_ASSERT_EQUAL(chain->fixups[1].addr, 8);
+    CU_ASSERT_EQUAL(chain->fixups[1].kind, FIXUP_HI16);
+    clear_fixups(fixups, chain);
+    CU_ASSERT_EQUAL(fixups->pending, 1);
+    CU_ASSERT_PTR_NULL(find_fixups(fixups, "end"));
+    CU_ASSERT_EQUAL(find_fixups(fixups, "loop")->len, 1);
+
+    /* Enough labels to grow the hash table, half of them then removed */
+    char name[16];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(name, "L%d", i);
+        add_fixup(fixups, name, FIXUP_BRANCH, 4 * i, i, "beq $0 $0 L");
+    }
+    CU_ASSERT_EQUAL(fixups->len, 1001);
+    for (int i = 0; i < 1000; i += 2) {
+        sprintf(name, "L%d", i);
+        clear_fixups(fixups, find_fixups(fixups, name));
+    }
+    CU_ASSERT_EQUAL(fixups->len, 501);
+    CU_ASSERT_EQUAL(fixups->pending, 501);
+    int found = 0;
+    for (int i = 0; i < 1000; i++) {
+        sprintf(name, "L%d", i);
+        chain = find_fixups(fixups, name);
+        if (i % 2 ? chain && chain->fixups[0].addr == 4 * i : !chain) {
+            found++;
+        }
+    }
+    CU_ASSERT_EQUAL(found, 1000);
+
+    free_fixup_table(fixups);
+
+    /* beq $t0 $a1 with the offset left as zero, patched forwards and backwards */
+    CU_ASSERT_EQUAL(set_branch_target(0x11050000, 4, 28), 0x11050005);
+    CU_ASSERT_EQUAL(set_branch_target(0x11050000, 96, 24), 0x1105ffed);
+}
+
 /****************************************
  *  Test cases for translate.c 
  ****************************************/
@@ -414,7 +841,7 @@ void test_translate() {
     CU_ASSERT_EQUAL(strcmp(line, "ad2a8000"), 0);
 
     /* Test j*/
-    SymbolTable* reltbl = create_table(SYMTBL_NON_UNIQUE);
+    RelocTable* reltbl = create_reloc_table();
     CU_ASSERT_PTR_NOT_NULL(reltbl);
     uint32_t j_address = 0;
     file_out = fopen("test_j.txt", "w");
@@ -486,6 +913,964 @@ void test_translate() {
 
 
 
+int check_file_lines(const char* filename, char** arr, int num) {
+    char buf[BUF_SIZE];
+
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        CU_FAIL("Could not open output file");
+        return 0;
+    }
+    for (int i = 0; i < num; i++) {
+        if (!fgets(buf, BUF_SIZE, f)) {
+            CU_FAIL("Reached end of file");
+            fclose(f);
+            return 0;
+        }
+        strtok(buf, "\n");
+        CU_ASSERT_EQUAL(strcmp(buf, arr[i]), 0);
+    }
+    CU_ASSERT_PTR_NULL(fgets(buf, BUF_SIZE, f));
+    fclose(f);
+    return 0;
+}
+
+void test_write_pass_one() {
+    FILE* file_out = fopen("test_pass_one.txt", "w");
+
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "li", (char *[]){"$t0", "32767"}, 2), 1);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "li", (char *[]){"$t0", "-32768"}, 2), 1);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "li", (char *[]){"$a3", "0xB0BACAFE"}, 2), 2);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "li", (char *[]){"$a3", "0x100000000"}, 2), 0);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "li", (char *[]){"$a3"}, 1), 0);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "bge", (char *[]){"$t0", "$t1", "loop"}, 3), 2);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "move", (char *[]){"$v0", "$a0"}, 2), 1);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "nop", NULL, 0), 1);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "la", (char *[]){"$a0", "loop"}, 2), 2);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "mul", (char *[]){"$t1", "$t0", "10"}, 3), 4);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "mul", (char *[]){"$t1", "$t0", "65536"}, 3), 0);
+    CU_ASSERT_EQUAL(write_pass_one(file_out, "addu", (char *[]){"$v0", "$a0", "$a1"}, 3), 1);
+    fclose(file_out);
+
+    char* arr[] = { "addiu $t0 $0 32767",
+                    "addiu $t0 $0 -32768",
+                    "lui $at 45242",
+                    "ori $a3 $at 51966",
+                    "slt $at $t0 $t1",
+                    "beq $at $0 loop",
+                    "addu $v0 $0 $a0",
+                    "sll $0 $0 0",
+                    "lui $at loop@hi",
+                    "addiu $a0 $at loop@lo",
+                    "addu $at $t0 $0",
+                    "sll $at $at 2",
+                    "addu $at $at $t0",
+                    "sll $t1 $at 1",
+                    "addu $v0 $a0 $a1" };
+    check_file_lines("test_pass_one.txt", arr, 15);
+}
+
+void test_peephole() {
+    FILE* file_out = fopen("test_peephole.txt", "w");
+    fprintf(file_out, "lui $at 1\nori $a2 $at 14464\n"
+                      "lui $at 1\nori $a3 $at 4464\n"
+                      "addiu $t0 $t0 0\n"
+                      "or $t1 $0 $t1\n"
+                      "lui $at 0\nori $t2 $at 40000\n"
+                      "sll $0 $0 0\n"
+                      "lui $at 1\n"
+                      "jr $ra\n");
+    fclose(file_out);
+
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "zero", 16);
+    add_to_table(symtbl, "again", 40);
+    add_to_table(symtbl, "end", 44);
+
+    file_out = fopen("test_peephole.txt", "r");
+    Program* program = read_program(file_out, symtbl);
+    fclose(file_out);
+    CU_ASSERT_PTR_NOT_NULL(program);
+    CU_ASSERT_EQUAL(program->len, 11);
+
+    CU_ASSERT_EQUAL(optimize_program(program), 4);
+    update_symbols(program, symtbl);
+
+    file_out = fopen("test_peephole.txt", "w");
+    write_program(program, file_out);
+    fclose(file_out);
+    free_program(program);
+
+    char* arr[] = { "lui $at 1",
+                    "ori $a2 $at 14464",
+                    "ori $a3 $at 4464",
+                    "ori $t2 $0 40000",
+                    "sll $0 $0 0",
+                    "lui $at 1",
+                    "jr $ra" };
+    check_file_lines("test_peephole.txt", arr, 7);
+
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "zero"), 12);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "again"), 24);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "end"), 28);
+    free_table(symtbl);
+}
+
+void test_schedule() {
+    FILE* file_out = fopen("test_schedule.txt", "w");
+    fprintf(file_out, "lw $t0 0 $a0\naddu $t1 $t0 $t0\naddiu $a1 $a1 4\n"
+                      "lw $t2 4 $a0\nbeq $t2 $0 done\n"
+                      "addiu $s0 $s0 1\nsw $s0 0 $a1\naddiu $a0 $a0 4\nj loop\n"
+                      "jr $ra\n");
+    fclose(file_out);
+
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "loop", 12);
+    add_to_table(symtbl, "done", 36);
+
+    file_out = fopen("test_schedule.txt", "r");
+    Program* program = read_program(file_out, symtbl);
+    fclose(file_out);
+    CU_ASSERT_PTR_NOT_NULL(program);
+
+    CU_ASSERT_EQUAL(schedule_program(program), 3);
+    update_symbols(program, symtbl);
+
+    file_out = fopen("test_schedule.txt", "w");
+    write_program(program, file_out);
+    fclose(file_out);
+    free_program(program);
+
+    char* arr[] = { "lw $t0 0 $a0",
+                    "addiu $a1 $a1 4",
+                    "addu $t1 $t0 $t0",
+                    "lw $t2 4 $a0",
+                    "sll $0 $0 0",
+                    "beq $t2 $0 done",
+                    "sll $0 $0 0",
+                    "addiu $s0 $s0 1",
+                    "sw $s0 0 $a1",
+                    "j loop",
+                    "addiu $a0 $a0 4",
+                    "jr $ra",
+                    "sll $0 $0 0" };
+    check_file_lines("test_schedule.txt", arr, 13);
+
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "loop"), 12);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "done"), 44);
+    free_table(symtbl);
+}
+
+void test_scheduled_run() {
+    FILE* file_out = fopen("test_scheduled_run.txt", "w");
+    fprintf(file_out, "addiu $t0 $0 5\naddiu $t1 $t1 1\naddiu $v0 $v0 3\n"
+                      "addiu $t0 $t0 -1\nbne $t0 $0 loop\naddiu $v0 $v0 100\n");
+    fclose(file_out);
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "loop", 4);
+
+    /* The program as written runs without delay slots, and once scheduled,
+       with the addiu of $v0 moved into the slot of the bne, with them.
+     */
+    for (int scheduled = 0; scheduled < 2; scheduled++) {
+        file_out = fopen("test_scheduled_run.txt", "r");
+        Program* program = read_program(file_out, symtbl);
+        fclose(file_out);
+        CU_ASSERT_PTR_NOT_NULL(program);
+        if (scheduled) {
+            CU_ASSERT_EQUAL(schedule_program(program), 0);
+            update_symbols(program, symtbl);
+            CU_ASSERT_STRING_EQUAL(program->insts[4].name, "addiu");
+            CU_ASSERT_STRING_EQUAL(program->insts[4].args[0], "$v0");
+        }
+
+        RelocTable* reltbl = create_reloc_table();
+        WordBuffer* text = create_word_buffer();
+        for (uint32_t i = 0; i < program->len; i++) {
+            Inst* inst = &program->insts[i];
+            uint32_t word;
+            CU_ASSERT_EQUAL(encode_inst(&word, inst->name, inst->args, inst->num_args,
+                4 * i, symtbl, reltbl), 0);
+            add_word(text, word);
+        }
+        Machine* m = create_machine(text->words, text->len, 4, 64);
+        m->delay_slots = scheduled;
+        CU_ASSERT_EQUAL(run_machine(m), 0);
+        CU_ASSERT_EQUAL(m->regs[2], 115);
+        CU_ASSERT_EQUAL(m->regs[9], 5);
+        free_machine(m);
+        free_word_buffer(text);
+        free_reloc_table(reltbl);
+        free_program(program);
+    }
+    free_table(symtbl);
+
+    /* jal 4, addiu $v0 $0 1, j 7, addiu $v0 $v0 10,
+       addu $v1 $ra $0, jr $ra, addiu $v0 $v0 100: every slot runs once and
+       the call returns past its slot.
+     */
+    uint32_t words[] = { 0x0C000004, 0x24020001, 0x08000007, 0x2442000A,
+                         0x03E01821, 0x03E00008, 0x24420064 };
+    Machine* m = create_machine(words, 7, 4, 64);
+    m->delay_slots = 1;
+    CU_ASSERT_EQUAL(run_machine(m), 0);
+    CU_ASSERT_EQUAL(m->regs[2], 111);
+    CU_ASSERT_EQUAL(m->regs[3], 8);
+    free_machine(m);
+
+    /* Scheduled output is marked so that mipsrun knows. */
+    file_out = fopen("test_scheduled_run.txt", "w");
+    fprintf(file_out, ".set noreorder\n.text\n03e00008\n00000000\n\n.symbol\n\n.relocation\n");
+    fclose(file_out);
+    file_out = fopen("test_scheduled_run.txt", "r");
+    Object* object = read_object(file_out);
+    fclose(file_out);
+    CU_ASSERT_PTR_NOT_NULL(object);
+    CU_ASSERT_EQUAL(object->delay_slots, 1);
+    CU_ASSERT_EQUAL(object->text->len, 2);
+    free_object(object);
+}
+
+void test_layout() {
+    FILE* file_out = fopen("test_layout.txt", "w");
+    fprintf(file_out, "lw $t1 0 $a0\nbeq $t1 $0 rare\n"
+                      "addiu $t0 $t0 -1\nbne $t0 $0 loop\nj done\n"
+                      "addiu $s0 $s0 1\nj back\n"
+                      "jr $ra\n");
+    fclose(file_out);
+
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "loop", 0);
+    add_to_table(symtbl, "back", 8);
+    add_to_table(symtbl, "rare", 20);
+    add_to_table(symtbl, "done", 28);
+
+    file_out = fopen("test_layout.txt", "r");
+    Program* program = read_program(file_out, symtbl);
+    fclose(file_out);
+    CU_ASSERT_PTR_NOT_NULL(program);
+
+    file_out = fopen("test_layout_counts.txt", "w");
+    fprintf(file_out, "# address\tcount\ttaken\tratio\n0\t100\n4\t100\t0\t0.000\n"
+                      "back 100\n12\t100\t99\t0.990\n16 1\n28 1\n");
+    fclose(file_out);
+    file_out = fopen("test_layout_counts.txt", "r");
+    Profile* profile = read_profile(file_out, symtbl, program->len);
+    fclose(file_out);
+    CU_ASSERT_PTR_NOT_NULL(profile);
+    CU_ASSERT_EQUAL(profile->counts[2], 100);
+    CU_ASSERT_EQUAL(profile->taken[1], 0);
+    CU_ASSERT_EQUAL(profile->taken[3], 99);
+    CU_ASSERT_EQUAL(profile->taken[2], PROFILE_UNKNOWN);
+
+    CU_ASSERT_EQUAL(layout_program(program, symtbl, profile), 2);
+    update_symbols(program, symtbl);
+    free_profile(profile);
+
+    file_out = fopen("test_layout.txt", "w");
+    write_program(program, file_out);
+    fclose(file_out);
+    free_program(program);
+
+    char* arr[] = { "lw $t1 0 $a0",
+                    "beq $t1 $0 rare",
+                    "addiu $t0 $t0 -1",
+                    "bne $t0 $0 loop",
+                    "jr $ra",
+                    "addiu $s0 $s0 1",
+                    "j back" };
+    check_file_lines("test_layout.txt", arr, 7);
+
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "done"), 16);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "rare"), 20);
+
+    file_out = fopen("test_layout_counts.txt", "w");
+    fprintf(file_out, "nowhere 5\n");
+    fclose(file_out);
+    file_out = fopen("test_layout_counts.txt", "r");
+    CU_ASSERT_PTR_NULL(read_profile(file_out, symtbl, 7));
+    fclose(file_out);
+    free_table(symtbl);
+}
+
+void test_relax() {
+    FILE* file_out = fopen("test_relax.txt", "w");
+    fprintf(file_out, "beq $t0 $0 far\nbne $t1 $0 near\naddiu $t1 $t1 1\n");
+    for (int i = 0; i < 40000; i++) {
+        fprintf(file_out, "addiu $t2 $t2 1\n");
+    }
+    fprintf(file_out, "jr $ra\n");
+    fclose(file_out);
+
+    for (int delay_slots = 0; delay_slots <= 1; delay_slots++) {
+        SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+        add_to_table(symtbl, "near", 12);
+        add_to_table(symtbl, "far", 160012);
+
+        file_out = fopen("test_relax.txt", "r");
+        Program* program = read_program(file_out, symtbl);
+        fclose(file_out);
+        CU_ASSERT_PTR_NOT_NULL(program);
+
+        /* Only the branch to far is rewritten. With delay slots the bne
+           after it is its slot and stays there, and the j gets a nop.
+         */
+        CU_ASSERT_EQUAL(relax_branches(program, symtbl, delay_slots), 1);
+        update_symbols(program, symtbl);
+        CU_ASSERT_EQUAL(program->len, 40005 + delay_slots);
+        Inst* insts = program->insts;
+        CU_ASSERT_EQUAL(strcmp(insts[0].name, "bne"), 0);
+        CU_ASSERT_EQUAL(strcmp(insts[0].args[2], ".L0"), 0);
+        CU_ASSERT_EQUAL(strcmp(insts[1 + delay_slots].name, "j"), 0);
+        CU_ASSERT_EQUAL(strcmp(insts[1 + delay_slots].args[0], "far"), 0);
+        CU_ASSERT_EQUAL(strcmp(insts[2 - delay_slots].name, "bne"), 0);
+        CU_ASSERT_EQUAL(strcmp(insts[2 - delay_slots].args[2], "near"), 0);
+        if (delay_slots) {
+            CU_ASSERT_EQUAL(strcmp(insts[3].name, "sll"), 0);
+        }
+        CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, ".L0"), delay_slots ? 16 : 8);
+        CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "near"), 16 + 4 * delay_slots);
+        CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "far"), 160012 + 4 + 4 * delay_slots);
+
+        /* Everything is in range now. */
+        CU_ASSERT_EQUAL(relax_branches(program, symtbl, delay_slots), 0);
+        free_program(program);
+
+        /* Another pass over the same symbols numbers its labels after .L0. */
+        file_out = fopen("test_relax.txt", "r");
+        program = read_program(file_out, symtbl);
+        fclose(file_out);
+        CU_ASSERT_EQUAL(program->next_local_label, 1);
+        free_program(program);
+        free_table(symtbl);
+    }
+
+    uint32_t output;
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "far", 131072);
+    add_to_table(symtbl, "back", 0);
+    char* args[] = { "$t0", "$0", "far" };
+    CU_ASSERT_EQUAL(write_branch(0x4, &output, args, 3, 0, symtbl), 0);
+    CU_ASSERT_EQUAL(output & 0xFFFF, 0x7FFF);
+    CU_ASSERT_EQUAL(write_branch(0x4, &output, args, 3, 4, symtbl), 0);
+    CU_ASSERT_EQUAL(write_branch(0x4, &output, args, 3, 131068, symtbl), 0);
+    args[2] = "back";
+    CU_ASSERT_EQUAL(write_branch(0x4, &output, args, 3, 131068, symtbl), 0);
+    CU_ASSERT_EQUAL(write_branch(0x4, &output, args, 3, 131072, symtbl), -1);
+    CU_ASSERT_EQUAL(branch_in_range(131072, 0), 0);
+    CU_ASSERT_EQUAL(branch_in_range(0, 131076), 0);
+    free_table(symtbl);
+}
+
+void test_gc() {
+    FILE* file_out = fopen("test_gc.txt", "w");
+    fprintf(file_out, "jal used\nlui $at data@hi\nj done\n"
+                      "addiu $t0 $0 1\njr $ra\n"
+                      "beq $a0 $0 used\naddiu $v0 $0 1\n"
+                      "addiu $v1 $0 2\n"
+                      "jr $ra\n"
+                      "jal unused\n");
+    fclose(file_out);
+
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "unused", 12);
+    add_to_table(symtbl, "used", 20);
+    add_to_table(symtbl, "data", 28);
+    add_to_table(symtbl, "done", 32);
+    add_to_table(symtbl, "dead", 36);
+    add_to_table(symtbl, "end", 40);
+
+    file_out = fopen("test_gc.txt", "r");
+    Program* program = read_program(file_out, symtbl);
+    fclose(file_out);
+    CU_ASSERT_PTR_NOT_NULL(program);
+
+    CU_ASSERT_EQUAL(gc_program(program, symtbl, "nowhere"), -1);
+    CU_ASSERT_EQUAL(gc_program(program, symtbl, NULL), 3);
+    update_symbols(program, symtbl);
+
+    file_out = fopen("test_gc.txt", "w");
+    write_program(program, file_out);
+    fclose(file_out);
+    free_program(program);
+
+    char* arr[] = { "jal used",
+                    "lui $at data@hi",
+                    "j done",
+                    "beq $a0 $0 used",
+                    "addiu $v0 $0 1",
+                    "addiu $v1 $0 2",
+                    "jr $ra" };
+    check_file_lines("test_gc.txt", arr, 7);
+
+    CU_ASSERT_EQUAL(symtbl->len, 4);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "unused"), -1);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "dead"), -1);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "used"), 12);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "done"), 24);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "end"), 28);
+    free_table(symtbl);
+}
+
+void test_disasm() {
+    uint32_t words[] = { 0x00001021, 0x8c89fffc, 0x1500fffd, 0x0c000000,
+                         0x3c011000, 0x000a5fc0, 0x03e00008 };
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    RelocTable* reltbl = create_reloc_table();
+    add_to_table(symtbl, "f", 24);
+    add_relocation(reltbl, "f", 12, RELOC_JUMP26);
+
+    TextSymbols* syms = create_text_symbols(words, 7, symtbl, reltbl);
+    char buf[DISASM_LINE_LEN];
+    CU_ASSERT_EQUAL(disasm_inst(buf, words[0], 0, syms), 14);
+    CU_ASSERT_EQUAL(strcmp(buf, "addu $v0 $0 $0"), 0);
+    disasm_inst(buf, words[1], 1, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "lw $t1 -4($a0)"), 0);
+    disasm_inst(buf, words[2], 2, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "bne $t0 $0 L0"), 0);
+    disasm_inst(buf, words[3], 3, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "jal f"), 0);
+    disasm_inst(buf, words[4], 4, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "lui $at 4096"), 0);
+    disasm_inst(buf, words[5], 5, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "sll $t3 $t2 31"), 0);
+    CU_ASSERT_EQUAL(disasm_inst(buf, 0xffffffff, 0, syms), -1);
+    free_text_symbols(syms);
+
+    /* la $s0 tbl keeps its relocations */
+    uint32_t la[] = { 0x3c011000, 0x24300018 };
+    SymbolTable* data = create_table(SYMTBL_UNIQUE_NAME);
+    RelocTable* la_relocs = create_reloc_table();
+    add_to_table(data, "tbl", 0x10000018);
+    add_relocation(la_relocs, "tbl", 0, RELOC_HI16);
+    add_relocation(la_relocs, "tbl", 4, RELOC_LO16);
+    syms = create_text_symbols(la, 2, data, la_relocs);
+    disasm_inst(buf, la[0], 0, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "lui $at tbl@hi"), 0);
+    disasm_inst(buf, la[1], 1, syms);
+    CU_ASSERT_EQUAL(strcmp(buf, "addiu $s0 $at tbl@lo"), 0);
+    free_text_symbols(syms);
+
+    FILE* file_out = fopen("test_verify.txt", "w");
+    fprintf(file_out, "lui $at tbl@hi\naddiu $s0 $at tbl@lo\n");
+    fclose(file_out);
+    file_out = fopen("test_verify.txt", "r");
+    Program* program = read_program(file_out, data);
+    fclose(file_out);
+    WordBuffer* text = create_word_buffer();
+    add_word(text, la[0]);
+    add_word(text, la[1]);
+    CU_ASSERT_EQUAL(verify_program(program, text, data, la_relocs), 0);
+    text->words[1] = 0x24300014;    // four bytes short of tbl
+    CU_ASSERT_EQUAL(verify_program(program, text, data, la_relocs), 1);
+    free_program(program);
+    free_word_buffer(text);
+    free_table(data);
+    free_reloc_table(la_relocs);
+
+    file_out = fopen("test_verify.txt", "w");
+    fprintf(file_out, "addu $v0 $0 $0\nlw $t1 -4 $a0\nbne $t0 $0 top\njal f\n"
+                      "lui $at 4096\nsll $t3 $t2 31\njr $ra\n");
+    fclose(file_out);
+    add_to_table(symtbl, "top", 0);
+    file_out = fopen("test_verify.txt", "r");
+    program = read_program(file_out, symtbl);
+    fclose(file_out);
+
+    text = create_word_buffer();
+    for (int i = 0; i < 7; i++) {
+        add_word(text, words[i]);
+    }
+    CU_ASSERT_EQUAL(verify_program(program, text, symtbl, reltbl), 0);
+    text->words[2] = 0x1500fffc;    // branch one instruction too far back
+    text->words[5] = 0x000a5f80;    // shift by 30
+    CU_ASSERT_EQUAL(verify_program(program, text, symtbl, reltbl), 2);
+
+    free_program(program);
+    free_word_buffer(text);
+    free_table(symtbl);
+    free_reloc_table(reltbl);
+}
+
+/* Reads the 32-bit field at OFFSET of BUF in the given byte order. */
+static uint32_t read_field(const uint8_t* buf, uint32_t offset, int big_endian) {
+    const uint8_t* p = buf + offset;
+    return big_endian ? (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]
+                      : (uint32_t) p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+void test_elf() {
+    WordBuffer* text = create_word_buffer();
+    add_word(text, 0x24040abc);
+    add_word(text, 0x0c000000);
+    add_word(text, 0x03e00008);
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "start", 0);
+    add_to_table(symtbl, "back", 8);
+    RelocTable* reltbl = create_reloc_table();
+    add_relocation(reltbl, "external", 4, RELOC_JUMP26);
+
+    for (int big_endian = 0; big_endian <= 1; big_endian++) {
+        FILE* file_out = fopen("test_elf.txt", "wb");
+        CU_ASSERT_EQUAL(write_elf(text, NULL, symtbl, reltbl, big_endian, file_out), 0);
+        fclose(file_out);
+
+        uint8_t buf[1024];
+        file_out = fopen("test_elf.txt", "rb");
+        size_t len = fread(buf, 1, sizeof(buf), file_out);
+        fclose(file_out);
+        CU_ASSERT(len > 52);
+        CU_ASSERT_EQUAL(memcmp(buf, "\x7f" "ELF", 4), 0);
+        CU_ASSERT_EQUAL(buf[4], 1);
+        CU_ASSERT_EQUAL(buf[5], big_endian ? 2 : 1);
+        CU_ASSERT_EQUAL(read_field(buf, 16, big_endian) >> (big_endian ? 16 : 0) & 0xFFFF, 1);
+
+        /* .text follows the header, then .rel.text. */
+        CU_ASSERT_EQUAL(read_field(buf, 52, big_endian), 0x24040abc);
+        CU_ASSERT_EQUAL(read_field(buf, 60, big_endian), 0x03e00008);
+        CU_ASSERT_EQUAL(read_field(buf, 64, big_endian), 4);
+        /* Symbols 2 and 3 are start and back, 4 the undefined external. */
+        CU_ASSERT_EQUAL(read_field(buf, 68, big_endian), (4 << 8) | 4);
+        CU_ASSERT_EQUAL(read_field(buf, 72 + 3 * 16 + 4, big_endian), 8);
+    }
+
+    free_word_buffer(text);
+    free_table(symtbl);
+    free_reloc_table(reltbl);
+}
+
+/* Reads the 16-bit field at OFFSET of BUF in the given byte order. */
+static uint32_t read_half(const uint8_t* buf, uint32_t offset, int big_endian) {
+    const uint8_t* p = buf + offset;
+    return big_endian ? p[0] << 8 | p[1] : p[1] << 8 | p[0];
+}
+
+/* Reads an la of a .data label back through the section headers, as
+   readelf -r -s does.
+ */
+void test_elf_la() {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "main", 0);
+    add_to_table(symtbl, "tbl", DATA_BASE + 0x8004);
+    RelocTable* reltbl = create_reloc_table();
+    WordBuffer* text = create_word_buffer();
+    uint32_t word;
+    CU_ASSERT_EQUAL(encode_inst(&word, "lui", (char*[]){ "$at", "tbl@hi" }, 2, 0,
+        symtbl, reltbl), 0);
+    CU_ASSERT_EQUAL(word, 0x3C011001);
+    add_word(text, word);
+    CU_ASSERT_EQUAL(encode_inst(&word, "addiu", (char*[]){ "$a0", "$at", "tbl@lo" }, 3,
+        4, symtbl, reltbl), 0);
+    CU_ASSERT_EQUAL(word, 0x24248004);
+    add_word(text, word);
+    DataSection* data = create_data_section(1);
+    uint8_t zeros[0x8008] = { 0 };
+    add_data_bytes(data, zeros, sizeof(zeros));
+
+    for (int big_endian = 0; big_endian <= 1; big_endian++) {
+        FILE* file_out = fopen("test_elf.txt", "wb");
+        CU_ASSERT_EQUAL(write_elf(text, data, symtbl, reltbl, big_endian, file_out), 0);
+        fclose(file_out);
+
+        static uint8_t buf[0x9000];
+        file_out = fopen("test_elf.txt", "rb");
+        size_t len = fread(buf, 1, sizeof(buf), file_out);
+        fclose(file_out);
+        CU_ASSERT(len > 52);
+
+        uint32_t shoff = read_field(buf, 32, big_endian);
+        uint32_t shnum = read_half(buf, 48, big_endian);
+        uint32_t rel = 0, text_off = 0;
+        for (uint32_t i = 0; i < shnum; i++) {
+            uint32_t type = read_field(buf, shoff + 40 * i + 4, big_endian);
+            if (type == 9) {
+                rel = shoff + 40 * i;
+            } else if (i == 1) {
+                text_off = read_field(buf, shoff + 40 * i + 16, big_endian);
+            }
+        }
+        CU_ASSERT(rel != 0);
+        if (rel == 0) {
+            continue;
+        }
+        uint32_t symtab = shoff + 40 * read_field(buf, rel + 24, big_endian);
+        uint32_t strtab = shoff + 40 * read_field(buf, symtab + 24, big_endian);
+        uint32_t sym_off = read_field(buf, symtab + 16, big_endian);
+        uint32_t str_off = read_field(buf, strtab + 16, big_endian);
+        uint32_t rel_off = read_field(buf, rel + 16, big_endian);
+        CU_ASSERT_EQUAL(read_field(buf, rel + 20, big_endian), 16);
+
+        /* R_MIPS_HI16 and R_MIPS_LO16 against tbl, which is .data+0x8004. */
+        for (uint32_t i = 0; i < 2; i++) {
+            CU_ASSERT_EQUAL(read_field(buf, rel_off + 8 * i, big_endian), 4 * i);
+            uint32_t info = read_field(buf, rel_off + 8 * i + 4, big_endian);
+            CU_ASSERT_EQUAL(info & 0xFF, 5 + i);
+            uint32_t sym = sym_off + 16 * (info >> 8);
+            CU_ASSERT_STRING_EQUAL((char*) buf + str_off + read_field(buf, sym, big_endian),
+                "tbl");
+            CU_ASSERT_EQUAL(read_field(buf, sym + 4, big_endian), 0x8004);
+            CU_ASSERT_EQUAL(read_half(buf, sym + 14, big_endian), 2);
+        }
+        /* The addends in the instructions are zero. */
+        CU_ASSERT_EQUAL(read_field(buf, text_off, big_endian), 0x3C010000);
+        CU_ASSERT_EQUAL(read_field(buf, text_off + 4, big_endian), 0x24240000);
+    }
+
+    free_word_buffer(text);
+    free_data_section(data);
+    free_table(symtbl);
+    free_reloc_table(reltbl);
+}
+
+void test_archive() {
+    char* names[] = {"first.out", "second.out"};
+    char* contents[] = {
+        ".text\n00000000\n0c000000\n\n.symbol\n0\tstart\n4\tshared\n\n.relocation\n4\thelper\n",
+        ".text\n03e00008\n\n.symbol\n0\thelper\n0\tshared\n\n.relocation\n"
+    };
+    size_t sizes[] = {strlen(contents[0]), strlen(contents[1])};
+
+    FILE* output = fopen("test_archive.txt", "w");
+    CU_ASSERT_EQUAL(write_archive(output, names, contents, sizes, 2), 0);
+    fclose(output);
+
+    Archive* archive = open_archive("test_archive.txt");
+    CU_ASSERT_PTR_NOT_NULL(archive);
+    CU_ASSERT_EQUAL(archive->header->num_members, 2);
+    CU_ASSERT_EQUAL(archive->header->num_symbols, 3);
+
+    uint32_t addr = 0;
+    CU_ASSERT_EQUAL(find_archive_symbol(archive, "helper", &addr), 1);
+    CU_ASSERT_EQUAL(addr, 0);
+    /* The first member to define a name is the one indexed. */
+    CU_ASSERT_EQUAL(find_archive_symbol(archive, "shared", &addr), 0);
+    CU_ASSERT_EQUAL(addr, 4);
+    CU_ASSERT_EQUAL(find_archive_symbol(archive, "missing", &addr), -1);
+    CU_ASSERT_EQUAL(find_archive_member(archive, "second.out"), 1);
+    CU_ASSERT_STRING_EQUAL(archive_member_name(archive, 0), "first.out");
+
+    Object* object = load_archive_member(archive, 0);
+    CU_ASSERT_PTR_NOT_NULL(object);
+    CU_ASSERT_EQUAL(object->text->len, 2);
+    CU_ASSERT_EQUAL(object->relocations->len, 1);
+    free_object(object);
+    close_archive(archive);
+}
+
+void test_cost_report() {
+    char* lines[][3] = { { "lw", "$t0", "0" }, { "addu", "$v0", "$t0" },
+                         { "bne", "$v0", "$0" }, { "addiu", "$v0", "$v0" },
+                         { "jr", "$ra" } };
+    char* last[] = { "$a0", "$t0", "f", "1" };
+    int num_args[] = { 3, 3, 3, 3, 1 };
+
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    RelocTable* reltbl = create_reloc_table();
+    add_to_table(symtbl, "main", 0);
+    add_to_table(symtbl, "f", 16);
+
+    WordBuffer* text = create_word_buffer();
+    for (int i = 0; i < 5; i++) {
+        char* args[3] = { lines[i][1], lines[i][2], num_args[i] == 3 ? last[i] : NULL };
+        uint32_t word;
+        CU_ASSERT_EQUAL(encode_inst(&word, lines[i][0], args, num_args[i], 4 * i,
+            symtbl, reltbl), 0);
+        add_word(text, word);
+    }
+
+    FILE* file_out = fopen("test_cost_report.txt", "w");
+    CU_ASSERT_EQUAL(write_cost_report(text, symtbl, reltbl, &DEFAULT_COST_MODEL, 0,
+        file_out), 0);
+    fclose(file_out);
+
+    char* arr[] = { "# model: load-use stall 1, branch penalty 1, depth 5",
+                    "# label\taddress\tinstructions\tblocks\tcycles\tstalls\tbranches\tcritical",
+                    "main\t0\t4\t2\t10\t1\t1\t4",
+                    "f\t16\t1\t1\t6\t0\t1\t1" };
+    check_file_lines("test_cost_report.txt", arr, 4);
+
+    /* With delay slots the addiu is the slot of the bne, in its block. */
+    file_out = fopen("test_cost_report.txt", "w");
+    CU_ASSERT_EQUAL(write_cost_report(text, symtbl, reltbl, &DEFAULT_COST_MODEL, 1,
+        file_out), 0);
+    fclose(file_out);
+    char* slots[] = { "# model: load-use stall 1, branch penalty 1, depth 5, delay slots",
+                      "# label\taddress\tinstructions\tblocks\tcycles\tstalls\tbranches\tcritical",
+                      "main\t0\t4\t1\t9\t1\t1\t4",
+                      "f\t16\t1\t1\t5\t0\t1\t1" };
+    check_file_lines("test_cost_report.txt", slots, 4);
+
+    CostModel model;
+    CU_ASSERT_EQUAL(parse_cost_model(&model, "2,3"), 0);
+    CU_ASSERT_EQUAL(model.load_use_stall, 2);
+    CU_ASSERT_EQUAL(model.branch_penalty, 3);
+    CU_ASSERT_EQUAL(model.pipeline_depth, 5);
+    CU_ASSERT_EQUAL(parse_cost_model(&model, "2"), -1);
+    CU_ASSERT_EQUAL(parse_cost_model(&model, "1,1,0"), -1);
+
+    free_word_buffer(text);
+    free_table(symtbl);
+    free_reloc_table(reltbl);
+}
+
+void test_cache() {
+    CacheConfig config;
+    CU_ASSERT_EQUAL(parse_cache_config(&config, "1024,16,2"), 0);
+    CU_ASSERT_EQUAL(config.size, 1024);
+    CU_ASSERT_EQUAL(config.ways, 2);
+    CU_ASSERT_EQUAL(config.policy, CACHE_LRU);
+    CU_ASSERT_EQUAL(parse_cache_config(&config, "1024,16,2,random"), 0);
+    CU_ASSERT_EQUAL(config.policy, CACHE_RANDOM);
+    CU_ASSERT_EQUAL(parse_cache_config(&config, "1000,16,2"), -1);
+    CU_ASSERT_EQUAL(parse_cache_config(&config, "1536,16,2"), -1);
+    CU_ASSERT_EQUAL(parse_cache_config(&config, "1024,2,2"), -1);
+    CU_ASSERT_EQUAL(parse_cache_config(&config, "1024,16,2,fifo"), -1);
+
+    /* A 2-way L1D with a single set, so that a third line evicts one. */
+    CacheConfig l1d = { 32, 16, 2, CACHE_LRU };
+    CacheSim* sim = create_cache_sim(&DEFAULT_L1I, &l1d, &DEFAULT_L2, 4);
+    for (uint32_t i = 0; i < 4; i++) {
+        cache_fetch(sim, i);
+    }
+    CU_ASSERT_EQUAL(sim->l1i.accesses, 4);
+    CU_ASSERT_EQUAL(sim->l1i.misses, 1);
+    CU_ASSERT_EQUAL(sim->fetch_misses[0], 1);
+
+    uint32_t a = DATA_BASE, b = DATA_BASE + 0x100, c = DATA_BASE + 0x200;
+    uint32_t addrs[] = { a, b, a, c, b, a };
+    for (int i = 0; i < 6; i++) {
+        cache_data(sim, 0, addrs[i]);
+    }
+    CU_ASSERT_EQUAL(sim->l1d.accesses, 6);
+    CU_ASSERT_EQUAL(sim->l1d.misses, 5);
+    CU_ASSERT_EQUAL(sim->l2.accesses, 6);
+    CU_ASSERT_EQUAL(sim->l2.misses, 4);
+
+    SymbolTable* symbols = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symbols, "main", 0);
+    uint64_t counts[] = { 1, 1, 1, 1 };
+    FILE* output = fopen("test_cache.txt", "w");
+    write_cache_report(sim, counts, symbols, output);
+    fclose(output);
+
+    char buf[BUF_SIZE];
+    output = fopen("test_cache.txt", "r");
+    for (int i = 0; i < 5; i++) {
+        CU_ASSERT_PTR_NOT_NULL(fgets(buf, BUF_SIZE, output));
+    }
+    CU_ASSERT_STRING_EQUAL(buf, "main\t4\t1\t0.250\t6\t5\t0.833\t4\n");
+    fclose(output);
+    free_table(symbols);
+    free_cache_sim(sim);
+}
+
+void test_preprocess() {
+    FILE* file = fopen("test_pp_inc.txt", "w");
+    fprintf(file, "# helpers\n.macro push reg\n  addiu $sp, $sp, -4\n"
+        "  sw \\reg, 0($sp)  # save\n.endm\n"
+        ".macro wait reg count\nw_\\@: addiu \\reg \\reg -1\n  bne \\reg $0 w_\\@\n.endm\n");
+    fclose(file);
+    file = fopen("test_pp_main.txt", "w");
+    fprintf(file, ".include \"test_pp_inc.txt\"\n\nmain: push $ra\n"
+        ".include \"test_pp_inc.txt\"\n  wait $t0\n  wait $t1, 2, 3\n"
+        ".include \"test_pp_missing.txt\"\njr $ra\n");
+    fclose(file);
+
+    FILE* input = fopen("test_pp_main.txt", "r");
+    FILE* output = fopen("test_pp_out.txt", "w");
+    SourceMap* map = create_source_map();
+    /* The second .include redefines both macros, and the third is missing. */
+    CU_ASSERT_EQUAL(preprocess(input, "test_pp_main.txt", output, map), -1);
+    fclose(input);
+    fclose(output);
+
+    /* The blank line is kept, so the main file needs a single run. */
+    char* arr[] = { "\n",
+                    "main:",
+                    "addiu $sp $sp -4",
+                    "sw $ra 0 $sp",
+                    "w_1: addiu $t0 $t0 -1",
+                    "bne $t0 $0 w_1",
+                    "jr $ra" };
+    check_file_lines("test_pp_out.txt", arr, 7);
+    CU_ASSERT_EQUAL(map->lines, 7);
+    CU_ASSERT_EQUAL(map->len, 4);
+
+    char where[128];
+    format_source_loc(map, 2, where, sizeof(where));
+    CU_ASSERT_STRING_EQUAL(where, "3");
+    format_source_loc(map, 4, where, sizeof(where));
+    CU_ASSERT_STRING_EQUAL(where, "test_pp_inc.txt:4 in macro push, called at 3");
+    format_source_loc(map, 5, where, sizeof(where));
+    CU_ASSERT_STRING_EQUAL(where, "test_pp_inc.txt:7 in macro wait, called at 5");
+    format_source_loc(map, 7, where, sizeof(where));
+    CU_ASSERT_STRING_EQUAL(where, "8");
+    format_source_loc(map, 8, where, sizeof(where));
+    CU_ASSERT_STRING_EQUAL(where, "8");
+    free_source_map(map);
+    free_preprocessor_cache();
+}
+
+void test_data_section() {
+    DataSection* data = create_data_section(0);
+    uint32_t start;
+    const char* bad;
+    CU_ASSERT_EQUAL(add_data(data, ".byte", "1, -1 255", &start, &bad), 0);
+    CU_ASSERT_EQUAL(start, 0);
+    /* A .word is aligned first, and its labels move with it. */
+    CU_ASSERT_EQUAL(add_data(data, ".word", "0x11223344 -2147483648\n", &start, &bad), 0);
+    CU_ASSERT_EQUAL(start, 4);
+    CU_ASSERT_EQUAL(add_data(data, ".half", "-2", &start, &bad), 0);
+    CU_ASSERT_EQUAL(add_data(data, ".asciiz", "\"a#\\\"\\n\", \"\"", &start, &bad), 0);
+    CU_ASSERT_EQUAL(start, 14);
+    CU_ASSERT_EQUAL(add_data(data, ".align", "3", &start, &bad), 0);
+    CU_ASSERT_EQUAL(start, 24);
+    CU_ASSERT_EQUAL(add_data(data, ".space", "2", &start, &bad), 0);
+    CU_ASSERT_EQUAL(data->len, 26);
+    CU_ASSERT_EQUAL(memcmp(data->bytes, "\x01\xff\xff\x00\x44\x33\x22\x11\x00\x00\x00\x80"
+        "\xfe\xff" "a#\"\n\0\0\0\0\0\0\0\0\0\0", 26), 0);
+
+    /* Errors leave the section as it was. */
+    const char* operands = "1, 2 0x1ffffffff";
+    CU_ASSERT_EQUAL(add_data(data, ".word", operands, &start, &bad), -1);
+    CU_ASSERT_PTR_EQUAL(bad, operands + 5);
+    CU_ASSERT_EQUAL(data->len, 26);
+    operands = "128 -129";
+    CU_ASSERT_EQUAL(add_data(data, ".byte", operands, &start, &bad), -1);
+    CU_ASSERT_PTR_EQUAL(bad, operands + 4);
+    CU_ASSERT_EQUAL(add_data(data, ".half", "", &start, &bad), -1);
+    CU_ASSERT_EQUAL(add_data(data, ".word", "12ab", &start, &bad), -1);
+    CU_ASSERT_EQUAL(add_data(data, ".ascii", "\"open", &start, &bad), -1);
+    CU_ASSERT_EQUAL(add_data(data, ".ascii", "abc", &start, &bad), -1);
+    CU_ASSERT_EQUAL(add_data(data, ".space", "4 4", &start, &bad), -1);
+    CU_ASSERT_EQUAL(add_data(data, ".align", "13", &start, &bad), -1);
+    CU_ASSERT_EQUAL(data->len, 26);
+    CU_ASSERT_EQUAL(is_data_directive(".asciiz"), 1);
+    CU_ASSERT_EQUAL(is_data_directive(".text"), 0);
+
+    /* The words of the section read back into an object. */
+    FILE* file = fopen("test_data.txt", "w");
+    write_data(data, file);
+    fclose(file);
+    char* arr[] = { "00ffff01", "11223344", "80000000", "2361fffe", "00000a22",
+                    "00000000", "00000000" };
+    check_file_lines("test_data.txt", arr, 7);
+
+    file = fopen("test_data_object.txt", "w");
+    fprintf(file, ".text\n03e00008\n\n.data\n");
+    write_data(data, file);
+    fprintf(file, "\n.symbol\n0\tmain\n268435457\tbyte\n\n.relocation\n");
+    fclose(file);
+    file = fopen("test_data_object.txt", "r");
+    Object* object = read_object(file);
+    fclose(file);
+    CU_ASSERT_PTR_NOT_NULL(object);
+    CU_ASSERT_EQUAL(object->data->len, 28);
+    CU_ASSERT_EQUAL(memcmp(object->data->bytes, data->bytes, 26), 0);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(object->symbols, "byte"), DATA_BASE + 1);
+    free_object(object);
+    free_data_section(data);
+
+    data = create_data_section(1);
+    CU_ASSERT_EQUAL(add_data(data, ".half", "0x1234", &start, &bad), 0);
+    CU_ASSERT_EQUAL(add_data(data, ".word", "0x56789abc", &start, &bad), 0);
+    CU_ASSERT_EQUAL(memcmp(data->bytes, "\x12\x34\x00\x00\x56\x78\x9a\xbc", 8), 0);
+    free_data_section(data);
+}
+
+void test_label_ids() {
+    LabelIds* labels = create_label_ids();
+    char* beq[] = { "$t0", "$t1", "loop" };
+    char* j[] = { "ext" };
+    char* lui[] = { "$at", "data@hi" };
+    char* addiu[] = { "$a0", "$at", "data@lo" };
+    char* bge[] = { "$t0", "$t1", "loop" };
+    char* beq_missing[] = { "$t0", "$0", "missing" };
+    char* addu[] = { "$t0", "$t1", "$t2" };
+
+    uint32_t loop = label_operand(labels, "beq", beq, 3);
+    CU_ASSERT_EQUAL(loop, 0);
+    CU_ASSERT_EQUAL(label_operand(labels, "bge", bge, 3), loop);
+    CU_ASSERT_EQUAL(label_operand(labels, "addu", addu, 3), LABEL_NONE);
+    uint32_t data = label_operand(labels, "lui", lui, 2);
+    CU_ASSERT_EQUAL(label_operand(labels, "addiu", addiu, 3), data);
+    CU_ASSERT_STRING_EQUAL(labels->names[data], "data");
+
+    /* The lines of: beq, j, j, la (two lines), beq to a missing label. */
+    add_label_lines(labels, loop, 1);
+    add_label_lines(labels, label_operand(labels, "j", j, 1), 2);
+    add_label_lines(labels, data, 2);
+    add_label_lines(labels, label_operand(labels, "beq", beq_missing, 3), 1);
+    CU_ASSERT_EQUAL(labels->num_lines, 6);
+
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    add_to_table(symtbl, "loop", 0);
+    add_to_table(symtbl, "data", 0x12344);
+    define_labels(labels, symtbl);
+    /* ext is only jumped to, so it is left to the linker. */
+    CU_ASSERT_EQUAL(check_labels(labels), 2);
+    CU_ASSERT(is_label_undefined(labels, labels->line_labels[5]));
+    CU_ASSERT(!is_label_undefined(labels, loop));
+
+    RelocTable* reltbl = create_reloc_table();
+    uint32_t word, expected;
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "beq", beq, 3, 8, NULL, reltbl, labels,
+        labels->line_labels[0]), 0);
+    CU_ASSERT_EQUAL(encode_inst(&expected, "beq", beq, 3, 8, symtbl, reltbl), 0);
+    CU_ASSERT_EQUAL(word, expected);
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "j", j, 1, 4, NULL, reltbl, labels,
+        labels->line_labels[1]), 0);
+    CU_ASSERT_EQUAL(word, 0x08000000);
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "jal", j, 1, 8, NULL, reltbl, labels,
+        labels->line_labels[2]), 0);
+    CU_ASSERT_EQUAL(word, 0x0C000000);
+    CU_ASSERT_EQUAL(reltbl->len, 2);
+    CU_ASSERT_EQUAL(reltbl->num_names, 1);
+    CU_ASSERT_STRING_EQUAL(reloc_symbol(reltbl, &reltbl->entries[1]), "ext");
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "lui", lui, 2, 12, NULL, reltbl, labels,
+        labels->line_labels[3]), 0);
+    CU_ASSERT_EQUAL(word, 0x3C010001);
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "addiu", addiu, 3, 16, NULL, reltbl, labels,
+        labels->line_labels[4]), 0);
+    CU_ASSERT_EQUAL(word, 0x24242344);
+    CU_ASSERT_EQUAL(reltbl->len, 4);
+    CU_ASSERT_EQUAL(reltbl->entries[2].type, RELOC_HI16);
+    CU_ASSERT_EQUAL(reltbl->entries[3].type, RELOC_LO16);
+    CU_ASSERT_EQUAL(reltbl->entries[3].offset, 16);
+    CU_ASSERT_STRING_EQUAL(reloc_symbol(reltbl, &reltbl->entries[3]), "data");
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "beq", beq_missing, 3, 20, NULL, reltbl,
+        labels, labels->line_labels[5]), -1);
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "addu", addu, 3, 24, NULL, reltbl, labels,
+        LABEL_NONE), 0);
+
+    /* A j to a local label is filled in, and neither is written out. */
+    char* local[] = { ".L9" };
+    CU_ASSERT(is_local_label(".L9"));
+    CU_ASSERT(!is_local_label("L9"));
+    add_to_table(symtbl, ".L9", 40);
+    define_labels(labels, symtbl);
+    CU_ASSERT_EQUAL(encode_inst_label(&word, "j", local, 1, 28, NULL, reltbl, labels,
+        intern_label(labels, ".L9")), 0);
+    CU_ASSERT_EQUAL(word, 0x0800000A);
+    CU_ASSERT_EQUAL(reltbl->len, 5);
+    FILE* file_out = fopen("test_label_ids.txt", "w");
+    write_table(symtbl, file_out);
+    write_relocations(reltbl, file_out);
+    fclose(file_out);
+    char* arr[] = { "0\tloop", "74564\tdata", "4\text", "8\text", "12\tdata@hi",
+                    "16\tdata@lo" };
+    check_file_lines("test_label_ids.txt", arr, 6);
+
+    reset_label_ids(labels);
+    CU_ASSERT_EQUAL(labels->num_lines, 0);
+    CU_ASSERT_EQUAL(check_labels(labels), 0);
+    CU_ASSERT_EQUAL(intern_label(labels, "ext"), labels->line_labels[1]);
+
+    free_label_ids(labels);
+    free_table(symtbl);
+    free_reloc_table(reltbl);
+}
+
 /****************************************
  *  Add your test cases here
  ****************************************/
@@ -520,6 +1905,33 @@ int main(int argc, char** argv) {
     if (!CU_add_test(pSuite2, "test_table_2", test_table_2)) {
         goto exit;
     }
+    if (!CU_add_test(pSuite2, "test_arena", test_arena)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_mem_report", test_mem_report)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_perf_counters", test_perf_counters)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_trace", test_trace)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_reloc_table", test_reloc_table)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_ring", test_ring)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_aio", test_aio)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_concurrent_table", test_concurrent_table)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_fixups", test_fixups)) {
+        goto exit;
+    }
 
     /* Suite 3 */
     pSuite3 = CU_add_suite("Testing translate.c", NULL, NULL);
@@ -529,6 +1941,54 @@ int main(int argc, char** argv) {
     if (!CU_add_test(pSuite3, "test_translate", test_translate)) {
         goto exit;
     }
+    if (!CU_add_test(pSuite3, "test_preprocess", test_preprocess)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_data_section", test_data_section)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_label_ids", test_label_ids)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_write_pass_one", test_write_pass_one)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_peephole", test_peephole)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_schedule", test_schedule)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_scheduled_run", test_scheduled_run)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_layout", test_layout)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_relax", test_relax)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_gc", test_gc)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_disasm", test_disasm)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_elf", test_elf)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_elf_la", test_elf_la)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_archive", test_archive)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_cost_report", test_cost_report)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_cache", test_cache)) {
+        goto exit;
+    }
 
     CU_basic_set_mode(CU_BRM_VERBOSE);
     CU_basic_run_tests();